@@ -57,6 +57,17 @@
 #include <unordered_map>
 #include <algorithm>
 #include <array>
+#include <thread>
+#include <cstdarg>
+#include <cfloat>
+#include <cstdint>
+#include <atomic>
+#include <sstream>
+#include <map>
+#include <future>
+#include <chrono>
+#include <intrin.h>
+#include <immintrin.h>
 
 using namespace std;
 using namespace DirectX;
@@ -0,0 +1,82 @@
+/* Copyright (c) 2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "Structures.h"
+
+//--------------------------------------------------------------------------------------
+// Functions
+//--------------------------------------------------------------------------------------
+
+namespace Geometry
+{
+	/**
+	* Sort the model's triangles by the Morton code of their centroids and renumber the vertices in first use order.
+	* Spatially close triangles end up close in the index, position, and attribute streams.
+	*/
+	void ReorderModelMorton(Model &model);
+
+	/**
+	* Generate a chain of simplified levels for every mesh, each with about half the triangles of the previous level.
+	* Levels are stored as extra meshes that index the source vertex streams. Each mesh is simplified on its own worker,
+	* every level continuing from the one before.
+	*/
+	void GenerateMeshLods(Model &model, uint32_t maxLevels);
+
+	/**
+	* Pick each instance's level from the screen area its bounding sphere covers, aiming for a few pixels per triangle.
+	* An instance only changes level once its desired triangle count passes the threshold by a margin, so one sitting at a
+	* threshold does not flip level, and rebuild the TLAS, every frame. Returns true when any instance changed level.
+	*/
+	bool SelectMeshLods(Model &model, XMFLOAT3 eye, float tanHalfFovY, float screenHeight);
+
+	/**
+	* Get the mesh drawn for an instance at its selected level.
+	*/
+	uint32_t GetInstanceMesh(const Model &model, const MeshInstance &instance);
+
+	/**
+	* Remove triangles that repeat a vertex or have no area, faces that repeat another face of the same mesh with the same winding
+	* and attributes, meshes left with no triangles along with their instances, and vertices no triangle references. Logs what
+	* was removed and the memory saved.
+	*/
+	void CleanModel(Model &model);
+
+	/**
+	* Find meshes that are rigidly transformed copies of an earlier mesh, and replace them with instances of that mesh.
+	* The copies' geometry is removed, so vertex and index memory and BLAS builds scale with the unique geometry.
+	*/
+	void InstanceRepeatedMeshes(Model &model);
+
+	/**
+	* Split each mesh into chunks that reference at most 65535 consecutive vertices, so their indices fit in 16 bits.
+	* Vertices shared across a chunk boundary are duplicated into each chunk. With wide indices each mesh stays a single 32-bit chunk.
+	* Models without explicit meshes become a single mesh, and models without instances get one identity instance per mesh.
+	*/
+	void BuildMeshChunks(Model &model, bool shortIndices);
+}
@@ -51,9 +51,11 @@ namespace D3DResources
 {
 	void Create_Buffer(D3D12Global &d3d, D3D12BufferCreateInfo& info, ID3D12Resource** ppResource);
 	void Create_Transform_Buffer(D3D12Global &d3d, D3D12Resources &resources);
-	void Create_Texture(D3D12Global &d3d, D3D12Resources &resources, Material &material);
+	void Create_Texture(D3D12Global &d3d, D3D12Resources &resources, Material &material, const ConfigInfo &config);
+	void Create_Texture_Feedback(D3D12Global &d3d, D3D12Resources &resources, UINT words);
 	void Create_Vertex_Buffer(D3D12Global &d3d, D3D12Resources &resources, Model &model);
 	void Create_Index_Buffer(D3D12Global &d3d, D3D12Resources &resources, Model &model);
+	void Create_Sphere_Buffer(D3D12Global &d3d, D3D12Resources &resources, Model &model);
 	void Create_Constant_Buffer(D3D12Global &d3d, ID3D12Resource** buffer, UINT64 size);
 	void Create_Samplers(D3D12Global &d3d, D3D12Resources &resources);
 	void Create_BackBuffer_RTV(D3D12Global &d3d, D3D12Resources &resources);
@@ -61,7 +63,8 @@ namespace D3DResources
 	void Create_Lighting_CB(D3D12Global &d3d, D3D12Resources &resources, const Material &material);
 	void Create_Descriptor_Heaps(D3D12Global &d3d, D3D12Resources &resources);
 
-	void Update_View_CB(D3D12Global &d3d, D3D12Resources &resources, ConfigInfo &config);
+	void Update_View_CB(D3D12Global &d3d, D3D12Resources &resources, ConfigInfo &config, const Model &model);
+	void Update_Texture_Residency(D3D12Global &d3d, D3D12Resources &resources, Material &material, const ConfigInfo &config);
 
 	void Destroy(D3D12Resources &resources);
 }
@@ -98,12 +101,13 @@ namespace D3D12
 namespace DXR
 {	
 	void Create_Bottom_Level_AS(D3D12Global &d3d, DXRGlobal &dxr, D3D12Resources &resources, Model &model);
-	void Create_Top_Level_AS(D3D12Global &d3d, DXRGlobal &dxr, D3D12Resources &resources);
+	void Create_Top_Level_AS(D3D12Global &d3d, DXRGlobal &dxr, D3D12Resources &resources, const Model &model);
+	void Update_Top_Level_AS(D3D12Global &d3d, DXRGlobal &dxr, D3D12Resources &resources, Model &model);
 	void Create_RayGen_Program(D3D12Global &d3d, DXRGlobal &dxr, D3D12ShaderCompilerInfo &shaderCompiler);
 	void Create_Miss_Program(D3D12Global &d3d, DXRGlobal &dxr, D3D12ShaderCompilerInfo &shaderCompiler);
 	void Create_Closest_Hit_Program(D3D12Global &d3d, DXRGlobal &dxr, D3D12ShaderCompilerInfo &shaderCompiler);
 	void Create_Pipeline_State_Object(D3D12Global &d3d, DXRGlobal &dxr);
-	void Create_Shader_Table(D3D12Global &d3d, DXRGlobal &dxr, D3D12Resources &resources);
+	void Create_Shader_Table(D3D12Global &d3d, DXRGlobal &dxr, D3D12Resources &resources, const Model &model);
 	void Create_CBVSRVUAV_Heap(D3D12Global &d3d, DXRGlobal &dxr, D3D12Resources &resources, const Model &model);
 	void Create_DXR_Output(D3D12Global &d3d, D3D12Resources &resources);
 
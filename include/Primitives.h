@@ -0,0 +1,60 @@
+/* Copyright (c) 2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "Structures.h"
+
+//--------------------------------------------------------------------------------------
+// Functions
+//--------------------------------------------------------------------------------------
+
+namespace Primitives
+{
+	/**
+	* The unit primitives span [-1, 1] on each axis: the sphere, icosphere and cylinder have radius 1, and the capsule has
+	* radius 0.5 with a cylinder of length 1 between its ends.
+	*/
+	PrimitiveSize GetPrimitiveSize(PrimitiveShape shape, uint32_t tessellation);
+
+	/**
+	* Write a primitive into preallocated streams, with its indices offset by baseVertex.
+	* The streams must hold at least the primitive's size.
+	*/
+	void WritePrimitive(const Primitive &primitive, uint32_t baseVertex, XMFLOAT3* positions, VertexAttributes* attributes, uint32_t* indices);
+
+	/**
+	* Append primitives to the model, growing its streams once and writing the primitives in parallel.
+	*/
+	void AddPrimitives(Model &model, const vector<Primitive> &primitives);
+	void AddPrimitive(Model &model, const Primitive &primitive);
+
+	/**
+	* Build the transform for a primitive scaled along its axes, rotated by the pitch, yaw and roll in rotation, then moved to position.
+	*/
+	XMFLOAT4X4 GetTransform(XMFLOAT3 position, XMFLOAT3 scale, XMFLOAT3 rotation = XMFLOAT3(0.f, 0.f, 0.f));
+}
@@ -53,6 +53,16 @@ struct ConfigInfo {
 	int			width;
 	int			height;
 	string		model;
+	vector<string>	models;
+	bool		mortonOrder;
+	bool		wideIndices;
+	bool		generateLods;
+	DXGI_FORMAT	textureFormat;		// RGBA8, or BC1 or BC7 to compress textures at load
+	bool		saveTextures;		// write each loaded texture beside its source as a DDS file
+	bool		textureCache;		// keep converted textures in cache\textures, keyed by source content and options
+	size_t		textureBudget;		// bytes all loaded textures and their mips must fit in, textures are downsampled to fit, 0 for no limit
+	bool		lazyTextures;		// start with placeholder textures and load each in the background once a ray hits it
+	size_t		virtualTextureBudget;	// bytes of GPU memory for the pages of a tiled texture streamed by sampling feedback, 0 to upload it whole
 	HINSTANCE	instance;
 	double ElapsedTime;
 	double TotalTime;
@@ -61,6 +71,15 @@ struct ConfigInfo {
 		width = 640;
 		height = 360;
 		model = "";
+		mortonOrder = false;
+		wideIndices = false;
+		generateLods = false;
+		textureFormat = DXGI_FORMAT_R8G8B8A8_UNORM;
+		saveTextures = false;
+		textureCache = true;
+		textureBudget = 0;
+		lazyTextures = false;
+		virtualTextureBudget = 0;
 		instance = NULL;
 		ElapsedTime = 0;
 		TotalTime = 0;
@@ -91,35 +110,223 @@ struct Vertex
 	}
 };
 
+struct VertexAttributes
+{
+	XMFLOAT3 color;
+	XMFLOAT3 normal;
+	XMFLOAT3 material;
+};
+
+enum class PixelFormat
+{
+	RGB,
+	BGR,
+	Grey
+};
+
+struct TextureInfo
+{
+	vector<UINT8> pixels;
+	int width;
+	int height;
+	int stride;					// bytes per texel, or per 4x4 block for the block compressed formats
+	int mipLevels;				// pixels holds every level, largest first
+	DXGI_FORMAT format;
+
+	TextureInfo() {
+		width = 0;
+		height = 0;
+		stride = 4;
+		mipLevels = 1;
+		format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	}
+};
+
+/**
+* Where one mip of a texture goes in caller-provided memory, such as a mapped upload heap.
+*/
+struct TextureFootprint
+{
+	size_t offset;
+	size_t rowPitch;
+};
+
+// Returns the memory to write the texels of a texture with the given size, format, and mip count to, and the footprint of each mip
+typedef function<UINT8*(const TextureInfo &texture, vector<TextureFootprint> &footprints)> TextureAllocator;
+
 struct Material {
 	string name;
 	string texturePath;
+	vector<UINT8> textureData;		// encoded image embedded in the model file, used instead of texturePath
+	TextureInfo textureAtlas;		// textures of several assets packed at load, used instead of textureData and texturePath
 	float  textureResolution;
+	UINT   textureMipLevels;
+	int    textureTargetResolution;	// width the texture is resampled to at load (MTL -texres), 0 to keep the image's own
+	bool   textureResident;			// false while a placeholder stands in for the texture, until a ray hits it
 
 	Material() {
 		name = "defaultMaterial";
 		texturePath = "";
+		textureTargetResolution = 0;
+		textureResident = true;
 		textureResolution = 512;
+		textureMipLevels = 1;
+	}
+
+	bool HasTexture() const
+	{
+		return !texturePath.empty() || !textureData.empty() || !textureAtlas.pixels.empty();
 	}
 };
 
+struct MeshChunk
+{
+	size_t		firstIndex;			// first entry of the chunk in the model's index list
+	uint32_t	indexCount;
+	uint32_t	baseVertex;			// first vertex of the chunk in the position and attribute streams
+	uint32_t	vertexCount;
+	uint32_t	indexStride;		// 2 for 16-bit local indices, 4 for 32-bit
+	UINT64		indexByteOffset;	// location of the chunk in the packed index buffer, set on upload
+};
+
+struct Mesh
+{
+	size_t		firstIndex;			// index range of the mesh in the model's index list
+	size_t		indexCount;
+	uint32_t	firstChunk;			// chunk range of the mesh, set when the chunks are built
+	uint32_t	chunkCount;
+	uint32_t	firstLod;			// simplified levels, stored as the meshes starting at firstLod
+	uint32_t	lodCount;
+	XMFLOAT4	bounds;				// object space bounding sphere, center and radius
+};
+
+struct MeshInstance
+{
+	uint32_t	mesh;
+	XMFLOAT4X4	transform;			// object to world, row vector convention
+	uint32_t	lod;				// selected level of detail, 0 is the source mesh
+};
+
+enum class PrimitiveShape
+{
+	Sphere,			// latitude and longitude rings, tessellation is the number of latitude segments
+	Icosphere,		// subdivided icosahedron, tessellation is the subdivision level
+	Box,			// flat shaded cube, tessellation is unused
+	Plane,			// square in the XZ plane facing +Y, tessellation is the number of segments per side
+	Cylinder,		// capped, along Y, tessellation is the number of segments around
+	Capsule			// cylinder with hemisphere ends, tessellation is the number of latitude segments
+};
+
+struct Primitive
+{
+	PrimitiveShape	shape;
+	uint32_t		tessellation;
+	XMFLOAT4X4		transform;		// unit primitive to world, row vector convention
+	XMFLOAT3		color;
+	XMFLOAT3		material;
+};
+
+struct PrimitiveSize
+{
+	uint32_t	vertexCount;
+	uint32_t	indexCount;
+};
+
+struct Sphere
+{
+	XMFLOAT3	center;
+	float		radius;
+	XMFLOAT3	color;
+	XMFLOAT3	material;			// diffuse, specular, and reflection weights
+};
+
+struct SceneLight
+{
+	XMFLOAT3	position;
+	float		swing;				// amplitude of the light's sway along X as the scene animates
+};
+
+struct CameraKey
+{
+	float		time;				// seconds from the start of the path
+	XMFLOAT3	position;
+	XMFLOAT3	focus;
+};
+
 struct Model
 {
-	vector<Vertex>									vertices;
+	vector<XMFLOAT3>								positions;		// tightly packed, consumed by the AS build
+	vector<VertexAttributes>						attributes;		// shading data, parallel to positions
 	vector<uint32_t>								indices;
+	vector<MeshChunk>								chunks;			// one BLAS geometry each
+	vector<Mesh>									meshes;			// one BLAS each
+	vector<MeshInstance>							instances;		// one TLAS instance each
+	vector<Sphere>									spheres;		// one TLAS instance of the unit sphere each
+	vector<SceneLight>								lights;			// the shaders light the scene with the first
+	vector<CameraKey>								cameraPath;		// followed by the scripted camera, sorted by time
+
+	uint32_t AddVertex(const Vertex &v) 
+	{
+		positions.push_back(v.position);
+		attributes.push_back({ v.color, v.normal, v.material });
+		return static_cast<uint32_t>(positions.size() - 1);
+	}
 };
 
-struct TextureInfo
+struct MappedFile
 {
-	vector<UINT8> pixels;
-	int width;
-	int height;
-	int stride;
+	HANDLE		file;
+	HANDLE		mapping;
+	const UINT8*	data;
+	size_t		size;
+
+	MappedFile()
+	{
+		file = INVALID_HANDLE_VALUE;
+		mapping = NULL;
+		data = nullptr;
+		size = 0;
+	}
+};
+
+struct PageTable
+{
+	UINT				width;
+	UINT				height;
+	UINT				mipLevels;
+	UINT				tileWidth;			// texels per page
+	UINT				tileHeight;
+	UINT				packedMip;			// first mip of the packed tail, smaller than a page and always resident
+	vector<UINT>		firstPage;			// first page of each mip, then the total page count
+	vector<UINT>		pagesX;				// pages across each mip
+	vector<int>			pageSlots;			// physical slot holding each page, -1 when not resident
+	vector<uint64_t>	pageUsed;			// frame each page was last requested in
+	vector<int>			slotPages;			// page held by each slot, -1 when free
+	uint64_t			frame;
+
+	PageTable() {
+		width = 0;
+		height = 0;
+		mipLevels = 0;
+		tileWidth = 0;
+		tileHeight = 0;
+		packedMip = 0;
+		frame = 0;
+	}
+};
+
+struct PageMapping
+{
+	UINT	mip;
+	UINT	x;						// page coordinates within the mip
+	UINT	y;
+	int		slot;					// slot the page is now mapped to, -1 when it was evicted
 };
 
 struct LightingCB {
 	XMFLOAT4 lightingInformation;
 	XMFLOAT4 textureResolution;
+	XMFLOAT4 virtualTexture;		// page width and height in texels, first packed mip, and texture height, zero unless the texture is tiled
 };
 
 struct ViewCB
@@ -218,8 +425,11 @@ struct D3D12Resources
 
 	ID3D12Resource*									vertexBuffer;
 	D3D12_VERTEX_BUFFER_VIEW						vertexBufferView;
+	ID3D12Resource*									attributeBuffer;
 	ID3D12Resource*									indexBuffer;
 	D3D12_INDEX_BUFFER_VIEW							indexBufferView;
+	ID3D12Resource*									sphereBuffer;
+	ID3D12Resource*									sphereAABBBuffer;
 
 	ID3D12Resource*									viewCB;
 	ViewCB											viewCBData;
@@ -238,6 +448,17 @@ struct D3D12Resources
 
 	ID3D12Resource*									texture;
 	ID3D12Resource*									textureUploadHeap;
+	ID3D12Resource*									textureFeedback;			// hit flag per material, set by the hit shader while its texture is a placeholder
+	ID3D12Resource*									textureFeedbackReadback[2];	// one per frame in flight, read once that frame's fence has passed
+	bool											textureFeedbackPending;		// copy the flags back each frame until the texture load starts
+	UINT											textureFeedbackWords;		// the lazy loading flag, then a bit per virtual texture page
+	ID3D12Resource*									textureFeedbackClear;		// zeros copied over the page bits once they are read back
+	future<TextureInfo>								textureLoad;
+
+	ID3D12Heap*										virtualTextureHeap;			// page slots of the tiled texture, then its packed mips
+	ID3D12Resource*									virtualTextureUploadHeap[2];	// staging for a frame's page uploads, one per frame in flight
+	TextureInfo										virtualTextureSource;		// every mip in system memory, pages are copied from here
+	PageTable										pageTable;
 
 	UINT											rtvDescSize;
 
@@ -362,11 +583,13 @@ struct HitProgram
 struct DXRGlobal
 {
 	AccelerationStructureBuffer						TLAS;
-	AccelerationStructureBuffer						BLAS;
+	vector<AccelerationStructureBuffer>				BLAS;			// one per mesh
+	AccelerationStructureBuffer						sphereBLAS;		// AABBs of the model's spheres
 	uint64_t										tlasSize;
 
 	ID3D12Resource*									sbt;
 	uint32_t										sbtEntrySize;
+	uint32_t										hitGroupCount;
 
 	RtProgram										rgs;
 	RtProgram										miss;
@@ -0,0 +1,70 @@
+/* Copyright (c) 2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "Common.h"
+
+/**
+ * A dependency graph of startup tasks, run across worker threads with timings recorded for each task.
+ */
+class TaskGraph
+{
+public:
+	/**
+	* Add a task that runs once all of its dependencies have finished.
+	* Dependencies must be tasks that were added earlier.
+	* Main thread tasks only run on the thread that calls Run.
+	*/
+	size_t Add(const char* name, const function<void()> &work, const vector<size_t> &dependencies = {}, bool mainThread = false);
+
+	/**
+	* Run every task, rethrowing the first exception a task raised.
+	*/
+	void Run();
+
+	/**
+	* Log the wall time and the longest chain of dependent tasks.
+	*/
+	void Report() const;
+
+private:
+	struct Task
+	{
+		string				name;
+		function<void()>	work;
+		vector<size_t>		dependencies;
+		vector<size_t>		dependents;
+		bool				mainThread;
+		size_t				waiting;
+		double				start;		// milliseconds since Run was called
+		double				end;
+	};
+
+	vector<Task> m_Tasks;
+	double m_WallTime = 0;
+};
@@ -0,0 +1,67 @@
+/* Copyright (c) 2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "Structures.h"
+
+//--------------------------------------------------------------------------------------
+// Functions
+//--------------------------------------------------------------------------------------
+
+namespace TextureCompression
+{
+	/**
+	* Size in bytes of one row of texels, or of one row of 4x4 blocks for the block compressed formats, and the number of those rows.
+	*/
+	size_t GetRowPitch(const TextureInfo &texture, UINT mip = 0);
+	UINT GetRowCount(const TextureInfo &texture, UINT mip = 0);
+
+	/**
+	* Byte offset of a mip level in the texture's pixels. The levels are stored largest first, each tightly packed.
+	*/
+	size_t GetMipOffset(const TextureInfo &texture, UINT mip);
+
+	/**
+	* Encode an RGBA8 texture and its mips as BC1 (opaque, 8 bytes per block) or BC7 (16 bytes per block), blocks in parallel.
+	* Textures whose sides are not multiples of 4 cannot be block compressed and are left as they are.
+	*/
+	void Compress(TextureInfo &texture, DXGI_FORMAT format);
+
+	/**
+	* Read and write a DDS file and its mips in RGBA8, BC1, or BC7. Texels are used as stored, so a DDS written by SaveDDS
+	* loads in the same orientation as the image it was converted from.
+	*/
+	void LoadDDS(const string &filepath, TextureInfo &texture);
+	void SaveDDS(const string &filepath, const TextureInfo &texture);
+
+	/**
+	* Read the size, format, and mip count of a DDS file into texture from its first size bytes, and return the offset of its
+	* texels in the file. The file must be long enough for the texels, fileSize bytes.
+	*/
+	size_t ReadDDSHeader(const UINT8* data, size_t size, size_t fileSize, const string &filepath, TextureInfo &texture);
+}
@@ -0,0 +1,102 @@
+/* Copyright (c) 2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "Structures.h"
+
+#include <stb_image.h>
+
+//--------------------------------------------------------------------------------------
+// Functions
+//--------------------------------------------------------------------------------------
+
+namespace Textures
+{
+	/**
+	* Texels repeating each atlas entry's edges around it.
+	*/
+	static const UINT AtlasPadding = 8;
+
+	/**
+	* Convert RGB, BGR or grey pixels to RGBA, rows in parallel. Flip reverses the row order and mirror the pixels within each row;
+	* both together turn the image a half turn.
+	*/
+	void ConvertPixels(const UINT8* source, PixelFormat format, UINT width, UINT height, bool flip, bool mirror, UINT8* destination);
+
+	/**
+	* Convert a three channel RGB texture to four channel RGBA. The pixels are written in reverse order, turning the image a half turn.
+	*/
+	void FormatTexture(TextureInfo &info, stbi_uc* pixels);
+
+	/**
+	* Build the full mip chain of an RGBA8 texture with a box filter, each level's rows in parallel.
+	*/
+	void GenerateMips(TextureInfo &info);
+
+	/**
+	* Downsample an RGBA8 texture to width x height with a separable area filter: each source row is filtered horizontally
+	* into a float row, then each target row sums the float rows under it, one texel per SSE register, rows in parallel.
+	* Mips are dropped and must be generated again. Textures are never upsampled.
+	*/
+	void ResampleTexture(TextureInfo &info, int width, int height);
+
+	/**
+	* Load an image, or a DDS file as it is stored
+	*/
+	TextureInfo LoadTexture(string filepath);
+
+	/**
+	* Load an image from encoded file data held in memory
+	*/
+	TextureInfo LoadTexture(const vector<UINT8> &data);
+	TextureInfo LoadTexture(const UINT8* data, size_t size);
+
+	/**
+	* Write a texture's mips to caller-provided memory laid out by footprints, one per mip.
+	*/
+	void WriteTexture(const TextureInfo &texture, UINT8* destination, const vector<TextureFootprint> &footprints);
+
+	/**
+	* Load a material's texture as it is uploaded: at its target size, mipped, and in the configured format. Atlases built at
+	* load are mipped and compressed as they are. DDS files are used as stored, with top mips dropped, or resampled if they are
+	* RGBA8 without mips, to reach the target size.
+	* With an allocator the texels are written to the memory it returns, such as a mapped upload heap, and the texture comes back
+	* without pixels. DDS files and texture cache hits that need no conversion go straight from the mapped file, anything
+	* converted is written once it is done.
+	*/
+	TextureInfo LoadMaterialTexture(const Material &material, const ConfigInfo &config, const TextureAllocator &allocate = TextureAllocator());
+
+	/**
+	* Pack RGBA8 textures into one square atlas, the smallest power of two that holds them up to the largest texture size
+	* D3D12 allows, halving every texture until they fit. Each texture is surrounded by padding texels repeating its edges,
+	* so filtering stays inside it down to the mip where the padding is one texel, and the atlas is mipped no further. Entries
+	* start on a 4x4 block of that mip, so block compression does not mix textures at any mip kept.
+	* The rectangle each texture's coordinates map into is returned as offset and scale in atlas UVs.
+	*/
+	TextureInfo BuildTextureAtlas(const vector<TextureInfo> &textures, UINT padding, vector<XMFLOAT4> &rects);
+}
@@ -41,15 +41,28 @@ namespace Utils
 	HRESULT ParseCommandLine(LPWSTR lpCmdLine, ConfigInfo &config);
 
 	vector<char> ReadFile(const string &filename);
+	void MapFile(const string &filename, MappedFile &file);
+	void UnmapFile(MappedFile &file);
+	string GetTemporaryPath(const string &filepath);
+	string GetExtension(const string &filepath);
 
 	void LoadModel(string filepath, Model &model, Material &material);
+	void LoadModels(const vector<string> &filepaths, Model &model, Material &material);
+	void LoadOBJ(string filepath, Model &model, Material &material);
+	void LoadGLB(string filepath, Model &model, Material &material);
+	void LoadPLY(string filepath, Model &model, Material &material);
+	void LoadScene(string filepath, Model &model, Material &material);
+	void SampleCameraPath(const vector<CameraKey> &path, double time, XMFLOAT3 &position, XMFLOAT3 &focus);
 
 	void LoadCustomScene(Model &model, Material &material);
 	void LoadCustomAdvancedScene(Model &model, Material &material);
 	void LoadSphere(Model &model, Material &material, XMFLOAT3 position, float scale, XMFLOAT3 color, XMFLOAT3 materialDesc);
+	void LoadStressScene(const string &spec, Model &model, Material &material);
 
 	void Validate(HRESULT hr, LPWSTR message);
+	void Log(const char* format, ...);
 
-	void FormatTexture(TextureInfo &info, stbi_uc* pixels);
-	TextureInfo LoadTexture(string filepath);
+	size_t GetWorkerCount();
+	void ParallelFor(size_t count, size_t grainSize, const function<void(size_t, size_t)> &body);
+	uint64_t HashCombine(uint64_t hash, uint64_t value);
 }
\ No newline at end of file
@@ -0,0 +1,65 @@
+/* Copyright (c) 2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "Structures.h"
+
+//--------------------------------------------------------------------------------------
+// Functions
+//--------------------------------------------------------------------------------------
+
+namespace VirtualTexture
+{
+	/**
+	* Lay out the pages of a texture's mips, tileWidth x tileHeight texels each. Mips from packedMip on are smaller than a page
+	* and stay resident, budgetPages is the number of physical page slots the residency manager fills.
+	*/
+	void Init(PageTable &table, UINT width, UINT height, UINT mipLevels, UINT tileWidth, UINT tileHeight, UINT packedMip, UINT budgetPages);
+
+	/**
+	* Page holding texel (x, y) of a mip, -1 for the packed mips. Pages of a mip are numbered in rows after those of the larger mips.
+	*/
+	int GetPage(const PageTable &table, UINT mip, UINT x, UINT y);
+
+	/**
+	* Number of 32-bit words of sampling feedback, one bit per page.
+	*/
+	UINT GetFeedbackWords(const PageTable &table);
+
+	/**
+	* Walk the page table as a sample at (u, v) does: the finest mip at or above mip whose page is resident.
+	*/
+	UINT Lookup(const PageTable &table, UINT mip, float u, float v);
+
+	/**
+	* Feed one frame of sampling feedback to the residency manager. Requested pages and the coarser pages under them are
+	* marked used, and missing pages take free slots or the least recently used slots not used this frame, coarsest
+	* first and at most maxUploads per frame. The mapping changes to apply are appended, evictions before the pages replacing them.
+	*/
+	void Update(PageTable &table, const UINT32* feedback, UINT maxUploads, vector<PageMapping> &mappings);
+}
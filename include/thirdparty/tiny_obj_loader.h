@@ -126,7 +126,7 @@ typedef struct {
   real_t origin_offset[3];  // -o u [v [w]] (default 0 0 0)
   real_t scale[3];          // -s u [v [w]] (default 1 1 1)
   real_t turbulence[3];     // -t u [v [w]] (default 0 0 0)
-  // int   texture_resolution; // -texres resolution (default = ?) TODO
+  int texture_resolution;   // -texres resolution (default 0, as stored)
   bool clamp;    // -clamp (default false)
   char imfchan;  // -imfchan (the default for bump is 'l' and for decal is 'm')
   bool blendu;   // -blendu (default on)
@@ -826,6 +826,7 @@ static bool ParseTextureNameAndOption(std::string *texname,
   texopt->turbulence[1] = 0.0f;
   texopt->turbulence[2] = 0.0f;
   texopt->type = TEXTURE_TYPE_NONE;
+  texopt->texture_resolution = 0;
 
   const char *token = linebuf;  // Assume line ends with NULL
 
@@ -872,6 +873,9 @@ static bool ParseTextureNameAndOption(std::string *texname,
     } else if ((0 == strncmp(token, "-mm", 3)) && IS_SPACE((token[3]))) {
       token += 4;
       parseReal2(&(texopt->brightness), &(texopt->contrast), &token, 0.0, 1.0);
+    } else if ((0 == strncmp(token, "-texres", 7)) && IS_SPACE((token[7]))) {
+      token += 8;
+      texopt->texture_resolution = parseInt(&token);
     } else {
       // Assume texture filename
       size_t len = strcspn(token, " \t\r");  // untile next space
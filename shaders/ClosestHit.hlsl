@@ -76,23 +76,35 @@ float specularScalar(float3 normal, float3 lightDir, float3 cameraDir, float pow
 	return specular;
 }
 
-// ---[ Closest Hit Shader ]---
-
-[shader("closesthit")]
-void ClosestHit(inout HitInfo payload : SV_RayPayload,
-				Attributes attrib : SV_IntersectionAttributes)
+/** Shade a hit point with its interpolated attributes, tracing the
+  * reflection and shadow rays. Shared by the triangle and sphere hit
+  * groups. */
+float3 Shade(HitInfo payload, VertexAttributes vertex)
 {
 	float3 staticPointLight = lightingInformation.xyz;
-	uint triangleIndex = PrimitiveIndex();
-	float3 barycentrics = float3((1.0f - attrib.uv.x - attrib.uv.y), attrib.uv.x, attrib.uv.y);
-	VertexAttributes vertex = GetVertexAttributes(triangleIndex, barycentrics);
 	float3 material = normalize(vertex.material);
 
+	// The ray cone's width at the hit, reflections carry it on with the same spread
+	float coneWidth = payload.ConeWidthAndSpread.x + (payload.ConeWidthAndSpread.y * RayTCurrent());
+
 	float3 color;
 	float3 vertexColor;
 	if (vertex.color.x > 1.5) {
-		int2 coord = floor(vertex.color.yz * textureResolution.x);
-		vertexColor = albedo.Load(int3(coord, 0)).rgb;
+		// Pick the LOD whose texels match the cone's footprint, wider where the surface is seen at a grazing angle, and filter
+		// between the two mips around it
+		float lod = vertex.texelDensity + log2(abs(coneWidth) / max(abs(dot(vertex.normal, WorldRayDirection())), 0.01));
+		lod = clamp(lod, 0, textureResolution.y - 1);
+		if (virtualTexture.x > 0) {
+			vertexColor = SampleVirtualTexture(vertex.color.yz, lod);
+		}
+		else {
+			vertexColor = albedo.SampleLevel(albedoSampler, vertex.color.yz, lod).rgb;
+		}
+
+		// Flag the texture while it is a placeholder, the application loads it once it sees the flag
+		if (textureResolution.z == 0) {
+			textureFeedback.Store(0, 1);
+		}
 	}
 	else {
 		vertexColor = vertex.color;
@@ -115,6 +127,7 @@ void ClosestHit(inout HitInfo payload : SV_RayPayload,
 	// Trace the shadow ray
 	HitInfo rayPayload;
 	rayPayload.ShadedColorAndHitT = float4(ray.Origin, payload.ShadedColorAndHitT.a + 1);
+	rayPayload.ConeWidthAndSpread = float2(coneWidth, payload.ConeWidthAndSpread.y);
 	float3 cameraPos = payload.ShadedColorAndHitT.xyz;
 	float3 cameraDir = normalize(vertex.position - cameraPos);
 
@@ -134,7 +147,7 @@ void ClosestHit(inout HitInfo payload : SV_RayPayload,
 				RAY_FLAG_NONE,
 				0xFF,
 				0,
-				0,
+				1,
 				0,
 				ray,
 				rayPayload);
@@ -155,7 +168,7 @@ void ClosestHit(inout HitInfo payload : SV_RayPayload,
 			RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH | RAY_FLAG_SKIP_CLOSEST_HIT_SHADER,
 			0xFF,
 			0,
-			0,
+			1,
 			0,
 			ray,
 			rayPayload);
@@ -171,5 +184,55 @@ void ClosestHit(inout HitInfo payload : SV_RayPayload,
 
 	color = material.x * diffuse * vertexColor + material.y * specular * specularColor + material.z * reflectionColor;
 
-	payload.ShadedColorAndHitT = float4(color, RayTCurrent());
+	return color;
+}
+
+// ---[ Closest Hit Shader ]---
+
+[shader("closesthit")]
+void ClosestHit(inout HitInfo payload : SV_RayPayload,
+				Attributes attrib : SV_IntersectionAttributes)
+{
+	uint triangleIndex = PrimitiveIndex();
+	float3 barycentrics = float3((1.0f - attrib.uv.x - attrib.uv.y), attrib.uv.x, attrib.uv.y);
+	VertexAttributes vertex = GetVertexAttributes(triangleIndex, barycentrics);
+
+	payload.ShadedColorAndHitT = float4(Shade(payload, vertex), RayTCurrent());
+}
+
+// ---[ Sphere Shaders ]---
+
+/** Intersect the ray with the unit sphere analytically. Each sphere is
+  * an instance, so the ray is already in the sphere's object space. The
+  * quadratic is solved in its half-b form, and the far root is used when
+  * the ray starts inside the sphere. */
+[shader("intersection")]
+void SphereIntersection()
+{
+	float3 origin = ObjectRayOrigin();
+	float3 direction = ObjectRayDirection();
+
+	float a = dot(direction, direction);
+	float b = dot(origin, direction);
+	float c = dot(origin, origin) - 1;
+	float discriminant = (b * b) - (a * c);
+	if (discriminant < 0) return;
+
+	float root = sqrt(discriminant);
+	float t = (-b - root) / a;
+	if (t < RayTMin()) t = (-b + root) / a;
+	if (t < RayTMin() || t > RayTCurrent()) return;
+
+	SphereAttributes attrib;
+	attrib.normal = origin + (direction * t);
+	ReportHit(t, 0, attrib);
+}
+
+[shader("closesthit")]
+void SphereClosestHit(inout HitInfo payload : SV_RayPayload,
+				SphereAttributes attrib : SV_IntersectionAttributes)
+{
+	VertexAttributes vertex = GetSphereAttributes(InstanceID(), attrib.normal);
+
+	payload.ShadedColorAndHitT = float4(Shade(payload, vertex), RayTCurrent());
 }
\ No newline at end of file
@@ -30,12 +30,17 @@
 struct HitInfo
 {
 	float4 ShadedColorAndHitT : SHADED_COLOR_AND_HIT_T;
+	float2 ConeWidthAndSpread : CONE_WIDTH_AND_SPREAD;	// ray cone at the ray origin, for texture LOD
 };
 
 struct Attributes {
 	float2 uv;
 };
 
+struct SphereAttributes {
+	float3 normal;		// object space, unit length
+};
+
 // ---[ Constant Buffers ]---
 
 cbuffer ViewCB : register(b0)
@@ -48,17 +53,31 @@ cbuffer ViewCB : register(b0)
 cbuffer LightingCB : register(b1)
 {
 	float4 lightingInformation;
-	float4 textureResolution;
+	float4 textureResolution;		// width, mip levels, and 0 while the texture is a placeholder
+	float4 virtualTexture;			// page width and height, first packed mip, and texture height, zero unless the texture is tiled
+};
+
+cbuffer GeometryCB : register(b2)
+{
+	uint indexOffset;		// byte offset of the geometry's indices in the index buffer
+	uint indexStride;		// 2 for 16-bit indices, 4 for 32-bit
+	uint baseVertex;
+	uint geometryPadding;
 };
 
 // ---[ Resources ]---
 
 RWTexture2D<float4> RTOutput				: register(u0);
+RWByteAddressBuffer textureFeedback			: register(u1);		// hit flag per material for placeholder textures, then a bit per virtual texture page
 RaytracingAccelerationStructure SceneBVH	: register(t0);
 
 ByteAddressBuffer indices					: register(t1);
-ByteAddressBuffer vertices					: register(t2);
+ByteAddressBuffer attributes				: register(t2);
 Texture2D<float4> albedo					: register(t3);
+ByteAddressBuffer spheres					: register(t4);
+ByteAddressBuffer positions					: register(t5);
+
+SamplerState albedoSampler					: register(s0);		// trilinear, clamped
 
 // ---[ Helper Functions ]---
 
@@ -68,36 +87,115 @@ struct VertexAttributes
 	float3 color;
 	float3 normal;
 	float3 material;
+	float texelDensity;		// 0.5 * log2(texel area / world area) of a textured triangle, the base of its ray cone LOD
 };
 
 uint3 GetIndices(uint triangleIndex)
 {
 	uint baseIndex = (triangleIndex * 3);
-	int address = (baseIndex * 4);
-	return indices.Load3(address);
+
+	if (indexStride == 2)
+	{
+		// Three 16-bit indices straddle two dwords, load the aligned pair and pick out the halves
+		uint address = indexOffset + (baseIndex * 2);
+		uint2 words = indices.Load2(address & ~3);
+		uint3 local = ((address & 2) == 0)
+			? uint3(words.x & 0xFFFF, words.x >> 16, words.y & 0xFFFF)
+			: uint3(words.x >> 16, words.y & 0xFFFF, words.y >> 16);
+		return local + baseVertex;
+	}
+
+	uint address = indexOffset + (baseIndex * 4);
+	return indices.Load3(address) + baseVertex;
 }
 
 VertexAttributes GetVertexAttributes(uint triangleIndex, float3 barycentrics)
 {
 	uint3 indices = GetIndices(triangleIndex);
 	VertexAttributes v;
-	v.position = float3(0, 0, 0);
+	v.position = WorldRayOrigin() + (WorldRayDirection() * RayTCurrent());
 	v.color = float3(0, 0, 0);
 	v.normal = float3(0, 0, 0);
 	v.material = float3(0, 0, 0);
+	v.texelDensity = 0;
 
+	// Positions are only stored in the AS vertex stream, the attribute stream holds color, normal, and material
+	float2 uvs[3];
 	for (uint i = 0; i < 3; i++)
 	{
-		int address = (indices[i] * 12) * 4;
-		v.position += asfloat(vertices.Load3(address)) * barycentrics[i];
+		int address = (indices[i] * 9) * 4;
+		float3 color = asfloat(attributes.Load3(address));
+		v.color += color * barycentrics[i];
+		uvs[i] = color.yz;
 		address += (3 * 4);
-		v.color += asfloat(vertices.Load3(address)) * barycentrics[i];
+		v.normal += asfloat(attributes.Load3(address)) * barycentrics[i];
 		address += (3 * 4);
-		v.normal += asfloat(vertices.Load3(address)) * barycentrics[i];
-		address += (3 * 4);
-		v.material += asfloat(vertices.Load3(address)) * barycentrics[i];
+		v.material += asfloat(attributes.Load3(address)) * barycentrics[i];
+	}
+	v.normal = normalize(mul(v.normal, (float3x3)WorldToObject3x4()));
+
+	// Textured triangles compare their texel area to their world space area once, the ray cone scales it per hit
+	if (v.color.x > 1.5)
+	{
+		float3 p0 = asfloat(positions.Load3(indices[0] * 12));
+		float3 e1 = mul((float3x3)ObjectToWorld3x4(), asfloat(positions.Load3(indices[1] * 12)) - p0);
+		float3 e2 = mul((float3x3)ObjectToWorld3x4(), asfloat(positions.Load3(indices[2] * 12)) - p0);
+		float2 t1 = (uvs[1] - uvs[0]) * textureResolution.x;
+		float2 t2 = (uvs[2] - uvs[0]) * textureResolution.x;
+
+		float texelArea = abs((t1.x * t2.y) - (t1.y * t2.x));
+		float worldArea = length(cross(e1, e2));
+		v.texelDensity = 0.5 * log2(max(texelArea, 1e-8) / max(worldArea, 1e-8));
 	}
-	v.normal = normalize(v.normal);
 
 	return v;
+}
+
+// Spheres are 10 floats: center, radius, color, and material. The center and radius are baked into the instance transform
+VertexAttributes GetSphereAttributes(uint sphereIndex, float3 normal)
+{
+	int address = ((sphereIndex * 10) + 4) * 4;
+	VertexAttributes v;
+	v.position = WorldRayOrigin() + (WorldRayDirection() * RayTCurrent());
+	v.color = asfloat(spheres.Load3(address));
+	v.material = asfloat(spheres.Load3(address + (3 * 4)));
+	v.normal = normalize(mul(normal, (float3x3)WorldToObject3x4()));
+	v.texelDensity = 0;
+
+	return v;
+}
+
+// Request the page of a tiled texture under uv at the LOD's finer mip, then filter from the finest LOD at or above it whose
+// texels are all mapped. Pages are numbered in rows, mip after mip, as VirtualTexture::GetPage numbers them. The packed
+// mips are always mapped.
+float3 SampleVirtualTexture(float2 uv, float lod)
+{
+	uint2 size = uint2(textureResolution.x, virtualTexture.w);
+	uint2 tile = uint2(virtualTexture.xy);
+	uint packedMip = (uint)virtualTexture.z;
+	uint mip = (uint)lod;
+	uv = saturate(uv);
+
+	if (mip < packedMip)
+	{
+		uint page = 0;
+		for (uint m = 0; m < mip; m++)
+		{
+			uint2 pages = (max(size >> m, 1) + tile - 1) / tile;
+			page += pages.x * pages.y;
+		}
+
+		uint2 mipSize = max(size >> mip, 1);
+		uint2 texel = min(uint2(uv * mipSize), mipSize - 1);
+		page += ((texel.y / tile.y) * ((mipSize.x + tile.x - 1) / tile.x)) + (texel.x / tile.x);
+		textureFeedback.InterlockedOr(4 + ((page / 32) * 4), 1u << (page % 32));
+	}
+
+	for (uint level = mip; level < (uint)textureResolution.y; level++)
+	{
+		uint status;
+		float4 color = albedo.SampleLevel(albedoSampler, uv, max(lod, (float)level), int2(0, 0), status);
+		if (CheckAccessFullyMapped(status)) return color.rgb;
+	}
+	return float3(0.5, 0.5, 0.5);
 }
\ No newline at end of file
@@ -46,16 +46,17 @@ void RayGen()
 	ray.TMin = 0.1f;
 	ray.TMax = 1000.f;	
 
-	// Trace the ray
+	// Trace the ray, its cone spreading by one pixel's angle
 	HitInfo payload;
 	payload.ShadedColorAndHitT = float4(ray.Origin, 0);
+	payload.ConeWidthAndSpread = float2(0, atan((2.f * viewOriginAndTanHalfFovY.w) / resolution.y));
 
 	TraceRay(
 		SceneBVH,
 		RAY_FLAG_NONE,
 		0xFF,
 		0,
-		0,
+		1,
 		0,
 		ray,
 		payload);
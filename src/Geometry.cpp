@@ -0,0 +1,1347 @@
+/* Copyright (c) 2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Geometry.h"
+#include "Utils.h"
+#include "HighResolutionClock.h"
+
+namespace Geometry
+{
+
+//--------------------------------------------------------------------------------------
+// Spatial Reordering
+//--------------------------------------------------------------------------------------
+
+/**
+* Spread the lower 10 bits of a value so there are two zero bits between each.
+*/
+static uint32_t ExpandBits(uint32_t v)
+{
+	v = (v * 0x00010001u) & 0xFF0000FFu;
+	v = (v * 0x00000101u) & 0x0F00F00Fu;
+	v = (v * 0x00000011u) & 0xC30C30C3u;
+	v = (v * 0x00000005u) & 0x49249249u;
+	return v;
+}
+
+/**
+* Compute a 30-bit Morton code for a point in the unit cube.
+*/
+static uint32_t Morton3D(XMFLOAT3 p)
+{
+	uint32_t x = static_cast<uint32_t>(min(max(p.x * 1024.f, 0.f), 1023.f));
+	uint32_t y = static_cast<uint32_t>(min(max(p.y * 1024.f, 0.f), 1023.f));
+	uint32_t z = static_cast<uint32_t>(min(max(p.z * 1024.f, 0.f), 1023.f));
+	return (ExpandBits(x) << 2) | (ExpandBits(y) << 1) | ExpandBits(z);
+}
+
+/**
+* Simulate a 32KB direct mapped cache with 64 byte lines over the position fetches of each triangle.
+* Returns the number of misses per triangle, used to compare index orderings.
+*/
+static float SimulatePositionCacheMisses(const Model &model)
+{
+	const size_t lineCount = 512;
+	vector<size_t> tags(lineCount, SIZE_MAX);
+	size_t misses = 0;
+
+	for (size_t i = 0; i < model.indices.size(); i++)
+	{
+		size_t line = (model.indices[i] * sizeof(XMFLOAT3)) / 64;
+		size_t slot = line % lineCount;
+		if (tags[slot] != line)
+		{
+			tags[slot] = line;
+			misses++;
+		}
+	}
+	return static_cast<float>(misses) / static_cast<float>(max(model.indices.size() / 3, (size_t)1));
+}
+
+/**
+* Parallel LSD radix sort of 32-bit keys, carrying a value alongside each key.
+* Each pass histograms contiguous partitions in parallel, then scatters them in order so the sort stays stable.
+*/
+static void RadixSort(vector<uint32_t> &keys, vector<uint32_t> &values)
+{
+	const size_t count = keys.size();
+	const size_t partitions = Utils::GetWorkerCount();
+	const size_t partitionSize = (count + partitions - 1) / partitions;
+
+	vector<uint32_t> tempKeys(count);
+	vector<uint32_t> tempValues(count);
+	vector<array<size_t, 256>> offsets(partitions);
+
+	for (uint32_t shift = 0; shift < 32; shift += 8)
+	{
+		// Count the digits of each partition
+		Utils::ParallelFor(partitions, 1, [&](size_t first, size_t last)
+		{
+			for (size_t p = first; p < last; p++)
+			{
+				offsets[p].fill(0);
+				size_t end = min((p + 1) * partitionSize, count);
+				for (size_t i = p * partitionSize; i < end; i++)
+				{
+					offsets[p][(keys[i] >> shift) & 0xFF]++;
+				}
+			}
+		});
+
+		// Turn the counts into scatter offsets, ordered by digit then partition
+		size_t sum = 0;
+		for (size_t digit = 0; digit < 256; digit++)
+		{
+			for (size_t p = 0; p < partitions; p++)
+			{
+				size_t digitCount = offsets[p][digit];
+				offsets[p][digit] = sum;
+				sum += digitCount;
+			}
+		}
+
+		// Scatter each partition to its reserved slots
+		Utils::ParallelFor(partitions, 1, [&](size_t first, size_t last)
+		{
+			for (size_t p = first; p < last; p++)
+			{
+				size_t end = min((p + 1) * partitionSize, count);
+				for (size_t i = p * partitionSize; i < end; i++)
+				{
+					size_t destination = offsets[p][(keys[i] >> shift) & 0xFF]++;
+					tempKeys[destination] = keys[i];
+					tempValues[destination] = values[i];
+				}
+			}
+		});
+
+		keys.swap(tempKeys);
+		values.swap(tempValues);
+	}
+}
+
+void ReorderModelMorton(Model &model)
+{
+	const size_t triangleCount = model.indices.size() / 3;
+	const size_t vertexCount = model.positions.size();
+	if (triangleCount < 2) return;
+
+	HighResolutionClock clock;
+	float missesBefore = SimulatePositionCacheMisses(model);
+
+	// Find the bounds of the model
+	const size_t partitions = Utils::GetWorkerCount();
+	vector<XMFLOAT3> partitionMin(partitions, XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX));
+	vector<XMFLOAT3> partitionMax(partitions, XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX));
+	const size_t partitionSize = (vertexCount + partitions - 1) / partitions;
+
+	Utils::ParallelFor(partitions, 1, [&](size_t first, size_t last)
+	{
+		for (size_t p = first; p < last; p++)
+		{
+			XMVECTOR vMin = XMLoadFloat3(&partitionMin[p]);
+			XMVECTOR vMax = XMLoadFloat3(&partitionMax[p]);
+			size_t end = min((p + 1) * partitionSize, vertexCount);
+			for (size_t i = p * partitionSize; i < end; i++)
+			{
+				XMVECTOR position = XMLoadFloat3(&model.positions[i]);
+				vMin = XMVectorMin(vMin, position);
+				vMax = XMVectorMax(vMax, position);
+			}
+			XMStoreFloat3(&partitionMin[p], vMin);
+			XMStoreFloat3(&partitionMax[p], vMax);
+		}
+	});
+
+	XMVECTOR boundsMin = XMLoadFloat3(&partitionMin[0]);
+	XMVECTOR boundsMax = XMLoadFloat3(&partitionMax[0]);
+	for (size_t p = 1; p < partitions; p++)
+	{
+		boundsMin = XMVectorMin(boundsMin, XMLoadFloat3(&partitionMin[p]));
+		boundsMax = XMVectorMax(boundsMax, XMLoadFloat3(&partitionMax[p]));
+	}
+	XMVECTOR extent = XMVectorMax(boundsMax - boundsMin, XMVectorReplicate(1e-6f));
+	XMVECTOR scale = XMVectorReciprocal(extent) * XMVectorReplicate(1.f / 3.f);
+	XMVECTOR offset = boundsMin * XMVectorReplicate(3.f);
+
+	// Compute the Morton code of each triangle centroid
+	vector<uint32_t> keys(triangleCount);
+	vector<uint32_t> order(triangleCount);
+	Utils::ParallelFor(triangleCount, 4096, [&](size_t first, size_t last)
+	{
+		for (size_t t = first; t < last; t++)
+		{
+			XMVECTOR sum = XMLoadFloat3(&model.positions[model.indices[t * 3 + 0]]);
+			sum += XMLoadFloat3(&model.positions[model.indices[t * 3 + 1]]);
+			sum += XMLoadFloat3(&model.positions[model.indices[t * 3 + 2]]);
+
+			XMFLOAT3 normalized;
+			XMStoreFloat3(&normalized, (sum - offset) * scale);
+			keys[t] = Morton3D(normalized);
+			order[t] = static_cast<uint32_t>(t);
+		}
+	});
+
+	RadixSort(keys, order);
+
+	// Keep each mesh's triangles inside its own index range
+	if (model.meshes.size() > 1)
+	{
+		vector<uint32_t> triangleMesh(triangleCount, 0);
+		vector<size_t> cursor(model.meshes.size());
+		for (size_t m = 0; m < model.meshes.size(); m++)
+		{
+			const Mesh &mesh = model.meshes[m];
+			cursor[m] = mesh.firstIndex / 3;
+			fill(triangleMesh.begin() + (mesh.firstIndex / 3), triangleMesh.begin() + ((mesh.firstIndex + mesh.indexCount) / 3), static_cast<uint32_t>(m));
+		}
+
+		vector<uint32_t> grouped(triangleCount);
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			grouped[cursor[triangleMesh[order[t]]]++] = order[t];
+		}
+		order.swap(grouped);
+	}
+
+	// Renumber the vertices in the order the sorted triangles first reference them
+	vector<uint32_t> remap(vertexCount, UINT32_MAX);
+	vector<uint32_t> indices(model.indices.size());
+	uint32_t nextVertex = 0;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		for (size_t corner = 0; corner < 3; corner++)
+		{
+			uint32_t vertex = model.indices[order[t] * 3 + corner];
+			if (remap[vertex] == UINT32_MAX) remap[vertex] = nextVertex++;
+			indices[t * 3 + corner] = remap[vertex];
+		}
+	}
+
+	// Unreferenced vertices keep their relative order at the end of the streams
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		if (remap[v] == UINT32_MAX) remap[v] = nextVertex++;
+	}
+
+	// Move the vertex streams to their new locations
+	vector<XMFLOAT3> positions(vertexCount);
+	vector<VertexAttributes> attributes(vertexCount);
+	Utils::ParallelFor(vertexCount, 4096, [&](size_t first, size_t last)
+	{
+		for (size_t v = first; v < last; v++)
+		{
+			positions[remap[v]] = model.positions[v];
+			attributes[remap[v]] = model.attributes[v];
+		}
+	});
+
+	model.positions.swap(positions);
+	model.attributes.swap(attributes);
+	model.indices.swap(indices);
+
+	clock.Tick();
+	float missesAfter = SimulatePositionCacheMisses(model);
+	Utils::Log("Morton reorder: %zu triangles in %.2f ms, simulated position cache misses per triangle %.3f -> %.3f\n",
+		triangleCount, clock.GetDeltaMilliseconds(), missesBefore, missesAfter);
+}
+
+//--------------------------------------------------------------------------------------
+// Level of Detail
+//--------------------------------------------------------------------------------------
+
+/**
+* Give models loaded without mesh information a single mesh, and meshes without instances an identity instance.
+*/
+static void AddDefaultMeshes(Model &model)
+{
+	if (model.meshes.empty() && !model.indices.empty())
+	{
+		Mesh mesh = {};
+		mesh.indexCount = model.indices.size();
+		model.meshes.push_back(mesh);
+	}
+
+	if (model.instances.empty())
+	{
+		for (size_t m = 0; m < model.meshes.size(); m++)
+		{
+			MeshInstance instance = {};
+			instance.mesh = static_cast<uint32_t>(m);
+			XMStoreFloat4x4(&instance.transform, XMMatrixIdentity());
+			model.instances.push_back(instance);
+		}
+	}
+}
+
+/**
+* A symmetric 4x4 error quadric, storing the upper triangle.
+*/
+struct Quadric
+{
+	double a[10];
+
+	void AddPlane(double x, double y, double z, double d, double weight)
+	{
+		a[0] += weight * x * x; a[1] += weight * x * y; a[2] += weight * x * z; a[3] += weight * x * d;
+		a[4] += weight * y * y; a[5] += weight * y * z; a[6] += weight * y * d;
+		a[7] += weight * z * z; a[8] += weight * z * d;
+		a[9] += weight * d * d;
+	}
+
+	void Add(const Quadric &q)
+	{
+		for (int i = 0; i < 10; i++) a[i] += q.a[i];
+	}
+
+	double Evaluate(const XMFLOAT3 &p) const
+	{
+		double x = p.x, y = p.y, z = p.z;
+		return a[0] * x * x + 2 * a[1] * x * y + 2 * a[2] * x * z + 2 * a[3] * x
+			+ a[4] * y * y + 2 * a[5] * y * z + 2 * a[6] * y
+			+ a[7] * z * z + 2 * a[8] * z
+			+ a[9];
+	}
+};
+
+struct CollapseCandidate
+{
+	double		cost;
+	uint32_t	source;			// welded vertex removed by the collapse
+	uint32_t	target;			// welded vertex it merges into
+
+	bool operator<(const CollapseCandidate &other) const { return cost < other.cost; }
+};
+
+static XMVECTOR GetTriangleNormal(const XMFLOAT3 &a, const XMFLOAT3 &b, const XMFLOAT3 &c)
+{
+	XMVECTOR p0 = XMLoadFloat3(&a);
+	return XMVector3Cross(XMLoadFloat3(&b) - p0, XMLoadFloat3(&c) - p0);
+}
+
+/**
+* Simplify a triangle list with quadric error edge collapses, writing a level each time it reaches the next of the decreasing
+* targets, or a last level when no further collapse is possible. The quadrics are built once from the source triangles and
+* merged on each collapse, so costs measure the error against the source and each level continues from the previous one.
+* Vertices sharing a position are welded, and welded vertices on attribute seams or open borders are kept, so collapses move
+* existing vertices onto their neighbors and the levels index the source vertex streams.
+*/
+static void SimplifyTriangles(const vector<XMFLOAT3> &positions, const uint32_t* indices, size_t indexCount, const vector<size_t> &targets, vector<vector<uint32_t>> &levels)
+{
+	vector<uint32_t> result(indices, indices + indexCount);
+
+	// Weld the referenced vertices by position, sorting them so equal positions are adjacent
+	vector<uint32_t> vertices(result);
+	sort(vertices.begin(), vertices.end());
+	vertices.erase(unique(vertices.begin(), vertices.end()), vertices.end());
+	if (vertices.empty() || targets.empty()) return;
+
+	auto positionKey = [&](uint32_t vertex)
+	{
+		array<uint32_t, 3> key;
+		memcpy(key.data(), &positions[vertex], sizeof(XMFLOAT3));
+		return key;
+	};
+	sort(vertices.begin(), vertices.end(), [&](uint32_t a, uint32_t b) { return positionKey(a) < positionKey(b); });
+
+	// Welded vertex of each source vertex, over the range of vertices the mesh references
+	const uint32_t firstVertex = *min_element(vertices.begin(), vertices.end());
+	const uint32_t lastVertex = *max_element(vertices.begin(), vertices.end());
+	vector<uint32_t> vertexClass(lastVertex - firstVertex + 1, UINT32_MAX);
+	vector<XMFLOAT3> classPositions;
+	vector<uint32_t> classVertexCount;
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		if (i == 0 || positionKey(vertices[i]) != positionKey(vertices[i - 1]))
+		{
+			classPositions.push_back(positions[vertices[i]]);
+			classVertexCount.push_back(0);
+		}
+		vertexClass[vertices[i] - firstVertex] = static_cast<uint32_t>(classPositions.size() - 1);
+		classVertexCount.back()++;
+	}
+
+	const size_t classCount = classPositions.size();
+	vector<uint32_t> triangleClasses;
+	vector<Quadric> quadrics(classCount);
+	vector<uint32_t> adjacencyStart(classCount + 1);
+	vector<uint32_t> adjacency;
+	vector<uint64_t> edges;
+	vector<UINT8> border(classCount);
+	vector<UINT8> locked(classCount);
+	vector<CollapseCandidate> candidates;
+
+	size_t level = 0;
+	int levelPasses = 0;
+	bool stalled = false;
+	for (int pass = 0; ; pass++)
+	{
+		// Drop triangles collapsed to lines and look up the welded corners
+		size_t triangleCount = 0;
+		triangleClasses.resize(result.size());
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			uint32_t a = vertexClass[result[i] - firstVertex], b = vertexClass[result[i + 1] - firstVertex], c = vertexClass[result[i + 2] - firstVertex];
+			if (a == b || b == c || a == c) continue;
+
+			memmove(&result[triangleCount * 3], &result[i], 3 * sizeof(uint32_t));
+			triangleClasses[triangleCount * 3 + 0] = a;
+			triangleClasses[triangleCount * 3 + 1] = b;
+			triangleClasses[triangleCount * 3 + 2] = c;
+			triangleCount++;
+		}
+		result.resize(triangleCount * 3);
+		triangleClasses.resize(triangleCount * 3);
+
+		while (level < targets.size() && triangleCount <= targets[level])
+		{
+			levels.push_back(result);
+			level++;
+			levelPasses = 0;
+		}
+		if (level == targets.size()) break;
+
+		// A level the collapses cannot reach ends the chain at the coarsest result
+		if (stalled || levelPasses++ == 64)
+		{
+			levels.push_back(result);
+			break;
+		}
+
+		// Accumulate the area weighted planes of the source triangles once, collapses then carry them along
+		if (pass == 0)
+		{
+			for (size_t t = 0; t < triangleCount; t++)
+			{
+				const uint32_t* corner = &triangleClasses[t * 3];
+				XMFLOAT3 normal;
+				XMVECTOR n = GetTriangleNormal(classPositions[corner[0]], classPositions[corner[1]], classPositions[corner[2]]);
+				float area = XMVectorGetX(XMVector3Length(n)) * 0.5f;
+				if (area > 0) XMStoreFloat3(&normal, XMVector3Normalize(n));
+				else normal = XMFLOAT3(0, 0, 0);
+
+				const XMFLOAT3 &p = classPositions[corner[0]];
+				double d = -(double(normal.x) * p.x + double(normal.y) * p.y + double(normal.z) * p.z);
+				for (int i = 0; i < 3; i++) quadrics[corner[i]].AddPlane(normal.x, normal.y, normal.z, d, area);
+			}
+		}
+
+		// Link welded vertices to their triangles
+		fill(adjacencyStart.begin(), adjacencyStart.end(), 0);
+		for (size_t t = 0; t < triangleCount * 3; t++) adjacencyStart[triangleClasses[t] + 1]++;
+		for (size_t c = 0; c < classCount; c++) adjacencyStart[c + 1] += adjacencyStart[c];
+		adjacency.resize(triangleCount * 3);
+		{
+			vector<uint32_t> cursor(adjacencyStart.begin(), adjacencyStart.end() - 1);
+			for (size_t t = 0; t < triangleCount; t++)
+			{
+				for (int i = 0; i < 3; i++) adjacency[cursor[triangleClasses[t * 3 + i]]++] = static_cast<uint32_t>(t);
+			}
+		}
+
+		// Edges used by a single triangle are on an open border
+		edges.clear();
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				uint32_t a = triangleClasses[t * 3 + i], b = triangleClasses[t * 3 + (i + 1) % 3];
+				edges.push_back((static_cast<uint64_t>(min(a, b)) << 32) | max(a, b));
+			}
+		}
+		sort(edges.begin(), edges.end());
+		fill(border.begin(), border.end(), 0);
+		for (size_t e = 0; e < edges.size();)
+		{
+			size_t next = e + 1;
+			while (next < edges.size() && edges[next] == edges[e]) next++;
+			if (next - e == 1)
+			{
+				border[edges[e] >> 32] = 1;
+				border[edges[e] & 0xFFFFFFFF] = 1;
+			}
+			e = next;
+		}
+		edges.erase(unique(edges.begin(), edges.end()), edges.end());
+
+		// Score each edge by the cheaper of its two collapse directions
+		candidates.clear();
+		for (uint64_t edge : edges)
+		{
+			uint32_t a = static_cast<uint32_t>(edge >> 32), b = static_cast<uint32_t>(edge & 0xFFFFFFFF);
+			bool collapseA = !border[a] && classVertexCount[a] == 1;
+			bool collapseB = !border[b] && classVertexCount[b] == 1;
+			if (!collapseA && !collapseB) continue;
+
+			Quadric q = quadrics[a];
+			q.Add(quadrics[b]);
+			double costA = collapseA ? q.Evaluate(classPositions[b]) : DBL_MAX;
+			double costB = collapseB ? q.Evaluate(classPositions[a]) : DBL_MAX;
+			CollapseCandidate candidate = { min(costA, costB), costA <= costB ? a : b, costA <= costB ? b : a };
+			candidates.push_back(candidate);
+		}
+		sort(candidates.begin(), candidates.end());
+
+		// Collapse the cheapest edges whose neighborhoods do not overlap
+		fill(locked.begin(), locked.end(), 0);
+		size_t removed = 0;
+		size_t collapses = 0;
+		for (const CollapseCandidate &candidate : candidates)
+		{
+			if (triangleCount - removed <= targets[level]) break;
+
+			uint32_t u = candidate.source, v = candidate.target;
+			if (locked[u] || locked[v]) continue;
+
+			// Reject collapses that flip or squash a triangle around the removed vertex
+			bool valid = true;
+			size_t shared = 0;
+			uint32_t targetVertex = UINT32_MAX;
+			for (uint32_t k = adjacencyStart[u]; k < adjacencyStart[u + 1] && valid; k++)
+			{
+				uint32_t t = adjacency[k];
+				const uint32_t* corner = &triangleClasses[t * 3];
+				if (corner[0] == v || corner[1] == v || corner[2] == v)
+				{
+					shared++;
+					for (int i = 0; i < 3; i++) if (corner[i] == v) targetVertex = result[t * 3 + i];
+					continue;
+				}
+
+				XMFLOAT3 moved[3] = { classPositions[corner[0]], classPositions[corner[1]], classPositions[corner[2]] };
+				for (int i = 0; i < 3; i++) if (corner[i] == u) moved[i] = classPositions[v];
+
+				XMVECTOR before = GetTriangleNormal(classPositions[corner[0]], classPositions[corner[1]], classPositions[corner[2]]);
+				XMVECTOR after = GetTriangleNormal(moved[0], moved[1], moved[2]);
+				float beforeLength = XMVectorGetX(XMVector3Length(before));
+				float afterLength = XMVectorGetX(XMVector3Length(after));
+				if (afterLength <= 1e-3f * beforeLength || XMVectorGetX(XMVector3Dot(before, after)) < 0.25f * beforeLength * afterLength) valid = false;
+			}
+			if (!valid || targetVertex == UINT32_MAX) continue;
+
+			// Move the removed vertex's corners onto the vertex the shared edge uses on this side of any seam
+			for (uint32_t k = adjacencyStart[u]; k < adjacencyStart[u + 1]; k++)
+			{
+				uint32_t t = adjacency[k];
+				for (int i = 0; i < 3; i++)
+				{
+					uint32_t c = triangleClasses[t * 3 + i];
+					locked[c] = 1;
+					if (c == u) result[t * 3 + i] = targetVertex;
+				}
+			}
+			quadrics[v].Add(quadrics[u]);
+			removed += shared;
+			collapses++;
+		}
+
+		stalled = (collapses == 0);
+	}
+}
+
+void GenerateMeshLods(Model &model, uint32_t maxLevels)
+{
+	HighResolutionClock clock;
+	const size_t minTriangles = 64;
+
+	AddDefaultMeshes(model);
+	const size_t meshCount = model.meshes.size();
+
+	// Compute an object space bounding sphere for each source mesh
+	Utils::ParallelFor(meshCount, 1, [&](size_t first, size_t last)
+	{
+		for (size_t m = first; m < last; m++)
+		{
+			Mesh &mesh = model.meshes[m];
+			XMVECTOR lower = XMVectorReplicate(FLT_MAX);
+			XMVECTOR upper = XMVectorReplicate(-FLT_MAX);
+			for (size_t i = mesh.firstIndex; i < mesh.firstIndex + mesh.indexCount; i++)
+			{
+				XMVECTOR p = XMLoadFloat3(&model.positions[model.indices[i]]);
+				lower = XMVectorMin(lower, p);
+				upper = XMVectorMax(upper, p);
+			}
+
+			XMVECTOR center = (lower + upper) * 0.5f;
+			float radius = 0;
+			for (size_t i = mesh.firstIndex; i < mesh.firstIndex + mesh.indexCount; i++)
+			{
+				radius = max(radius, XMVectorGetX(XMVector3Length(XMLoadFloat3(&model.positions[model.indices[i]]) - center)));
+			}
+
+			XMFLOAT3 c;
+			XMStoreFloat3(&c, center);
+			mesh.bounds = XMFLOAT4(c.x, c.y, c.z, radius);
+		}
+	});
+
+	// Simplify each mesh's chain of levels independently
+	struct LodTask { uint32_t mesh; vector<size_t> targets; vector<vector<uint32_t>> levels; };
+	vector<LodTask> tasks;
+	for (uint32_t m = 0; m < meshCount; m++)
+	{
+		LodTask task = { m };
+		size_t triangles = model.meshes[m].indexCount / 3;
+		for (uint32_t level = 1; level <= maxLevels && (triangles >> level) >= minTriangles; level++) task.targets.push_back(triangles >> level);
+		if (!task.targets.empty()) tasks.push_back(move(task));
+	}
+
+	Utils::ParallelFor(tasks.size(), 1, [&](size_t first, size_t last)
+	{
+		for (size_t t = first; t < last; t++)
+		{
+			const Mesh &mesh = model.meshes[tasks[t].mesh];
+			SimplifyTriangles(model.positions, &model.indices[mesh.firstIndex], mesh.indexCount, tasks[t].targets, tasks[t].levels);
+		}
+	});
+
+	// Keep the levels that meaningfully reduce the previous one, appending them after the source meshes
+	size_t sourceTriangles = model.indices.size() / 3;
+	size_t levelCount = 0;
+	for (const LodTask &task : tasks)
+	{
+		model.meshes[task.mesh].firstLod = static_cast<uint32_t>(model.meshes.size());
+		for (const vector<uint32_t> &indices : task.levels)
+		{
+			const Mesh &source = model.meshes[task.mesh];
+			size_t previous = (source.lodCount == 0) ? source.indexCount : model.meshes[source.firstLod + source.lodCount - 1].indexCount;
+			if (indices.size() * 4 > previous * 3) break;
+
+			Mesh lod = {};
+			lod.firstIndex = model.indices.size();
+			lod.indexCount = indices.size();
+			lod.bounds = source.bounds;
+			model.indices.insert(model.indices.end(), indices.begin(), indices.end());
+			model.meshes.push_back(lod);
+
+			// The push may have moved the source mesh
+			model.meshes[task.mesh].lodCount++;
+			levelCount++;
+		}
+	}
+
+	clock.Tick();
+	Utils::Log("Mesh LODs: %zu levels for %zu meshes in %.2f ms, %zu source triangles, %zu LOD triangles\n",
+		levelCount, meshCount, clock.GetDeltaMilliseconds(), sourceTriangles, model.indices.size() / 3 - sourceTriangles);
+}
+
+bool SelectMeshLods(Model &model, XMFLOAT3 eye, float tanHalfFovY, float screenHeight)
+{
+	const float pixelsPerTriangle = 4.f;
+	const float switchMargin = 0.1f;
+	bool changed = false;
+
+	for (MeshInstance &instance : model.instances)
+	{
+		const Mesh &mesh = model.meshes[instance.mesh];
+		uint32_t level = 0;
+
+		if (mesh.lodCount > 0)
+		{
+			// Move the bounding sphere to world space, scaling by the largest axis of the transform
+			XMMATRIX transform = XMLoadFloat4x4(&instance.transform);
+			XMVECTOR center = XMVector3Transform(XMVectorSet(mesh.bounds.x, mesh.bounds.y, mesh.bounds.z, 1.f), transform);
+			float scale = max(max(XMVectorGetX(XMVector3Length(transform.r[0])), XMVectorGetX(XMVector3Length(transform.r[1]))), XMVectorGetX(XMVector3Length(transform.r[2])));
+			float radius = mesh.bounds.w * scale;
+			float distance = XMVectorGetX(XMVector3Length(center - XMLoadFloat3(&eye)));
+
+			if (distance > radius)
+			{
+				float projectedRadius = radius / (distance * tanHalfFovY) * screenHeight * 0.5f;
+				float desiredTriangles = XM_PI * projectedRadius * projectedRadius / pixelsPerTriangle;
+
+				// Use the coarsest level that still has enough triangles
+				auto coarsestLevel = [&](float triangles)
+				{
+					uint32_t coarsest = 0;
+					for (uint32_t l = 1; l <= mesh.lodCount; l++)
+					{
+						if (model.meshes[mesh.firstLod + l - 1].indexCount / 3 < triangles) break;
+						coarsest = l;
+					}
+					return coarsest;
+				};
+
+				// Coarsen only when enough triangles are left with the margin to spare, refine only once short by the margin
+				uint32_t coarser = coarsestLevel(desiredTriangles * (1.f + switchMargin));
+				uint32_t finer = coarsestLevel(desiredTriangles * (1.f - switchMargin));
+				level = min(max(instance.lod, coarser), finer);
+			}
+		}
+
+		changed |= (instance.lod != level);
+		instance.lod = level;
+	}
+
+	return changed;
+}
+
+uint32_t GetInstanceMesh(const Model &model, const MeshInstance &instance)
+{
+	const Mesh &mesh = model.meshes[instance.mesh];
+	return (instance.lod == 0) ? instance.mesh : mesh.firstLod + instance.lod - 1;
+}
+
+//--------------------------------------------------------------------------------------
+// Mesh Cleaning
+//--------------------------------------------------------------------------------------
+
+/**
+* Sort a vector by splitting it into a range per worker, sorting the ranges in parallel, and merging them pairwise.
+*/
+template <typename T, typename Compare>
+static void ParallelSort(vector<T> &values, Compare compare)
+{
+	size_t ranges = min(Utils::GetWorkerCount(), max(values.size() / 65536, (size_t)1));
+	size_t rangeSize = (values.size() + ranges - 1) / ranges;
+	auto rangeBegin = [&](size_t r) { return values.begin() + min(r * rangeSize, values.size()); };
+
+	Utils::ParallelFor(ranges, 1, [&](size_t first, size_t last)
+	{
+		for (size_t r = first; r < last; r++) sort(rangeBegin(r), rangeBegin(r + 1), compare);
+	});
+
+	for (size_t width = 1; width < ranges; width *= 2)
+	{
+		size_t merges = (ranges + 2 * width - 1) / (2 * width);
+		Utils::ParallelFor(merges, 1, [&](size_t first, size_t last)
+		{
+			for (size_t m = first; m < last; m++)
+			{
+				size_t r = m * 2 * width;
+				inplace_merge(rangeBegin(r), rangeBegin(r + width), rangeBegin(r + 2 * width), compare);
+			}
+		});
+	}
+}
+
+static bool AttributesMatch(const XMFLOAT3 &a, const XMFLOAT3 &b)
+{
+	return fabsf(a.x - b.x) <= 1e-4f && fabsf(a.y - b.y) <= 1e-4f && fabsf(a.z - b.z) <= 1e-4f;
+}
+
+struct TriangleKey
+{
+	uint32_t	mesh;
+	uint32_t	corners[3];			// welded vertices, rotated to start at the smallest so the winding is kept
+	uint32_t	triangle;
+
+	bool operator<(const TriangleKey &other) const
+	{
+		if (mesh != other.mesh) return mesh < other.mesh;
+		if (corners[0] != other.corners[0]) return corners[0] < other.corners[0];
+		if (corners[1] != other.corners[1]) return corners[1] < other.corners[1];
+		if (corners[2] != other.corners[2]) return corners[2] < other.corners[2];
+		return triangle < other.triangle;
+	}
+};
+
+/**
+* Drop the vertices no triangle references, keeping the order of the rest. Returns the number of vertices removed.
+*/
+static size_t RemoveUnreferencedVertices(Model &model)
+{
+	const size_t vertexCount = model.positions.size();
+	vector<uint32_t> remap(vertexCount, 0);
+	for (uint32_t index : model.indices) remap[index] = 1;
+
+	uint32_t kept = 0;
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		if (!remap[v])
+		{
+			remap[v] = UINT32_MAX;
+			continue;
+		}
+		remap[v] = kept;
+		model.positions[kept] = model.positions[v];
+		model.attributes[kept] = model.attributes[v];
+		kept++;
+	}
+	model.positions.resize(kept);
+	model.attributes.resize(kept);
+
+	Utils::ParallelFor(model.indices.size(), 65536, [&](size_t first, size_t last)
+	{
+		for (size_t i = first; i < last; i++) model.indices[i] = remap[model.indices[i]];
+	});
+
+	return vertexCount - kept;
+}
+
+/**
+* Rotation that starts a triangle's welded corners at the smallest one, keeping their winding.
+*/
+static uint32_t GetCornerRotation(const uint32_t* corners)
+{
+	if (corners[1] < corners[0]) return (corners[2] < corners[1]) ? 2 : 1;
+	return (corners[2] < corners[0]) ? 2 : 0;
+}
+
+/**
+* Whether two triangles whose welded corners match in the same winding also match in every vertex attribute, corner by corner.
+*/
+static bool FaceAttributesMatch(const Model &model, const uint32_t* a, uint32_t rotationA, const uint32_t* b, uint32_t rotationB)
+{
+	for (uint32_t c = 0; c < 3; c++)
+	{
+		const VertexAttributes &attributesA = model.attributes[a[(c + rotationA) % 3]];
+		const VertexAttributes &attributesB = model.attributes[b[(c + rotationB) % 3]];
+		if (!AttributesMatch(attributesA.normal, attributesB.normal) || !AttributesMatch(attributesA.color, attributesB.color) ||
+			!AttributesMatch(attributesA.material, attributesB.material)) return false;
+	}
+	return true;
+}
+
+void CleanModel(Model &model)
+{
+	HighResolutionClock clock;
+
+	AddDefaultMeshes(model);
+	const size_t triangleCount = model.indices.size() / 3;
+	const size_t vertexCount = model.positions.size();
+	if (triangleCount == 0) return;
+
+	// Zero area is measured against the size of the model
+	XMVECTOR lower = XMVectorReplicate(FLT_MAX);
+	XMVECTOR upper = XMVectorReplicate(-FLT_MAX);
+	for (const XMFLOAT3 &p : model.positions)
+	{
+		lower = XMVectorMin(lower, XMLoadFloat3(&p));
+		upper = XMVectorMax(upper, XMLoadFloat3(&p));
+	}
+	float diagonal = XMVectorGetX(XMVector3Length(upper - lower));
+	float areaEpsilon = diagonal * diagonal * 1e-12f;
+
+	// Weld vertices by position, so faces that repeat a position through separate vertices are found, then compare their attributes
+	vector<uint32_t> order(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; v++) order[v] = v;
+	auto positionLess = [&](uint32_t a, uint32_t b)
+	{
+		const XMFLOAT3 &p = model.positions[a], &q = model.positions[b];
+		if (p.x != q.x) return p.x < q.x;
+		if (p.y != q.y) return p.y < q.y;
+		if (p.z != q.z) return p.z < q.z;
+		return a < b;
+	};
+	ParallelSort(order, positionLess);
+
+	vector<uint32_t> welded(vertexCount);
+	for (size_t i = 0, id = 0; i < vertexCount; i++)
+	{
+		if (i > 0 && memcmp(&model.positions[order[i]], &model.positions[order[i - 1]], sizeof(XMFLOAT3)) != 0) id++;
+		welded[order[i]] = static_cast<uint32_t>(id);
+	}
+
+	// Classify each triangle: 0 kept, 1 repeated vertex, 2 zero area, 3 duplicate face
+	vector<UINT8> removed(triangleCount, 0);
+	vector<TriangleKey> keys(triangleCount);
+	for (uint32_t m = 0; m < model.meshes.size(); m++)
+	{
+		const Mesh &mesh = model.meshes[m];
+		Utils::ParallelFor(mesh.indexCount / 3, 16384, [&](size_t first, size_t last)
+		{
+			for (size_t t = mesh.firstIndex / 3 + first; t < mesh.firstIndex / 3 + last; t++)
+			{
+				const uint32_t* triangle = &model.indices[t * 3];
+				TriangleKey &key = keys[t];
+				key.mesh = m;
+				key.triangle = static_cast<uint32_t>(t);
+				const uint32_t corners[3] = { welded[triangle[0]], welded[triangle[1]], welded[triangle[2]] };
+				const uint32_t rotation = GetCornerRotation(corners);
+				for (uint32_t c = 0; c < 3; c++) key.corners[c] = corners[(c + rotation) % 3];
+
+				if (corners[0] == corners[1] || corners[1] == corners[2] || corners[2] == corners[0])
+				{
+					removed[t] = 1;
+					continue;
+				}
+
+				XMVECTOR p0 = XMLoadFloat3(&model.positions[triangle[0]]);
+				XMVECTOR cross = XMVector3Cross(XMLoadFloat3(&model.positions[triangle[1]]) - p0, XMLoadFloat3(&model.positions[triangle[2]]) - p0);
+				if (XMVectorGetX(XMVector3LengthSq(cross)) * 0.25f <= areaEpsilon * areaEpsilon) removed[t] = 2;
+			}
+		});
+	}
+
+	// Sort the faces so repeats are adjacent. A face is a duplicate when an earlier face of its run matches it in every
+	// attribute, so the first occurrence of each distinct face is kept.
+	ParallelSort(keys, [](const TriangleKey &a, const TriangleKey &b) { return a < b; });
+	auto sameFace = [](const TriangleKey &a, const TriangleKey &b)
+	{
+		return a.mesh == b.mesh && memcmp(a.corners, b.corners, sizeof(a.corners)) == 0;
+	};
+	auto getRotation = [&](uint32_t t)
+	{
+		const uint32_t corners[3] = { welded[model.indices[t * 3]], welded[model.indices[t * 3 + 1]], welded[model.indices[t * 3 + 2]] };
+		return GetCornerRotation(corners);
+	};
+	vector<UINT8> duplicate(triangleCount, 0);
+	Utils::ParallelFor(triangleCount, 16384, [&](size_t first, size_t last)
+	{
+		for (size_t k = max(first, (size_t)1); k < last; k++)
+		{
+			const TriangleKey &key = keys[k];
+			if (removed[key.triangle] != 0 || !sameFace(key, keys[k - 1])) continue;
+
+			const uint32_t* triangle = &model.indices[key.triangle * 3];
+			const uint32_t rotation = getRotation(key.triangle);
+			for (size_t j = k; j-- > 0 && sameFace(key, keys[j]);)
+			{
+				const uint32_t* other = &model.indices[keys[j].triangle * 3];
+				if (removed[keys[j].triangle] == 0 && FaceAttributesMatch(model, triangle, rotation, other, getRotation(keys[j].triangle)))
+				{
+					duplicate[key.triangle] = 1;
+					break;
+				}
+			}
+		}
+	});
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		if (duplicate[t]) removed[t] = 3;
+	}
+
+	size_t counts[4] = {};
+	for (UINT8 reason : removed) counts[reason]++;
+	if (counts[0] == triangleCount)
+	{
+		clock.Tick();
+		Utils::Log("Mesh cleaning: nothing to remove from %zu triangles (%.2f ms)\n", triangleCount, clock.GetDeltaMilliseconds());
+		return;
+	}
+
+	// Compact the index ranges of each mesh. A mesh left with no triangles would reach the BLAS build with no geometry,
+	// so it is dropped like the loaders drop empty meshes, and its instances with it.
+	vector<uint32_t> meshRemap(model.meshes.size(), UINT32_MAX);
+	size_t write = 0;
+	uint32_t meshesKept = 0;
+	for (size_t m = 0; m < model.meshes.size(); m++)
+	{
+		Mesh mesh = model.meshes[m];
+		size_t firstIndex = write;
+		for (size_t t = mesh.firstIndex / 3; t < (mesh.firstIndex + mesh.indexCount) / 3; t++)
+		{
+			if (removed[t]) continue;
+			memmove(&model.indices[write], &model.indices[t * 3], 3 * sizeof(uint32_t));
+			write += 3;
+		}
+		mesh.firstIndex = firstIndex;
+		mesh.indexCount = write - firstIndex;
+		if (mesh.indexCount == 0) continue;
+
+		meshRemap[m] = meshesKept;
+		model.meshes[meshesKept++] = mesh;
+	}
+	model.indices.resize(write);
+	const size_t meshesRemoved = model.meshes.size() - meshesKept;
+	model.meshes.resize(meshesKept);
+
+	size_t instancesKept = 0;
+	for (const MeshInstance &instance : model.instances)
+	{
+		if (meshRemap[instance.mesh] == UINT32_MAX) continue;
+		model.instances[instancesKept] = instance;
+		model.instances[instancesKept++].mesh = meshRemap[instance.mesh];
+	}
+	model.instances.resize(instancesKept);
+
+	size_t verticesRemoved = RemoveUnreferencedVertices(model);
+
+	clock.Tick();
+	size_t trianglesRemoved = triangleCount - model.indices.size() / 3;
+	size_t bytesSaved = trianglesRemoved * 3 * sizeof(uint32_t) + verticesRemoved * (sizeof(XMFLOAT3) + sizeof(VertexAttributes));
+	Utils::Log("Mesh cleaning in %.2f ms: removed %zu triangles with a repeated vertex, %zu with zero area, %zu duplicate faces, %zu empty meshes, %zu unreferenced vertices\n",
+		clock.GetDeltaMilliseconds(), counts[1], counts[2], counts[3], meshesRemoved, verticesRemoved);
+	Utils::Log("Mesh cleaning: %zu -> %zu triangles, %.2f MB less geometry, BLAS build input reduced by %.1f%%\n",
+		triangleCount, model.indices.size() / 3, bytesSaved / (1024.0 * 1024.0), 100.0 * trianglesRemoved / triangleCount);
+}
+
+//--------------------------------------------------------------------------------------
+// Instancing
+//--------------------------------------------------------------------------------------
+
+/**
+* A rigid-motion invariant description of a mesh, used to find meshes that are copies of each other.
+*/
+struct MeshSignature
+{
+	uint64_t			hash;			// local topology and quantized distances from the centroid
+	vector<uint32_t>	vertices;		// referenced vertices in first use order
+	uint32_t			frame[3];		// local vertices spanning the mesh, used to solve for the transform
+	float				radius;
+	bool				valid;
+};
+
+static MeshSignature GetMeshSignature(const Model &model, const Mesh &mesh)
+{
+	MeshSignature signature = {};
+	signature.hash = 14695981039346656037ull;
+
+	// Number the vertices in first use order, so copies with the same topology line up vertex for vertex
+	unordered_map<uint32_t, uint32_t> local;
+	vector<uint32_t> localIndices(mesh.indexCount);
+	for (size_t i = 0; i < mesh.indexCount; i++)
+	{
+		uint32_t vertex = model.indices[mesh.firstIndex + i];
+		auto inserted = local.insert(make_pair(vertex, static_cast<uint32_t>(signature.vertices.size())));
+		if (inserted.second) signature.vertices.push_back(vertex);
+		localIndices[i] = inserted.first->second;
+		signature.hash = Utils::HashCombine(signature.hash, localIndices[i]);
+	}
+	if (signature.vertices.size() < 3) return signature;
+
+	XMVECTOR centroid = XMVectorZero();
+	for (uint32_t vertex : signature.vertices) centroid = centroid + XMLoadFloat3(&model.positions[vertex]);
+	centroid = centroid / static_cast<float>(signature.vertices.size());
+
+	vector<float> distances(signature.vertices.size());
+	for (size_t v = 0; v < signature.vertices.size(); v++)
+	{
+		distances[v] = XMVectorGetX(XMVector3Length(XMLoadFloat3(&model.positions[signature.vertices[v]]) - centroid));
+		signature.radius = max(signature.radius, distances[v]);
+	}
+	if (signature.radius <= 0) return signature;
+
+	// Distances from the centroid are unchanged by rotation and translation
+	for (float distance : distances) signature.hash = Utils::HashCombine(signature.hash, static_cast<uint64_t>(distance / signature.radius * 4096.f + 0.5f));
+	signature.hash = Utils::HashCombine(signature.hash, static_cast<uint64_t>(signature.radius * 4096.f + 0.5f));
+
+	// Pick the first vertex, the vertex farthest from it, and the vertex farthest from the line through both
+	XMVECTOR p0 = XMLoadFloat3(&model.positions[signature.vertices[0]]);
+	float farthest = 0;
+	signature.frame[0] = 0;
+	signature.frame[1] = 0;
+	for (uint32_t v = 1; v < signature.vertices.size(); v++)
+	{
+		float distance = XMVectorGetX(XMVector3LengthSq(XMLoadFloat3(&model.positions[signature.vertices[v]]) - p0));
+		if (distance > farthest)
+		{
+			farthest = distance;
+			signature.frame[1] = v;
+		}
+	}
+
+	XMVECTOR axis = XMVector3Normalize(XMLoadFloat3(&model.positions[signature.vertices[signature.frame[1]]]) - p0);
+	farthest = 0;
+	signature.frame[2] = 0;
+	for (uint32_t v = 1; v < signature.vertices.size(); v++)
+	{
+		float distance = XMVectorGetX(XMVector3LengthSq(XMVector3Cross(axis, XMLoadFloat3(&model.positions[signature.vertices[v]]) - p0)));
+		if (distance > farthest)
+		{
+			farthest = distance;
+			signature.frame[2] = v;
+		}
+	}
+
+	// A mesh flat along a line has no unique rotation
+	signature.valid = sqrtf(farthest) > signature.radius * 1e-3f;
+	return signature;
+}
+
+/**
+* Build an orthonormal frame from three local vertices of a mesh, origin in the last row.
+*/
+static XMMATRIX GetMeshFrame(const Model &model, const MeshSignature &signature, const vector<uint32_t> &vertices)
+{
+	XMVECTOR p0 = XMLoadFloat3(&model.positions[vertices[signature.frame[0]]]);
+	XMVECTOR p1 = XMLoadFloat3(&model.positions[vertices[signature.frame[1]]]);
+	XMVECTOR p2 = XMLoadFloat3(&model.positions[vertices[signature.frame[2]]]);
+
+	XMVECTOR x = XMVector3Normalize(p1 - p0);
+	XMVECTOR z = XMVector3Normalize(XMVector3Cross(x, p2 - p0));
+	XMVECTOR y = XMVector3Cross(z, x);
+
+	XMMATRIX frame;
+	frame.r[0] = x;
+	frame.r[1] = y;
+	frame.r[2] = z;
+	frame.r[3] = XMVectorSetW(p0, 1.f);
+	return frame;
+}
+
+/**
+* Find the rigid transform that maps the prototype onto the copy, checking every vertex position, normal, and attribute.
+*/
+static bool MatchMesh(const Model &model, const MeshSignature &prototype, const MeshSignature &copy, XMMATRIX &transform)
+{
+	if (copy.vertices.size() != prototype.vertices.size()) return false;
+
+	// Both frames are built from the same local vertices, so mapping one onto the other is rigid
+	XMMATRIX prototypeFrame = GetMeshFrame(model, prototype, prototype.vertices);
+	XMMATRIX copyFrame = GetMeshFrame(model, prototype, copy.vertices);
+	transform = XMMatrixInverse(nullptr, prototypeFrame) * copyFrame;
+
+	float tolerance = prototype.radius * 1e-4f + 1e-6f;
+	for (size_t v = 0; v < prototype.vertices.size(); v++)
+	{
+		const uint32_t a = prototype.vertices[v], b = copy.vertices[v];
+		XMVECTOR moved = XMVector3TransformCoord(XMLoadFloat3(&model.positions[a]), transform);
+		if (XMVectorGetX(XMVector3Length(moved - XMLoadFloat3(&model.positions[b]))) > tolerance) return false;
+
+		const VertexAttributes &attributesA = model.attributes[a], &attributesB = model.attributes[b];
+		XMFLOAT3 normal;
+		XMStoreFloat3(&normal, XMVector3TransformNormal(XMLoadFloat3(&attributesA.normal), transform));
+		if (!AttributesMatch(normal, attributesB.normal) || !AttributesMatch(attributesA.color, attributesB.color) || !AttributesMatch(attributesA.material, attributesB.material)) return false;
+	}
+
+	return true;
+}
+
+void InstanceRepeatedMeshes(Model &model)
+{
+	HighResolutionClock clock;
+
+	AddDefaultMeshes(model);
+	const size_t meshCount = model.meshes.size();
+	if (meshCount < 2) return;
+
+	const size_t vertexCount = model.positions.size();
+	const size_t indexCount = model.indices.size();
+
+	vector<MeshSignature> signatures(meshCount);
+	Utils::ParallelFor(meshCount, 1, [&](size_t first, size_t last)
+	{
+		for (size_t m = first; m < last; m++) signatures[m] = GetMeshSignature(model, model.meshes[m]);
+	});
+
+	// Group meshes with equal signatures, then match each against the earlier meshes of its group
+	vector<uint32_t> order(meshCount);
+	for (uint32_t m = 0; m < meshCount; m++) order[m] = m;
+	sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return signatures[a].hash != signatures[b].hash ? signatures[a].hash < signatures[b].hash : a < b; });
+
+	vector<uint32_t> prototypeOf(meshCount);
+	vector<XMFLOAT4X4> prototypeToCopy(meshCount);
+	for (uint32_t m = 0; m < meshCount; m++) prototypeOf[m] = m;
+
+	for (size_t start = 0; start < meshCount;)
+	{
+		size_t end = start + 1;
+		while (end < meshCount && signatures[order[end]].hash == signatures[order[start]].hash) end++;
+
+		vector<uint32_t> prototypes;
+		for (size_t g = start; g < end; g++)
+		{
+			uint32_t m = order[g];
+			if (!signatures[m].valid) continue;
+
+			bool matched = false;
+			for (uint32_t prototype : prototypes)
+			{
+				XMMATRIX transform;
+				if (!MatchMesh(model, signatures[prototype], signatures[m], transform)) continue;
+
+				prototypeOf[m] = prototype;
+				XMStoreFloat4x4(&prototypeToCopy[m], transform);
+				matched = true;
+				break;
+			}
+			if (!matched) prototypes.push_back(m);
+		}
+		start = end;
+	}
+
+	// Point the copies' instances at their prototype
+	size_t copies = 0;
+	for (uint32_t m = 0; m < meshCount; m++) copies += (prototypeOf[m] != m) ? 1 : 0;
+	if (copies == 0)
+	{
+		clock.Tick();
+		Utils::Log("Auto instancing: no repeated meshes among %zu meshes (%.2f ms)\n", meshCount, clock.GetDeltaMilliseconds());
+		return;
+	}
+
+	for (MeshInstance &instance : model.instances)
+	{
+		uint32_t m = instance.mesh;
+		if (prototypeOf[m] == m) continue;
+
+		XMMATRIX transform = XMLoadFloat4x4(&prototypeToCopy[m]) * XMLoadFloat4x4(&instance.transform);
+		XMStoreFloat4x4(&instance.transform, transform);
+		instance.mesh = prototypeOf[m];
+	}
+
+	// Keep only the prototypes' meshes and indices
+	vector<uint32_t> meshRemap(meshCount, UINT32_MAX);
+	vector<Mesh> meshes;
+	vector<uint32_t> indices;
+	indices.reserve(indexCount);
+	for (uint32_t m = 0; m < meshCount; m++)
+	{
+		if (prototypeOf[m] != m) continue;
+
+		Mesh mesh = model.meshes[m];
+		meshRemap[m] = static_cast<uint32_t>(meshes.size());
+		indices.insert(indices.end(), model.indices.begin() + mesh.firstIndex, model.indices.begin() + mesh.firstIndex + mesh.indexCount);
+		mesh.firstIndex = indices.size() - mesh.indexCount;
+		meshes.push_back(mesh);
+	}
+	for (MeshInstance &instance : model.instances) instance.mesh = meshRemap[instance.mesh];
+
+	model.meshes.swap(meshes);
+	model.indices.swap(indices);
+	RemoveUnreferencedVertices(model);
+
+	clock.Tick();
+	size_t bytesSaved = (vertexCount - model.positions.size()) * (sizeof(XMFLOAT3) + sizeof(VertexAttributes)) + (indexCount - model.indices.size()) * sizeof(uint32_t);
+	Utils::Log("Auto instancing: %zu meshes -> %zu unique meshes and %zu instances in %.2f ms, %zu -> %zu triangles stored, %.2f MB less geometry\n",
+		meshCount, model.meshes.size(), model.instances.size(), clock.GetDeltaMilliseconds(), indexCount / 3, model.indices.size() / 3, bytesSaved / (1024.0 * 1024.0));
+}
+
+//--------------------------------------------------------------------------------------
+// Geometry Chunks
+//--------------------------------------------------------------------------------------
+
+void BuildMeshChunks(Model &model, bool shortIndices)
+{
+	const uint32_t maxChunkVertices = 65535;
+	const size_t vertexCount = model.positions.size();
+	model.chunks.clear();
+	AddDefaultMeshes(model);
+
+	// Find the vertex range each mesh references
+	vector<uint32_t> meshMin(model.meshes.size(), UINT32_MAX);
+	vector<uint32_t> meshMax(model.meshes.size(), 0);
+	Utils::ParallelFor(model.meshes.size(), 1, [&](size_t first, size_t last)
+	{
+		for (size_t m = first; m < last; m++)
+		{
+			const Mesh &mesh = model.meshes[m];
+			for (size_t i = mesh.firstIndex; i < mesh.firstIndex + mesh.indexCount; i++)
+			{
+				meshMin[m] = min(meshMin[m], model.indices[i]);
+				meshMax[m] = max(meshMax[m], model.indices[i]);
+			}
+		}
+	});
+
+	bool relayout = false;
+	for (size_t m = 0; m < model.meshes.size(); m++)
+	{
+		if (shortIndices && model.meshes[m].indexCount > 0 && (meshMax[m] - meshMin[m]) >= maxChunkVertices) relayout = true;
+	}
+
+	// Meshes that already fit, or use 32-bit indices, need no vertex duplication
+	if (!relayout)
+	{
+		for (size_t m = 0; m < model.meshes.size(); m++)
+		{
+			Mesh &mesh = model.meshes[m];
+			mesh.firstChunk = static_cast<uint32_t>(model.chunks.size());
+			mesh.chunkCount = (mesh.indexCount > 0) ? 1 : 0;
+			if (mesh.chunkCount == 0) continue;
+
+			MeshChunk chunk = {};
+			chunk.firstIndex = mesh.firstIndex;
+			chunk.indexCount = static_cast<uint32_t>(mesh.indexCount);
+			chunk.baseVertex = meshMin[m];
+			chunk.vertexCount = meshMax[m] - meshMin[m] + 1;
+			chunk.indexStride = shortIndices ? sizeof(uint16_t) : sizeof(uint32_t);
+			model.chunks.push_back(chunk);
+		}
+		return;
+	}
+
+	HighResolutionClock clock;
+
+	vector<XMFLOAT3> positions;
+	vector<VertexAttributes> attributes;
+	positions.reserve(vertexCount);
+	attributes.reserve(vertexCount);
+
+	// Maps a model vertex to its slot in the open chunk, reset for each chunk through the touched list
+	vector<uint32_t> local(vertexCount, UINT32_MAX);
+	vector<uint32_t> touched;
+	touched.reserve(maxChunkVertices);
+
+	for (Mesh &mesh : model.meshes)
+	{
+		mesh.firstChunk = static_cast<uint32_t>(model.chunks.size());
+
+		MeshChunk chunk = {};
+		chunk.firstIndex = mesh.firstIndex;
+		chunk.baseVertex = static_cast<uint32_t>(positions.size());
+		chunk.indexStride = sizeof(uint16_t);
+
+		for (size_t i = mesh.firstIndex; i < mesh.firstIndex + mesh.indexCount; i += 3)
+		{
+			uint32_t* triangle = &model.indices[i];
+
+			// Count the vertices this triangle would add to the open chunk
+			uint32_t added = 0;
+			for (size_t corner = 0; corner < 3; corner++)
+			{
+				bool repeated = (corner > 0 && triangle[corner] == triangle[0]) || (corner > 1 && triangle[corner] == triangle[1]);
+				if (!repeated && local[triangle[corner]] == UINT32_MAX) added++;
+			}
+
+			// Close the chunk when the triangle does not fit
+			if (chunk.vertexCount + added > maxChunkVertices)
+			{
+				model.chunks.push_back(chunk);
+				for (uint32_t v : touched) local[v] = UINT32_MAX;
+				touched.clear();
+
+				chunk.firstIndex = i;
+				chunk.indexCount = 0;
+				chunk.baseVertex = static_cast<uint32_t>(positions.size());
+				chunk.vertexCount = 0;
+			}
+
+			for (size_t corner = 0; corner < 3; corner++)
+			{
+				uint32_t vertex = triangle[corner];
+				if (local[vertex] == UINT32_MAX)
+				{
+					local[vertex] = chunk.vertexCount++;
+					touched.push_back(vertex);
+					positions.push_back(model.positions[vertex]);
+					attributes.push_back(model.attributes[vertex]);
+				}
+				triangle[corner] = chunk.baseVertex + local[vertex];
+			}
+			chunk.indexCount += 3;
+		}
+
+		if (chunk.indexCount > 0) model.chunks.push_back(chunk);
+		for (uint32_t v : touched) local[v] = UINT32_MAX;
+		touched.clear();
+
+		mesh.chunkCount = static_cast<uint32_t>(model.chunks.size()) - mesh.firstChunk;
+	}
+
+	size_t duplicated = positions.size() - min(positions.size(), vertexCount);
+	model.positions.swap(positions);
+	model.attributes.swap(attributes);
+
+	clock.Tick();
+	Utils::Log("Mesh chunks: %zu chunks of at most %u vertices in %.2f ms, %zu vertices duplicated across chunk boundaries\n",
+		model.chunks.size(), maxChunkVertices, clock.GetDeltaMilliseconds(), duplicated);
+}
+
+}
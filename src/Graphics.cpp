@@ -27,6 +27,10 @@
 
 #include "Graphics.h"
 #include "InputState.h"
+#include "Geometry.h"
+#include "Textures.h"
+#include "TextureCompression.h"
+#include "VirtualTexture.h"
 
 //--------------------------------------------------------------------------------------
 // Resource Functions
@@ -37,6 +41,10 @@ using namespace InputSpace;
 namespace D3DResources
 {
 
+// Pages of a tiled texture copied in per frame, and the size of a page
+static const UINT MaxPageUploads = 16;
+static const UINT PageSize = D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES;
+
 /**
 * Create a matrix transform buffer and copy a transform to the upload heap.
 */
@@ -114,21 +122,32 @@ void Create_Buffer(D3D12Global &d3d, D3D12BufferCreateInfo& info, ID3D12Resource
 }
 
 /**
-* Create a texture.
+* Load a material's texture, from the image bytes embedded in the model when there are any, with the mips the hit shader
+* picks between from each ray's footprint.
 */
-void Create_Texture(D3D12Global &d3d, D3D12Resources &resources, Material &material) 
+static TextureInfo Load_Texture(const Material &material, const ConfigInfo &config)
 {
-	HRESULT hr;
-	TextureInfo texture;
+	TextureInfo texture = Textures::LoadMaterialTexture(material, config);
 
-	// Load the texture
-	texture = Utils::LoadTexture(material.texturePath);
-	material.textureResolution = static_cast<float>(texture.width);
+	if (config.saveTextures && !material.texturePath.empty() && Utils::GetExtension(material.texturePath) != ".dds")
+	{
+		TextureCompression::SaveDDS(material.texturePath + ".dds", texture);
+	}
+	return texture;
+}
+
+/**
+* Create the texture resource and its upload heap for a texture of the given size, format, and mip count. The upload heap is
+* left mapped, and where each mip goes in it is returned for the texels to be written in place before Record_Texture_Upload.
+*/
+static UINT8* Create_Texture_Upload(D3D12Global &d3d, D3D12Resources &resources, const TextureInfo &texture, vector<TextureFootprint> &footprints)
+{
+	HRESULT hr;
 
 	// Describe the texture
 	D3D12_RESOURCE_DESC textureDesc = {};
-	textureDesc.MipLevels = 1;
-	textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	textureDesc.MipLevels = static_cast<UINT16>(texture.mipLevels);
+	textureDesc.Format = texture.format;
 	textureDesc.Width = texture.width;
 	textureDesc.Height = texture.height;
 	textureDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
@@ -141,7 +160,10 @@ void Create_Texture(D3D12Global &d3d, D3D12Resources &resources, Material &mater
 	hr = d3d.device->CreateCommittedResource(&DefaultHeapProperties, D3D12_HEAP_FLAG_NONE, &textureDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&resources.texture));
 	Utils::Validate(hr, L"Error: failed to create texture!");
 
-	const UINT64 uploadBufferSize = GetRequiredIntermediateSize(resources.texture, 0, 1);
+	// Lay out the mips in the upload heap as the copy reads them
+	vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> layouts(texture.mipLevels);
+	UINT64 uploadBufferSize = 0;
+	d3d.device->GetCopyableFootprints(&textureDesc, 0, texture.mipLevels, 0, layouts.data(), nullptr, nullptr, &uploadBufferSize);
 
 	// Describe the resource
 	D3D12_RESOURCE_DESC resourceDesc = {};
@@ -161,13 +183,46 @@ void Create_Texture(D3D12Global &d3d, D3D12Resources &resources, Material &mater
 	hr = d3d.device->CreateCommittedResource(&UploadHeapProperties, D3D12_HEAP_FLAG_NONE, &resourceDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&resources.textureUploadHeap));
 	Utils::Validate(hr, L"Error: failed to create texture upload heap!");
 
-	D3D12_SUBRESOURCE_DATA textureData = {};
-	textureData.pData = texture.pixels.data();
-	textureData.RowPitch = texture.width * texture.stride;
-	textureData.SlicePitch = textureData.RowPitch * texture.height;
+	UINT8* pUploadDataBegin;
+	D3D12_RANGE readRange = {};
+	hr = resources.textureUploadHeap->Map(0, &readRange, reinterpret_cast<void**>(&pUploadDataBegin));
+	Utils::Validate(hr, L"Error: failed to map texture upload heap!");
 
-	// Schedule a copy from the upload heap to the Texture2D resource
-	UpdateSubresources(d3d.cmdList, resources.texture, resources.textureUploadHeap, 0, 0, 1, &textureData);
+	footprints.resize(layouts.size());
+	for (size_t mip = 0; mip < layouts.size(); mip++)
+	{
+		footprints[mip].offset = static_cast<size_t>(layouts[mip].Offset);
+		footprints[mip].rowPitch = layouts[mip].Footprint.RowPitch;
+	}
+	return pUploadDataBegin;
+}
+
+/**
+* Unmap the texture's upload heap, and record the copy of every mip and the transition to a shader resource.
+*/
+static void Record_Texture_Upload(D3D12Global &d3d, D3D12Resources &resources)
+{
+	resources.textureUploadHeap->Unmap(0, nullptr);
+
+	D3D12_RESOURCE_DESC textureDesc = resources.texture->GetDesc();
+	vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> layouts(textureDesc.MipLevels);
+	d3d.device->GetCopyableFootprints(&textureDesc, 0, textureDesc.MipLevels, 0, layouts.data(), nullptr, nullptr, nullptr);
+
+	// Schedule a copy of every level from the upload heap to the Texture2D resource
+	for (UINT mip = 0; mip < layouts.size(); mip++)
+	{
+		D3D12_TEXTURE_COPY_LOCATION destination = {};
+		destination.pResource = resources.texture;
+		destination.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+		destination.SubresourceIndex = mip;
+
+		D3D12_TEXTURE_COPY_LOCATION source = {};
+		source.pResource = resources.textureUploadHeap;
+		source.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+		source.PlacedFootprint = layouts[mip];
+
+		d3d.cmdList->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+	}
 
 	// Transition the texture to a shader resource
 	D3D12_RESOURCE_BARRIER barrier = {};
@@ -181,60 +236,524 @@ void Create_Texture(D3D12Global &d3d, D3D12Resources &resources, Material &mater
 	d3d.cmdList->ResourceBarrier(1, &barrier);
 }
 
+/**
+* Create the texture resource, and record the upload of a texture held in memory.
+*/
+static void Upload_Texture(D3D12Global &d3d, D3D12Resources &resources, const TextureInfo &texture)
+{
+	vector<TextureFootprint> footprints;
+	UINT8* destination = Create_Texture_Upload(d3d, resources, texture, footprints);
+	Textures::WriteTexture(texture, destination, footprints);
+	Record_Texture_Upload(d3d, resources);
+}
+
+/**
+* Create the texture as a reserved resource whose pages are mapped as sampling feedback asks for them. Pages live in a heap
+* of the configured budget, the packed mips behind them are mapped and uploaded once, and the texture is kept in system
+* memory to copy pages from. Returns false when the device has no tier 2 tiled resources, the shader needs their residency status.
+*/
+static bool Create_Virtual_Texture(D3D12Global &d3d, D3D12Resources &resources, const TextureInfo &texture, const ConfigInfo &config)
+{
+	HRESULT hr;
+
+	D3D12_FEATURE_DATA_D3D12_OPTIONS options = {};
+	hr = d3d.device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options));
+	if (FAILED(hr) || options.TiledResourcesTier < D3D12_TILED_RESOURCES_TIER_2)
+	{
+		Utils::Log("Virtual texture: tiled resources tier 2 is not supported, uploading the texture whole\n");
+		return false;
+	}
+
+	// Describe the texture, no memory backs it until its pages are mapped
+	D3D12_RESOURCE_DESC textureDesc = {};
+	textureDesc.MipLevels = static_cast<UINT16>(texture.mipLevels);
+	textureDesc.Format = texture.format;
+	textureDesc.Width = texture.width;
+	textureDesc.Height = texture.height;
+	textureDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+	textureDesc.DepthOrArraySize = 1;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.SampleDesc.Quality = 0;
+	textureDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+	textureDesc.Layout = D3D12_TEXTURE_LAYOUT_64KB_UNDEFINED_SWIZZLE;
+
+	hr = d3d.device->CreateReservedResource(&textureDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&resources.texture));
+	Utils::Validate(hr, L"Error: failed to create reserved texture!");
+
+	// The page shape of the format and the mips packed together at the end of the chain
+	UINT tileCount = 0;
+	UINT subresourceCount = 0;
+	D3D12_PACKED_MIP_INFO packedMips = {};
+	D3D12_TILE_SHAPE tileShape = {};
+	d3d.device->GetResourceTiling(resources.texture, &tileCount, &packedMips, &tileShape, &subresourceCount, 0, nullptr);
+
+	const UINT budgetPages = max(static_cast<UINT>(config.virtualTextureBudget / PageSize), 1u);
+	VirtualTexture::Init(resources.pageTable, texture.width, texture.height, texture.mipLevels, tileShape.WidthInTexels, tileShape.HeightInTexels, packedMips.NumStandardMips, budgetPages);
+
+	// Create the heap for the page slots and the packed mips
+	D3D12_HEAP_DESC heapDesc = {};
+	heapDesc.SizeInBytes = static_cast<UINT64>(budgetPages + packedMips.NumTilesForPackedMips) * PageSize;
+	heapDesc.Properties = DefaultHeapProperties;
+	heapDesc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+	heapDesc.Flags = D3D12_HEAP_FLAG_DENY_BUFFERS | D3D12_HEAP_FLAG_DENY_RT_DS_TEXTURES;
+
+	hr = d3d.device->CreateHeap(&heapDesc, IID_PPV_ARGS(&resources.virtualTextureHeap));
+	Utils::Validate(hr, L"Error: failed to create virtual texture heap!");
+
+	D3D12BufferCreateInfo stagingInfo(static_cast<UINT64>(MaxPageUploads) * PageSize, D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_STATE_GENERIC_READ);
+	Create_Buffer(d3d, stagingInfo, &resources.virtualTextureUploadHeap[0]);
+	Create_Buffer(d3d, stagingInfo, &resources.virtualTextureUploadHeap[1]);
+
+	// Map and upload the packed mips, they stay resident as the fallback of every sample
+	if (packedMips.NumPackedMips > 0)
+	{
+		D3D12_TILED_RESOURCE_COORDINATE coordinate = {};
+		coordinate.Subresource = packedMips.NumStandardMips;
+
+		D3D12_TILE_REGION_SIZE region = {};
+		region.NumTiles = packedMips.NumTilesForPackedMips;
+
+		D3D12_TILE_RANGE_FLAGS flags = D3D12_TILE_RANGE_FLAG_NONE;
+		UINT heapOffset = budgetPages;
+		UINT rangeTiles = packedMips.NumTilesForPackedMips;
+		d3d.cmdQueue->UpdateTileMappings(resources.texture, 1, &coordinate, &region, resources.virtualTextureHeap, 1, &flags, &heapOffset, &rangeTiles, D3D12_TILE_MAPPING_FLAG_NONE);
+
+		vector<D3D12_SUBRESOURCE_DATA> textureData(packedMips.NumPackedMips);
+		for (UINT i = 0; i < textureData.size(); i++)
+		{
+			UINT mip = packedMips.NumStandardMips + i;
+			textureData[i].pData = texture.pixels.data() + TextureCompression::GetMipOffset(texture, mip);
+			textureData[i].RowPitch = TextureCompression::GetRowPitch(texture, mip);
+			textureData[i].SlicePitch = textureData[i].RowPitch * TextureCompression::GetRowCount(texture, mip);
+		}
+
+		UINT64 uploadSize = GetRequiredIntermediateSize(resources.texture, packedMips.NumStandardMips, packedMips.NumPackedMips);
+		D3D12BufferCreateInfo uploadInfo(uploadSize, D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_STATE_GENERIC_READ);
+		Create_Buffer(d3d, uploadInfo, &resources.textureUploadHeap);
+
+		UpdateSubresources(d3d.cmdList, resources.texture, resources.textureUploadHeap, 0, packedMips.NumStandardMips, packedMips.NumPackedMips, textureData.data());
+	}
+
+	D3D12_RESOURCE_BARRIER barrier = {};
+	barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+	barrier.Transition.pResource = resources.texture;
+	barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
+	barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+	barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+	barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+	d3d.cmdList->ResourceBarrier(1, &barrier);
+
+	// The page bits follow the lazy loading flag, and are cleared after every readback
+	Create_Texture_Feedback(d3d, resources, 1 + VirtualTexture::GetFeedbackWords(resources.pageTable));
+
+	const UINT64 feedbackSize = static_cast<UINT64>(resources.textureFeedbackWords) * sizeof(UINT32);
+	D3D12BufferCreateInfo clearInfo(feedbackSize, D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_STATE_GENERIC_READ);
+	Create_Buffer(d3d, clearInfo, &resources.textureFeedbackClear);
+
+	UINT8* zeros = nullptr;
+	hr = resources.textureFeedbackClear->Map(0, nullptr, reinterpret_cast<void**>(&zeros));
+	Utils::Validate(hr, L"Error: failed to map texture feedback clear buffer!");
+	memset(zeros, 0, feedbackSize);
+	resources.textureFeedbackClear->Unmap(0, nullptr);
+
+	resources.virtualTextureSource = texture;
+
+	Utils::Log("Virtual texture: %u pages of %ux%u texels, %u page slots, %u packed mips\n", tileCount - packedMips.NumTilesForPackedMips,
+		tileShape.WidthInTexels, tileShape.HeightInTexels, budgetPages, packedMips.NumPackedMips);
+	return true;
+}
+
+/**
+* Create a texture, block compressed when the configuration asks for it. With lazy textures a 1x1 grey placeholder is
+* uploaded instead, and the texture is loaded once the hit shader reports a ray hitting it. With a virtual texture budget
+* the texture is tiled and only the pages rays sample are resident. Otherwise the texture is loaded straight into its
+* upload heap, unless it is also written out as a DDS file.
+*/
+void Create_Texture(D3D12Global &d3d, D3D12Resources &resources, Material &material, const ConfigInfo &config) 
+{
+	TextureInfo texture;
+	if (config.virtualTextureBudget == 0 && !config.lazyTextures && !config.saveTextures)
+	{
+		texture = Textures::LoadMaterialTexture(material, config, [&](const TextureInfo &header, vector<TextureFootprint> &footprints)
+		{
+			return Create_Texture_Upload(d3d, resources, header, footprints);
+		});
+		material.textureResolution = static_cast<float>(texture.width);
+		material.textureMipLevels = texture.mipLevels;
+
+		Record_Texture_Upload(d3d, resources);
+		return;
+	}
+
+	if (config.lazyTextures && config.virtualTextureBudget == 0)
+	{
+		texture.width = 1;
+		texture.height = 1;
+		texture.pixels = { 128, 128, 128, 255 };
+		material.textureResident = false;
+		Create_Texture_Feedback(d3d, resources, 1);
+		resources.textureFeedbackPending = true;
+	}
+	else
+	{
+		texture = Load_Texture(material, config);
+	}
+
+	material.textureResolution = static_cast<float>(texture.width);
+	material.textureMipLevels = texture.mipLevels;
+
+	if (config.virtualTextureBudget > 0 && Create_Virtual_Texture(d3d, resources, texture, config)) return;
+	Upload_Texture(d3d, resources, texture);
+}
+
+/**
+* Create the buffer the hit shader writes texture feedback to, 32-bit words starting with a flag per material, and a readback
+* copy per frame in flight so the CPU never reads one a frame still running on the GPU copies into.
+*/
+void Create_Texture_Feedback(D3D12Global &d3d, D3D12Resources &resources, UINT words)
+{
+	const UINT64 size = static_cast<UINT64>(words) * sizeof(UINT32);
+
+	D3D12BufferCreateInfo info(size, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+	Create_Buffer(d3d, info, &resources.textureFeedback);
+
+	D3D12BufferCreateInfo readbackInfo(size, D3D12_HEAP_TYPE_READBACK, D3D12_RESOURCE_STATE_COPY_DEST);
+	Create_Buffer(d3d, readbackInfo, &resources.textureFeedbackReadback[0]);
+	Create_Buffer(d3d, readbackInfo, &resources.textureFeedbackReadback[1]);
+
+	resources.textureFeedbackWords = words;
+}
+
+/**
+* Map the pages a completed frame's sampling feedback asked for and unmap those evicted for them, then record copies of the
+* new pages' texels from system memory for the next frame. The frame submitted just before may still be running, so the
+* feedback and the staging buffer are those of the current frame index, whose last frame has finished. The tile mappings
+* are updated on the queue, after the work already submitted to it.
+*/
+static void Update_Virtual_Texture(D3D12Global &d3d, D3D12Resources &resources)
+{
+	HRESULT hr;
+
+	UINT32* feedback = nullptr;
+	D3D12_RANGE readRange = { 0, static_cast<SIZE_T>(resources.textureFeedbackWords) * sizeof(UINT32) };
+	hr = resources.textureFeedbackReadback[d3d.frameIndex]->Map(0, &readRange, reinterpret_cast<void**>(&feedback));
+	Utils::Validate(hr, L"Error: failed to map texture feedback readback buffer!");
+
+	vector<PageMapping> mappings;
+	VirtualTexture::Update(resources.pageTable, feedback + 1, MaxPageUploads, mappings);
+
+	D3D12_RANGE writeRange = { 0, 0 };
+	resources.textureFeedbackReadback[d3d.frameIndex]->Unmap(0, &writeRange);
+	if (mappings.empty()) return;
+
+	// Point each page at its slot in the heap, evicted pages at nothing
+	for (const PageMapping &mapping : mappings)
+	{
+		D3D12_TILED_RESOURCE_COORDINATE coordinate = {};
+		coordinate.X = mapping.x;
+		coordinate.Y = mapping.y;
+		coordinate.Subresource = mapping.mip;
+
+		D3D12_TILE_REGION_SIZE region = {};
+		region.NumTiles = 1;
+
+		UINT heapOffset = static_cast<UINT>(max(mapping.slot, 0));
+		UINT rangeTiles = 1;
+		D3D12_TILE_RANGE_FLAGS flags = (mapping.slot < 0) ? D3D12_TILE_RANGE_FLAG_NULL : D3D12_TILE_RANGE_FLAG_NONE;
+		d3d.cmdQueue->UpdateTileMappings(resources.texture, 1, &coordinate, &region, resources.virtualTextureHeap, 1, &flags, &heapOffset, &rangeTiles, D3D12_TILE_MAPPING_FLAG_NONE);
+	}
+
+	D3D12_RESOURCE_BARRIER barrier = {};
+	barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+	barrier.Transition.pResource = resources.texture;
+	barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+	barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_DEST;
+	barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+	barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+	d3d.cmdList->ResourceBarrier(1, &barrier);
+
+	UINT8* staging = nullptr;
+	ID3D12Resource* uploadHeap = resources.virtualTextureUploadHeap[d3d.frameIndex];
+	hr = uploadHeap->Map(0, nullptr, reinterpret_cast<void**>(&staging));
+	Utils::Validate(hr, L"Error: failed to map virtual texture upload heap!");
+
+	// Copy each new page, clipped to its mip, through its own 64KB of the staging buffer
+	const TextureInfo &source = resources.virtualTextureSource;
+	const PageTable &table = resources.pageTable;
+	const bool compressed = (source.format != DXGI_FORMAT_R8G8B8A8_UNORM);
+	const UINT blockSize = compressed ? 4 : 1;
+
+	UINT upload = 0;
+	for (const PageMapping &mapping : mappings)
+	{
+		if (mapping.slot < 0) continue;
+
+		const UINT mipWidth = ALIGN(blockSize, max(static_cast<UINT>(source.width) >> mapping.mip, 1u));
+		const UINT mipHeight = ALIGN(blockSize, max(static_cast<UINT>(source.height) >> mapping.mip, 1u));
+		const UINT x = mapping.x * table.tileWidth;
+		const UINT y = mapping.y * table.tileHeight;
+		const UINT width = min(table.tileWidth, mipWidth - x);
+		const UINT height = min(table.tileHeight, mipHeight - y);
+
+		const size_t sourcePitch = TextureCompression::GetRowPitch(source, mapping.mip);
+		const size_t rowBytes = static_cast<size_t>(width / blockSize) * source.stride;
+		const UINT8* sourceRows = source.pixels.data() + TextureCompression::GetMipOffset(source, mapping.mip)
+			+ (y / blockSize) * sourcePitch + (x / blockSize) * source.stride;
+
+		D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = {};
+		footprint.Offset = static_cast<UINT64>(upload) * PageSize;
+		footprint.Footprint.Format = source.format;
+		footprint.Footprint.Width = width;
+		footprint.Footprint.Height = height;
+		footprint.Footprint.Depth = 1;
+		footprint.Footprint.RowPitch = static_cast<UINT>(ALIGN(D3D12_TEXTURE_DATA_PITCH_ALIGNMENT, rowBytes));
+
+		for (UINT row = 0; row < height / blockSize; row++)
+		{
+			memcpy(staging + footprint.Offset + row * footprint.Footprint.RowPitch, sourceRows + row * sourcePitch, rowBytes);
+		}
+
+		D3D12_TEXTURE_COPY_LOCATION destination = {};
+		destination.pResource = resources.texture;
+		destination.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+		destination.SubresourceIndex = mapping.mip;
+
+		D3D12_TEXTURE_COPY_LOCATION sourceLocation = {};
+		sourceLocation.pResource = uploadHeap;
+		sourceLocation.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+		sourceLocation.PlacedFootprint = footprint;
+
+		d3d.cmdList->CopyTextureRegion(&destination, x, y, 0, &sourceLocation, nullptr);
+		upload++;
+	}
+
+	uploadHeap->Unmap(0, nullptr);
+
+	barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
+	barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+	d3d.cmdList->ResourceBarrier(1, &barrier);
+}
+
+/**
+* Drive lazy texture loading and virtual texture paging, called once the next frame's command list is reset. Feedback is read
+* from the readback buffer of the frame that last used this frame index, whose fence has passed; the frame submitted just
+* before may still be running. The first frame whose hit shader flagged the placeholder starts loading the texture on
+* another thread, and once the load finishes the texture is uploaded on the command list being recorded, its SRV replaces
+* the placeholder's, and the lighting constants switch the shader to it.
+*/
+void Update_Texture_Residency(D3D12Global &d3d, D3D12Resources &resources, Material &material, const ConfigInfo &config)
+{
+	if (resources.virtualTextureHeap)
+	{
+		Update_Virtual_Texture(d3d, resources);
+		return;
+	}
+	if (material.textureResident) return;
+
+	if (resources.textureFeedbackPending)
+	{
+		UINT32* flags = nullptr;
+		D3D12_RANGE readRange = { 0, sizeof(UINT32) };
+		HRESULT hr = resources.textureFeedbackReadback[d3d.frameIndex]->Map(0, &readRange, reinterpret_cast<void**>(&flags));
+		Utils::Validate(hr, L"Error: failed to map texture feedback readback buffer!");
+		const bool hit = (flags[0] != 0);
+
+		D3D12_RANGE writeRange = { 0, 0 };
+		resources.textureFeedbackReadback[d3d.frameIndex]->Unmap(0, &writeRange);
+
+		if (hit)
+		{
+			Utils::Log("Texture: first hit on %s, loading\n", material.name.c_str());
+			resources.textureFeedbackPending = false;
+			resources.textureLoad = async(launch::async, [&material, &config]() { return Load_Texture(material, config); });
+		}
+		return;
+	}
+
+	if (!resources.textureLoad.valid() || resources.textureLoad.wait_for(chrono::seconds(0)) != future_status::ready) return;
+	TextureInfo texture = resources.textureLoad.get();
+
+	// The frame submitted last may still read the placeholder, its SRV, and the lighting constants, so let it finish first
+	D3D12::WaitForGPU(d3d);
+	SAFE_RELEASE(resources.texture);
+	SAFE_RELEASE(resources.textureUploadHeap);
+	Upload_Texture(d3d, resources, texture);
+
+	// The texture SRV is the seventh entry of the heap, see DXR::Create_CBVSRVUAV_Heap
+	D3D12_SHADER_RESOURCE_VIEW_DESC textureSRVDesc = {};
+	textureSRVDesc.Format = texture.format;
+	textureSRVDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+	textureSRVDesc.Texture2D.MipLevels = texture.mipLevels;
+	textureSRVDesc.Texture2D.MostDetailedMip = 0;
+	textureSRVDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+
+	D3D12_CPU_DESCRIPTOR_HANDLE handle = resources.cbvSrvUavHeap->GetCPUDescriptorHandleForHeapStart();
+	handle.ptr += 6 * d3d.device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	d3d.device->CreateShaderResourceView(resources.texture, &textureSRVDesc, handle);
+
+	material.textureResolution = static_cast<float>(texture.width);
+	material.textureMipLevels = texture.mipLevels;
+	material.textureResident = true;
+
+	resources.lightingCBData.textureResolution = XMFLOAT4(material.textureResolution, static_cast<float>(material.textureMipLevels), 1.f, 0.f);
+	memcpy(resources.lightingCBStart, &resources.lightingCBData, sizeof(resources.lightingCBData));
+}
+
 /*
-* Create the vertex buffer.
+* Create the vertex buffers.
+* Positions and shading attributes live in separate streams so the AS build only reads 12 bytes per vertex.
 */
 void Create_Vertex_Buffer(D3D12Global &d3d, D3D12Resources &resources, Model &model) 
 {
-	// Create the buffer resource from the model's vertices
-	D3D12BufferCreateInfo info(((UINT)model.vertices.size() * sizeof(Vertex)), D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_STATE_GENERIC_READ);
+	// The hit shaders address the streams with 32-bit byte offsets, and the views hold 32-bit sizes
+	if (static_cast<UINT64>(model.positions.size()) * sizeof(XMFLOAT3) > UINT_MAX || static_cast<UINT64>(model.attributes.size()) * sizeof(VertexAttributes) > UINT_MAX)
+	{
+		throw runtime_error("Error: vertex buffers larger than 4 GB are not supported!");
+	}
+
+	// Create the position buffer resource from the model's positions
+	D3D12BufferCreateInfo info(static_cast<UINT64>(model.positions.size()) * sizeof(XMFLOAT3), D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_STATE_GENERIC_READ);
 	Create_Buffer(d3d, info, &resources.vertexBuffer);
 
 #if defined(_DEBUG)
 	resources.vertexBuffer->SetName(L"VertexBuffer");
 #endif
 
-	// Copy the vertex data to the vertex buffer
+	// Copy the position data to the vertex buffer
 	UINT8* pVertexDataBegin;
 	D3D12_RANGE readRange = {};
 	HRESULT hr = resources.vertexBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pVertexDataBegin));
 	Utils::Validate(hr, L"Error: failed to map vertex buffer!");
 
-	memcpy(pVertexDataBegin, model.vertices.data(), info.size);
+	memcpy(pVertexDataBegin, model.positions.data(), info.size);
 	resources.vertexBuffer->Unmap(0, nullptr);
 
 	// Initialize the vertex buffer view
 	resources.vertexBufferView.BufferLocation = resources.vertexBuffer->GetGPUVirtualAddress();
-	resources.vertexBufferView.StrideInBytes = sizeof(Vertex);
+	resources.vertexBufferView.StrideInBytes = sizeof(XMFLOAT3);
 	resources.vertexBufferView.SizeInBytes = static_cast<UINT>(info.size);
+
+	// Create the attribute buffer resource, read by the hit shaders only
+	info.size = static_cast<UINT64>(model.attributes.size()) * sizeof(VertexAttributes);
+	Create_Buffer(d3d, info, &resources.attributeBuffer);
+
+#if defined(_DEBUG)
+	resources.attributeBuffer->SetName(L"AttributeBuffer");
+#endif
+
+	// Copy the attribute data to the attribute buffer
+	UINT8* pAttributeDataBegin;
+	hr = resources.attributeBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pAttributeDataBegin));
+	Utils::Validate(hr, L"Error: failed to map attribute buffer!");
+
+	memcpy(pAttributeDataBegin, model.attributes.data(), info.size);
+	resources.attributeBuffer->Unmap(0, nullptr);
 }
 
 /**
 * Create the index buffer.
+* Each chunk's indices are stored relative to its base vertex at the chunk's width, starting on a 4 byte boundary so the shaders can load them as dwords.
 */
 void Create_Index_Buffer(D3D12Global &d3d, D3D12Resources &resources, Model &model) 
 {
+	// Lay out the chunks in the index buffer
+	UINT64 size = 0;
+	bool shortIndices = true;
+	for (MeshChunk &chunk : model.chunks)
+	{
+		chunk.indexByteOffset = size;
+		size += ALIGN(4, static_cast<UINT64>(chunk.indexCount) * chunk.indexStride);
+		shortIndices &= (chunk.indexStride == sizeof(uint16_t));
+	}
+
+	// The chunk offsets passed to the hit shaders are 32-bit byte offsets, as is the index buffer view's size
+	if (size > UINT_MAX)
+	{
+		throw runtime_error("Error: index buffers larger than 4 GB are not supported!");
+	}
+
 	// Create the index buffer resource
-	D3D12BufferCreateInfo info((UINT)model.indices.size() * sizeof(UINT), D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_STATE_GENERIC_READ);
+	D3D12BufferCreateInfo info(size, D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_STATE_GENERIC_READ);
 	Create_Buffer(d3d, info, &resources.indexBuffer);
 
 #if defined(_DEBUG)
 	resources.indexBuffer->SetName(L"IndexBuffer");
 #endif
 
-	// Copy the index data to the index buffer
+	// Write the index data of each chunk to the index buffer
 	UINT8* pIndexDataBegin;
 	D3D12_RANGE readRange = {};
 	HRESULT hr = resources.indexBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pIndexDataBegin));
 	Utils::Validate(hr, L"Error: failed to map index buffer!");
 
-	memcpy(pIndexDataBegin, model.indices.data(), info.size);
+	Utils::ParallelFor(model.chunks.size(), 1, [&](size_t first, size_t last)
+	{
+		for (size_t c = first; c < last; c++)
+		{
+			const MeshChunk &chunk = model.chunks[c];
+			const uint32_t* source = model.indices.data() + chunk.firstIndex;
+			UINT8* destination = pIndexDataBegin + chunk.indexByteOffset;
+
+			if (chunk.indexStride == sizeof(uint16_t))
+			{
+				uint16_t* shortDestination = reinterpret_cast<uint16_t*>(destination);
+				for (uint32_t i = 0; i < chunk.indexCount; i++) shortDestination[i] = static_cast<uint16_t>(source[i] - chunk.baseVertex);
+			}
+			else
+			{
+				uint32_t* wideDestination = reinterpret_cast<uint32_t*>(destination);
+				for (uint32_t i = 0; i < chunk.indexCount; i++) wideDestination[i] = source[i] - chunk.baseVertex;
+			}
+		}
+	});
 	resources.indexBuffer->Unmap(0, nullptr);
 
 	// Initialize the index buffer view
 	resources.indexBufferView.BufferLocation = resources.indexBuffer->GetGPUVirtualAddress();
 	resources.indexBufferView.SizeInBytes = static_cast<UINT>(info.size);
-	resources.indexBufferView.Format = DXGI_FORMAT_R32_UINT;
+	resources.indexBufferView.Format = shortIndices ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+}
+
+/**
+* Create the sphere buffers.
+* The shading data is read by the sphere hit shaders, and the unit sphere's bounding box is the procedural geometry of the sphere BLAS.
+*/
+void Create_Sphere_Buffer(D3D12Global &d3d, D3D12Resources &resources, Model &model)
+{
+	if (model.spheres.empty()) return;
+
+	// Create the sphere data buffer resource
+	D3D12BufferCreateInfo info(static_cast<UINT64>(model.spheres.size()) * sizeof(Sphere), D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_STATE_GENERIC_READ);
+	Create_Buffer(d3d, info, &resources.sphereBuffer);
+
+#if defined(_DEBUG)
+	resources.sphereBuffer->SetName(L"SphereBuffer");
+#endif
+
+	// Copy the sphere data to the sphere buffer
+	UINT8* pSphereDataBegin;
+	D3D12_RANGE readRange = {};
+	HRESULT hr = resources.sphereBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pSphereDataBegin));
+	Utils::Validate(hr, L"Error: failed to map sphere buffer!");
+
+	memcpy(pSphereDataBegin, model.spheres.data(), info.size);
+	resources.sphereBuffer->Unmap(0, nullptr);
+
+	// Create the bounding box buffer resource
+	info.size = sizeof(D3D12_RAYTRACING_AABB);
+	Create_Buffer(d3d, info, &resources.sphereAABBBuffer);
+
+#if defined(_DEBUG)
+	resources.sphereAABBBuffer->SetName(L"SphereAABBBuffer");
+#endif
+
+	// Every sphere is an instance of the unit sphere, so a single box bounds them all
+	D3D12_RAYTRACING_AABB* pAABB;
+	hr = resources.sphereAABBBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pAABB));
+	Utils::Validate(hr, L"Error: failed to map sphere AABB buffer!");
+
+	*pAABB = { -1.f, -1.f, -1.f, 1.f, 1.f, 1.f };
+	resources.sphereAABBBuffer->Unmap(0, nullptr);
 }
 
 /*
@@ -315,7 +834,13 @@ void Create_Lighting_CB(D3D12Global &d3d, D3D12Resources &resources, const Mater
 	Create_Constant_Buffer(d3d, &resources.lightingCB, sizeof(LightingCB));
 
 	resources.lightingCBData.lightingInformation = XMFLOAT4(-3.0f, 5.0f, -15.0f, 0.0f);
-	resources.lightingCBData.textureResolution = XMFLOAT4(material.textureResolution, 0.f, 0.f, 0.f);
+	resources.lightingCBData.textureResolution = XMFLOAT4(material.textureResolution, static_cast<float>(material.textureMipLevels), material.textureResident ? 1.f : 0.f, 0.f);
+	resources.lightingCBData.virtualTexture = XMFLOAT4(0.f, 0.f, 0.f, 0.f);
+	if (resources.virtualTextureHeap)
+	{
+		const PageTable &table = resources.pageTable;
+		resources.lightingCBData.virtualTexture = XMFLOAT4(static_cast<float>(table.tileWidth), static_cast<float>(table.tileHeight), static_cast<float>(table.packedMip), static_cast<float>(table.height));
+	}
 
 	HRESULT hr = resources.lightingCB->Map(0, nullptr, reinterpret_cast<void**>(&resources.lightingCBStart));
 	Utils::Validate(hr, L"Error: failed to map Lighting constant buffer!");
@@ -352,9 +877,9 @@ void Create_Descriptor_Heaps(D3D12Global &d3d, D3D12Resources &resources)
 }
 
 /**
-* Update the view constant buffer.
+* Update the view constant buffer. A scene file's first light and camera path replace the built-in ones.
 */
-void Update_View_CB(D3D12Global &d3d, D3D12Resources &resources, ConfigInfo &config)
+void Update_View_CB(D3D12Global &d3d, D3D12Resources &resources, ConfigInfo &config, const Model &model)
 {
 	const float rotationSpeed = 0.005f;
 	XMMATRIX view, invView;
@@ -411,6 +936,13 @@ void Update_View_CB(D3D12Global &d3d, D3D12Resources &resources, ConfigInfo &con
 #endif
 
 	eye = XMFLOAT3(x, y, z);
+	if (!model.lights.empty()) {
+		const SceneLight &light = model.lights.front();
+		lighting = XMFLOAT4(light.position.x + light.swing * cosf(-3 * resources.eyeAngle.x), light.position.y, light.position.z, 0.0f);
+	}
+	if (InputState::GetScriptedCam() && !model.cameraPath.empty()) {
+		Utils::SampleCameraPath(model.cameraPath, config.TotalTime, eye, focus);
+	}
 	if (!InputState::GetScriptedCam()) {
 		CameraInfo cam = InputState::GetCamera(config.ElapsedTime);
 		eye = cam.position;
@@ -447,7 +979,10 @@ void Destroy(D3D12Resources &resources)
 
 	SAFE_RELEASE(resources.DXROutput);
 	SAFE_RELEASE(resources.vertexBuffer);
+	SAFE_RELEASE(resources.attributeBuffer);
 	SAFE_RELEASE(resources.indexBuffer);
+	SAFE_RELEASE(resources.sphereBuffer);
+	SAFE_RELEASE(resources.sphereAABBBuffer);
 	SAFE_RELEASE(resources.rtvHeap);
 	SAFE_RELEASE(resources.cbvSrvUavHeap);
 	SAFE_RELEASE(resources.samplerHeap);
@@ -455,6 +990,13 @@ void Destroy(D3D12Resources &resources)
 	SAFE_RELEASE(resources.transformUploadHeap);
 	SAFE_RELEASE(resources.texture);
 	SAFE_RELEASE(resources.textureUploadHeap);
+	SAFE_RELEASE(resources.textureFeedback);
+	SAFE_RELEASE(resources.textureFeedbackReadback[0]);
+	SAFE_RELEASE(resources.textureFeedbackReadback[1]);
+	SAFE_RELEASE(resources.textureFeedbackClear);
+	SAFE_RELEASE(resources.virtualTextureHeap);
+	SAFE_RELEASE(resources.virtualTextureUploadHeap[0]);
+	SAFE_RELEASE(resources.virtualTextureUploadHeap[1]);
 }
 
 }
@@ -839,32 +1381,18 @@ namespace DXR
 {
 
 /**
-* Create the bottom level acceleration structure.
+* Build a bottom level acceleration structure from a list of geometry descriptions.
+* Returns the UAV barrier that waits for the build.
 */
-void Create_Bottom_Level_AS(D3D12Global &d3d, DXRGlobal &dxr, D3D12Resources &resources, Model &model) 
+static D3D12_RESOURCE_BARRIER Build_BLAS(D3D12Global &d3d, const vector<D3D12_RAYTRACING_GEOMETRY_DESC> &geometryDescs, AccelerationStructureBuffer &blas)
 {
-	// Describe the geometry that goes in the bottom acceleration structure(s)
-	D3D12_RAYTRACING_GEOMETRY_DESC geometryDesc;
-	geometryDesc.Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
-	geometryDesc.Triangles.VertexBuffer.StartAddress = resources.vertexBuffer->GetGPUVirtualAddress();
-	geometryDesc.Triangles.VertexBuffer.StrideInBytes = resources.vertexBufferView.StrideInBytes;
-	geometryDesc.Triangles.VertexCount = static_cast<UINT>(model.vertices.size());
-	geometryDesc.Triangles.VertexFormat = DXGI_FORMAT_R32G32B32_FLOAT;
-	geometryDesc.Triangles.IndexBuffer = resources.indexBuffer->GetGPUVirtualAddress();
-	geometryDesc.Triangles.IndexFormat = resources.indexBufferView.Format;
-	geometryDesc.Triangles.IndexCount = static_cast<UINT>(model.indices.size());
-	geometryDesc.Triangles.Transform3x4 = 0;
-	geometryDesc.Flags = D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE;
-	
-	D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS buildFlags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE;
-
 	// Get the size requirements for the BLAS buffers
 	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS ASInputs = {};
 	ASInputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL;
 	ASInputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;	
-	ASInputs.pGeometryDescs = &geometryDesc;
-	ASInputs.NumDescs = 1;
-	ASInputs.Flags = buildFlags;
+	ASInputs.pGeometryDescs = geometryDescs.data();
+	ASInputs.NumDescs = static_cast<UINT>(geometryDescs.size());
+	ASInputs.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE;
 
 	D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO ASPreBuildInfo = {};
 	d3d.device->GetRaytracingAccelerationStructurePrebuildInfo(&ASInputs, &ASPreBuildInfo);
@@ -875,25 +1403,171 @@ void Create_Bottom_Level_AS(D3D12Global &d3d, DXRGlobal &dxr, D3D12Resources &re
 	// Create the BLAS scratch buffer
 	D3D12BufferCreateInfo bufferInfo(ASPreBuildInfo.ScratchDataSizeInBytes, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 	bufferInfo.alignment = max(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
-	D3DResources::Create_Buffer(d3d, bufferInfo, &dxr.BLAS.pScratch);
+	D3DResources::Create_Buffer(d3d, bufferInfo, &blas.pScratch);
 
 	// Create the BLAS buffer
 	bufferInfo.size = ASPreBuildInfo.ResultDataMaxSizeInBytes;
 	bufferInfo.state = D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE;
-	D3DResources::Create_Buffer(d3d, bufferInfo, &dxr.BLAS.pResult);
+	D3DResources::Create_Buffer(d3d, bufferInfo, &blas.pResult);
 
 	// Describe and build the bottom level acceleration structure
 	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC buildDesc = {};
 	buildDesc.Inputs = ASInputs;	
-	buildDesc.ScratchAccelerationStructureData = dxr.BLAS.pScratch->GetGPUVirtualAddress();
-	buildDesc.DestAccelerationStructureData = dxr.BLAS.pResult->GetGPUVirtualAddress();
+	buildDesc.ScratchAccelerationStructureData = blas.pScratch->GetGPUVirtualAddress();
+	buildDesc.DestAccelerationStructureData = blas.pResult->GetGPUVirtualAddress();
 
 	d3d.cmdList->BuildRaytracingAccelerationStructure(&buildDesc, 0, nullptr);
 
-	// Wait for the BLAS build to complete
 	D3D12_RESOURCE_BARRIER uavBarrier;
 	uavBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
-	uavBarrier.UAV.pResource = dxr.BLAS.pResult;
+	uavBarrier.UAV.pResource = blas.pResult;
+	uavBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+	return uavBarrier;
+}
+
+/**
+* Create the bottom level acceleration structures, one per mesh, plus the unit sphere.
+*/
+void Create_Bottom_Level_AS(D3D12Global &d3d, DXRGlobal &dxr, D3D12Resources &resources, Model &model) 
+{
+	D3D12_GPU_VIRTUAL_ADDRESS vertexAddress = resources.vertexBuffer->GetGPUVirtualAddress();
+	D3D12_GPU_VIRTUAL_ADDRESS indexAddress = resources.indexBuffer->GetGPUVirtualAddress();
+
+	dxr.BLAS.resize(model.meshes.size());
+	vector<D3D12_RESOURCE_BARRIER> uavBarriers;
+	for (size_t m = 0; m < model.meshes.size(); m++)
+	{
+		const Mesh &mesh = model.meshes[m];
+
+		// Describe the geometry that goes in the bottom acceleration structure, one per mesh chunk
+		vector<D3D12_RAYTRACING_GEOMETRY_DESC> geometryDescs(mesh.chunkCount);
+		for (uint32_t i = 0; i < mesh.chunkCount; i++)
+		{
+			const MeshChunk &chunk = model.chunks[mesh.firstChunk + i];
+			D3D12_RAYTRACING_GEOMETRY_DESC &geometryDesc = geometryDescs[i];
+			geometryDesc.Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
+			geometryDesc.Triangles.VertexBuffer.StartAddress = vertexAddress + (static_cast<UINT64>(chunk.baseVertex) * resources.vertexBufferView.StrideInBytes);
+			geometryDesc.Triangles.VertexBuffer.StrideInBytes = resources.vertexBufferView.StrideInBytes;
+			geometryDesc.Triangles.VertexCount = chunk.vertexCount;
+			geometryDesc.Triangles.VertexFormat = DXGI_FORMAT_R32G32B32_FLOAT;
+			geometryDesc.Triangles.IndexBuffer = indexAddress + chunk.indexByteOffset;
+			geometryDesc.Triangles.IndexFormat = (chunk.indexStride == sizeof(uint16_t)) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+			geometryDesc.Triangles.IndexCount = chunk.indexCount;
+			geometryDesc.Triangles.Transform3x4 = 0;
+			geometryDesc.Flags = D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE;
+		}
+
+		uavBarriers.push_back(Build_BLAS(d3d, geometryDescs, dxr.BLAS[m]));
+	}
+
+	// The unit sphere is a single procedural AABB, shared by every sphere instance
+	if (!model.spheres.empty())
+	{
+		vector<D3D12_RAYTRACING_GEOMETRY_DESC> geometryDescs(1);
+		geometryDescs[0].Type = D3D12_RAYTRACING_GEOMETRY_TYPE_PROCEDURAL_PRIMITIVE_AABBS;
+		geometryDescs[0].AABBs.AABBCount = 1;
+		geometryDescs[0].AABBs.AABBs.StartAddress = resources.sphereAABBBuffer->GetGPUVirtualAddress();
+		geometryDescs[0].AABBs.AABBs.StrideInBytes = sizeof(D3D12_RAYTRACING_AABB);
+		geometryDescs[0].Flags = D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE;
+
+		uavBarriers.push_back(Build_BLAS(d3d, geometryDescs, dxr.sphereBLAS));
+	}
+
+	// Wait for the BLAS builds to complete
+	d3d.cmdList->ResourceBarrier(static_cast<UINT>(uavBarriers.size()), uavBarriers.data());
+}
+
+/**
+* Get the number of TLAS instances: one per mesh instance, plus one per sphere.
+*/
+static UINT Get_Instance_Count(const Model &model)
+{
+	return static_cast<UINT>(model.instances.size() + model.spheres.size());
+}
+
+/**
+* Write the TLAS instance descriptions for the frame's region of the instance buffer.
+*/
+static void Write_Instance_Descs(D3D12Global &d3d, DXRGlobal &dxr, const Model &model)
+{
+	D3D12_RAYTRACING_INSTANCE_DESC* instanceDescs;
+	dxr.TLAS.pInstanceDesc->Map(0, nullptr, (void**)&instanceDescs);
+	instanceDescs += Get_Instance_Count(model) * d3d.frameIndex;
+
+	for (size_t i = 0; i < model.instances.size(); i++)
+	{
+		const MeshInstance &instance = model.instances[i];
+		uint32_t meshIndex = Geometry::GetInstanceMesh(model, instance);
+		D3D12_RAYTRACING_INSTANCE_DESC &instanceDesc = instanceDescs[i];
+
+		instanceDesc.InstanceID = static_cast<UINT>(i);												// This value is exposed to shaders as SV_InstanceID
+		instanceDesc.InstanceContributionToHitGroupIndex = model.meshes[meshIndex].firstChunk;		// Hit group records are laid out per chunk
+		instanceDesc.InstanceMask = 1;
+		instanceDesc.Flags = D3D12_RAYTRACING_INSTANCE_FLAG_NONE;
+		instanceDesc.AccelerationStructure = dxr.BLAS[meshIndex].pResult->GetGPUVirtualAddress();
+
+		// DXR expects the upper 3x4 of a column vector matrix
+		XMFLOAT4X4 transform;
+		XMStoreFloat4x4(&transform, XMMatrixTranspose(XMLoadFloat4x4(&instance.transform)));
+		memcpy(instanceDesc.Transform, &transform, sizeof(instanceDesc.Transform));
+	}
+
+	// Each sphere places the unit sphere, its InstanceID locates the sphere's shading data
+	D3D12_GPU_VIRTUAL_ADDRESS sphereAddress = model.spheres.empty() ? 0 : dxr.sphereBLAS.pResult->GetGPUVirtualAddress();
+	for (size_t i = 0; i < model.spheres.size(); i++)
+	{
+		const Sphere &sphere = model.spheres[i];
+		D3D12_RAYTRACING_INSTANCE_DESC &instanceDesc = instanceDescs[model.instances.size() + i];
+
+		instanceDesc.InstanceID = static_cast<UINT>(i);
+		instanceDesc.InstanceContributionToHitGroupIndex = static_cast<UINT>(model.chunks.size());	// The sphere record follows the chunk records
+		instanceDesc.InstanceMask = 1;
+		instanceDesc.Flags = D3D12_RAYTRACING_INSTANCE_FLAG_NONE;
+		instanceDesc.AccelerationStructure = sphereAddress;
+
+		// Scale by the radius and move to the center, already the upper 3x4 of a column vector matrix
+		float transform[3][4] = {
+			{ sphere.radius, 0.f, 0.f, sphere.center.x },
+			{ 0.f, sphere.radius, 0.f, sphere.center.y },
+			{ 0.f, 0.f, sphere.radius, sphere.center.z },
+		};
+		memcpy(instanceDesc.Transform, transform, sizeof(instanceDesc.Transform));
+	}
+
+	dxr.TLAS.pInstanceDesc->Unmap(0, nullptr);
+}
+
+/**
+* Describe a TLAS build over the frame's region of the instance buffer.
+*/
+static D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS Get_TLAS_Inputs(D3D12Global &d3d, DXRGlobal &dxr, const Model &model)
+{
+	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS ASInputs = {};
+	ASInputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL;
+	ASInputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
+	ASInputs.InstanceDescs = dxr.TLAS.pInstanceDesc->GetGPUVirtualAddress() + Get_Instance_Count(model) * d3d.frameIndex * sizeof(D3D12_RAYTRACING_INSTANCE_DESC);
+	ASInputs.NumDescs = Get_Instance_Count(model);
+	ASInputs.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE;
+	return ASInputs;
+}
+
+/**
+* Record a build of the TLAS, followed by a barrier so later work sees the result.
+*/
+static void Build_TLAS(D3D12Global &d3d, DXRGlobal &dxr, const Model &model)
+{
+	// Describe and build the TLAS
+	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC buildDesc = {};
+	buildDesc.Inputs = Get_TLAS_Inputs(d3d, dxr, model);
+	buildDesc.ScratchAccelerationStructureData = dxr.TLAS.pScratch->GetGPUVirtualAddress();
+	buildDesc.DestAccelerationStructureData = dxr.TLAS.pResult->GetGPUVirtualAddress();
+
+	d3d.cmdList->BuildRaytracingAccelerationStructure(&buildDesc, 0, nullptr);
+
+	// Wait for the TLAS build to complete
+	D3D12_RESOURCE_BARRIER uavBarrier;
+	uavBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+	uavBarrier.UAV.pResource = dxr.TLAS.pResult;
 	uavBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
 	d3d.cmdList->ResourceBarrier(1, &uavBarrier);
 }
@@ -901,41 +1575,21 @@ void Create_Bottom_Level_AS(D3D12Global &d3d, DXRGlobal &dxr, D3D12Resources &re
 /**
 * Create the top level acceleration structure and its associated buffers.
 */
-void Create_Top_Level_AS(D3D12Global &d3d, DXRGlobal &dxr, D3D12Resources &resources) 
+void Create_Top_Level_AS(D3D12Global &d3d, DXRGlobal &dxr, D3D12Resources &resources, const Model &model) 
 {
-	// Describe the TLAS instance(s)
-	D3D12_RAYTRACING_INSTANCE_DESC instanceDesc = {};
-	instanceDesc.InstanceID = 0;																		// This value is exposed to shaders as SV_InstanceID
-	instanceDesc.InstanceContributionToHitGroupIndex = 0;
-	instanceDesc.InstanceMask = 1;
-	instanceDesc.Transform[0][0] = instanceDesc.Transform[1][1] = instanceDesc.Transform[2][2] = 1;		// identity transform
-	instanceDesc.Flags = D3D12_RAYTRACING_INSTANCE_FLAG_NONE;
-	instanceDesc.AccelerationStructure = dxr.BLAS.pResult->GetGPUVirtualAddress();
-
-	// Create the TLAS instance buffer
+	// Create the TLAS instance buffer, with a region per frame so instances can change while a frame is in flight
 	D3D12BufferCreateInfo instanceBufferInfo;
-	instanceBufferInfo.size = sizeof(instanceDesc);
+	instanceBufferInfo.size = Get_Instance_Count(model) * sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * _countof(d3d.backBuffer);
 	instanceBufferInfo.heapType = D3D12_HEAP_TYPE_UPLOAD;
 	instanceBufferInfo.flags = D3D12_RESOURCE_FLAG_NONE;
 	instanceBufferInfo.state = D3D12_RESOURCE_STATE_GENERIC_READ;
 	D3DResources::Create_Buffer(d3d, instanceBufferInfo, &dxr.TLAS.pInstanceDesc);
 
-	// Copy the instance data to the buffer
-	UINT8* pData;
-	dxr.TLAS.pInstanceDesc->Map(0, nullptr, (void**)&pData);
-	memcpy(pData, &instanceDesc, sizeof(instanceDesc));
-	dxr.TLAS.pInstanceDesc->Unmap(0, nullptr);
-
-	D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS buildFlags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE;
+	// Describe the TLAS instance(s)
+	Write_Instance_Descs(d3d, dxr, model);
 
 	// Get the size requirements for the TLAS buffers
-	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS ASInputs = {};
-	ASInputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL;
-	ASInputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
-	ASInputs.InstanceDescs = dxr.TLAS.pInstanceDesc->GetGPUVirtualAddress();
-	ASInputs.NumDescs = 1;
-	ASInputs.Flags = buildFlags;
-
+	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS ASInputs = Get_TLAS_Inputs(d3d, dxr, model);
 	D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO ASPreBuildInfo = {};
 	d3d.device->GetRaytracingAccelerationStructurePrebuildInfo(&ASInputs, &ASPreBuildInfo);
 
@@ -955,20 +1609,19 @@ void Create_Top_Level_AS(D3D12Global &d3d, DXRGlobal &dxr, D3D12Resources &resou
 	bufferInfo.state = D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE;
 	D3DResources::Create_Buffer(d3d, bufferInfo, &dxr.TLAS.pResult);
 
-	// Describe and build the TLAS
-	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC buildDesc = {};
-	buildDesc.Inputs = ASInputs;
-	buildDesc.ScratchAccelerationStructureData = dxr.TLAS.pScratch->GetGPUVirtualAddress();
-	buildDesc.DestAccelerationStructureData = dxr.TLAS.pResult->GetGPUVirtualAddress();
+	Build_TLAS(d3d, dxr, model);
+}
 
-	d3d.cmdList->BuildRaytracingAccelerationStructure(&buildDesc, 0, nullptr);
+/**
+* Select each instance's level of detail for the current view, rebuilding the TLAS when any level changed.
+*/
+void Update_Top_Level_AS(D3D12Global &d3d, DXRGlobal &dxr, D3D12Resources &resources, Model &model)
+{
+	const XMFLOAT4 &view = resources.viewCBData.viewOriginAndTanHalfFovY;
+	if (!Geometry::SelectMeshLods(model, XMFLOAT3(view.x, view.y, view.z), view.w, static_cast<float>(d3d.height))) return;
 
-	// Wait for the TLAS build to complete
-	D3D12_RESOURCE_BARRIER uavBarrier;
-	uavBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
-	uavBarrier.UAV.pResource = dxr.TLAS.pResult;
-	uavBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
-	d3d.cmdList->ResourceBarrier(1, &uavBarrier);
+	Write_Instance_Descs(d3d, dxr, model);
+	Build_TLAS(d3d, dxr, model);
 }
 
 /**
@@ -981,7 +1634,7 @@ void Create_RayGen_Program(D3D12Global &d3d, DXRGlobal &dxr, D3D12ShaderCompiler
 	D3DShaders::Compile_Shader(shaderCompiler, dxr.rgs);
 
 	// Describe the ray generation root signature
-	D3D12_DESCRIPTOR_RANGE ranges[3];
+	D3D12_DESCRIPTOR_RANGE ranges[4];
 
 	ranges[0].BaseShaderRegister = 0;
 	ranges[0].NumDescriptors = 2;
@@ -996,11 +1649,17 @@ void Create_RayGen_Program(D3D12Global &d3d, DXRGlobal &dxr, D3D12ShaderCompiler
 	ranges[1].OffsetInDescriptorsFromTableStart = 2;
 
 	ranges[2].BaseShaderRegister = 0;
-	ranges[2].NumDescriptors = 4;
+	ranges[2].NumDescriptors = 6;
 	ranges[2].RegisterSpace = 0;
 	ranges[2].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
 	ranges[2].OffsetInDescriptorsFromTableStart = 3;
 
+	ranges[3].BaseShaderRegister = 1;
+	ranges[3].NumDescriptors = 1;
+	ranges[3].RegisterSpace = 0;
+	ranges[3].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_UAV;
+	ranges[3].OffsetInDescriptorsFromTableStart = 9;
+
 	D3D12_ROOT_PARAMETER param0 = {};
 	param0.ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
 	param0.ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
@@ -1044,7 +1703,7 @@ void Create_Closest_Hit_Program(D3D12Global &d3d, DXRGlobal &dxr, D3D12ShaderCom
 	D3DShaders::Compile_Shader(shaderCompiler, dxr.hit.chs);
 
 	// Describe the root signature
-	D3D12_DESCRIPTOR_RANGE ranges[3];
+	D3D12_DESCRIPTOR_RANGE ranges[4];
 
 	ranges[0].BaseShaderRegister = 0;
 	ranges[0].NumDescriptors = 2;
@@ -1059,22 +1718,55 @@ void Create_Closest_Hit_Program(D3D12Global &d3d, DXRGlobal &dxr, D3D12ShaderCom
 	ranges[1].OffsetInDescriptorsFromTableStart = 2;
 
 	ranges[2].BaseShaderRegister = 0;
-	ranges[2].NumDescriptors = 4;
+	ranges[2].NumDescriptors = 6;
 	ranges[2].RegisterSpace = 0;
 	ranges[2].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
 	ranges[2].OffsetInDescriptorsFromTableStart = 3;
 
+	ranges[3].BaseShaderRegister = 1;
+	ranges[3].NumDescriptors = 1;
+	ranges[3].RegisterSpace = 0;
+	ranges[3].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_UAV;
+	ranges[3].OffsetInDescriptorsFromTableStart = 9;
+
 	D3D12_ROOT_PARAMETER param0 = {};
 	param0.ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
 	param0.ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
 	param0.DescriptorTable.NumDescriptorRanges = _countof(ranges);
 	param0.DescriptorTable.pDescriptorRanges = ranges;
 
-	D3D12_ROOT_PARAMETER rootParams[1] = { param0 };
+	// Per geometry constants: index byte offset, index stride, base vertex, and padding
+	D3D12_ROOT_PARAMETER param1 = {};
+	param1.ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+	param1.ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+	param1.Constants.ShaderRegister = 2;
+	param1.Constants.RegisterSpace = 0;
+	param1.Constants.Num32BitValues = 4;
+
+	D3D12_ROOT_PARAMETER rootParams[2] = { param0, param1 };
+
+	// Trilinear filtering of the albedo texture at the ray cone's LOD. Coordinates are clamped, atlas entries are padded
+	// for the filter's footprint
+	D3D12_STATIC_SAMPLER_DESC sampler = {};
+	sampler.Filter = D3D12_FILTER_MIN_MAG_MIP_LINEAR;
+	sampler.AddressU = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
+	sampler.AddressV = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
+	sampler.AddressW = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
+	sampler.MipLODBias = 0.f;
+	sampler.MaxAnisotropy = 1;
+	sampler.ComparisonFunc = D3D12_COMPARISON_FUNC_ALWAYS;
+	sampler.BorderColor = D3D12_STATIC_BORDER_COLOR_OPAQUE_BLACK;
+	sampler.MinLOD = 0.f;
+	sampler.MaxLOD = D3D12_FLOAT32_MAX;
+	sampler.ShaderRegister = 0;
+	sampler.RegisterSpace = 0;
+	sampler.ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
 
 	D3D12_ROOT_SIGNATURE_DESC rootDesc = {};
 	rootDesc.NumParameters = _countof(rootParams);
 	rootDesc.pParameters = rootParams;
+	rootDesc.NumStaticSamplers = 1;
+	rootDesc.pStaticSamplers = &sampler;
 	rootDesc.Flags = D3D12_ROOT_SIGNATURE_FLAG_LOCAL_ROOT_SIGNATURE;
 
 	// Create the root signature
@@ -1086,18 +1778,19 @@ void Create_Closest_Hit_Program(D3D12Global &d3d, DXRGlobal &dxr, D3D12ShaderCom
 */
 void Create_Pipeline_State_Object(D3D12Global &d3d, DXRGlobal &dxr)
 {
-	// Need 10 subobjects:
+	// Need 13 subobjects:
 	// 1 for RGS program
 	// 1 for Miss program
-	// 1 for CHS program
-	// 1 for Hit Group
+	// 1 for CHS program (triangle closest hit, sphere intersection, and sphere closest hit)
+	// 2 for Hit Groups (triangles and spheres)
 	// 2 for RayGen Root Signature (root-signature and association)
+	// 2 for Hit Group Root Signature (root-signature and association)
 	// 2 for Shader Config (config and association)
 	// 1 for Global Root Signature
 	// 1 for Pipeline Config	
 	UINT index = 0;
 	vector<D3D12_STATE_SUBOBJECT> subobjects;
-	subobjects.resize(10);
+	subobjects.resize(13);
 	
 	// Add state subobject for the RGS
 	D3D12_EXPORT_DESC rgsExportDesc = {};
@@ -1135,17 +1828,21 @@ void Create_Pipeline_State_Object(D3D12Global &d3d, DXRGlobal &dxr)
 
 	subobjects[index++] = ms;
 
-	// Add state subobject for the Closest Hit shader
-	D3D12_EXPORT_DESC chsExportDesc = {};
-	chsExportDesc.Name = L"ClosestHit_76";
-	chsExportDesc.ExportToRename = L"ClosestHit";
-	chsExportDesc.Flags = D3D12_EXPORT_FLAG_NONE;
+	// Add state subobject for the Closest Hit shaders
+	D3D12_EXPORT_DESC chsExportDescs[3] = {};
+	chsExportDescs[0].Name = L"ClosestHit_76";
+	chsExportDescs[0].ExportToRename = L"ClosestHit";
+	chsExportDescs[0].Flags = D3D12_EXPORT_FLAG_NONE;
+	chsExportDescs[1].Name = L"SphereIntersection";
+	chsExportDescs[1].Flags = D3D12_EXPORT_FLAG_NONE;
+	chsExportDescs[2].Name = L"SphereClosestHit";
+	chsExportDescs[2].Flags = D3D12_EXPORT_FLAG_NONE;
 
 	D3D12_DXIL_LIBRARY_DESC	chsLibDesc = {};
 	chsLibDesc.DXILLibrary.BytecodeLength = dxr.hit.chs.blob->GetBufferSize();
 	chsLibDesc.DXILLibrary.pShaderBytecode = dxr.hit.chs.blob->GetBufferPointer();
-	chsLibDesc.NumExports = 1;
-	chsLibDesc.pExports = &chsExportDesc;
+	chsLibDesc.NumExports = _countof(chsExportDescs);
+	chsLibDesc.pExports = chsExportDescs;
 
 	D3D12_STATE_SUBOBJECT chs = {};
 	chs.Type = D3D12_STATE_SUBOBJECT_TYPE_DXIL_LIBRARY;
@@ -1164,9 +1861,22 @@ void Create_Pipeline_State_Object(D3D12Global &d3d, DXRGlobal &dxr)
 
 	subobjects[index++] = hitGroup;
 
+	// Add a state subobject for the sphere hit group, which finds hits with an intersection shader
+	D3D12_HIT_GROUP_DESC sphereHitGroupDesc = {};
+	sphereHitGroupDesc.Type = D3D12_HIT_GROUP_TYPE_PROCEDURAL_PRIMITIVE;
+	sphereHitGroupDesc.IntersectionShaderImport = L"SphereIntersection";
+	sphereHitGroupDesc.ClosestHitShaderImport = L"SphereClosestHit";
+	sphereHitGroupDesc.HitGroupExport = L"SphereHitGroup";
+
+	D3D12_STATE_SUBOBJECT sphereHitGroup = {};
+	sphereHitGroup.Type = D3D12_STATE_SUBOBJECT_TYPE_HIT_GROUP;
+	sphereHitGroup.pDesc = &sphereHitGroupDesc;
+
+	subobjects[index++] = sphereHitGroup;
+
 	// Add a state subobject for the shader payload configuration
 	D3D12_RAYTRACING_SHADER_CONFIG shaderDesc = {};
-	shaderDesc.MaxPayloadSizeInBytes = sizeof(XMFLOAT4);	// only need float4 for color
+	shaderDesc.MaxPayloadSizeInBytes = sizeof(XMFLOAT4) + sizeof(XMFLOAT2);	// color and hit T, then the ray cone
 	shaderDesc.MaxAttributeSizeInBytes = D3D12_RAYTRACING_MAX_ATTRIBUTE_SIZE_IN_BYTES;
 
 	D3D12_STATE_SUBOBJECT shaderConfigObject = {};
@@ -1176,7 +1886,7 @@ void Create_Pipeline_State_Object(D3D12Global &d3d, DXRGlobal &dxr)
 	subobjects[index++] = shaderConfigObject;
 
 	// Create a list of the shader export names that use the payload
-	const WCHAR* shaderExports[] = { L"RayGen_12", L"Miss_5", L"HitGroup" };
+	const WCHAR* shaderExports[] = { L"RayGen_12", L"Miss_5", L"HitGroup", L"SphereHitGroup" };
 
 	// Add a state subobject for the association between shaders and the payload
 	D3D12_SUBOBJECT_TO_EXPORTS_ASSOCIATION shaderPayloadAssociation = {};
@@ -1198,7 +1908,7 @@ void Create_Pipeline_State_Object(D3D12Global &d3d, DXRGlobal &dxr)
 	subobjects[index++] = rayGenRootSigObject;
 
 	// Create a list of the shader export names that use the root signature
-	const WCHAR* rootSigExports[] = { L"RayGen_12", L"HitGroup", L"Miss_5" };
+	const WCHAR* rootSigExports[] = { L"RayGen_12", L"Miss_5" };
 
 	// Add a state subobject for the association between the RayGen shader and the RayGen root signature
 	D3D12_SUBOBJECT_TO_EXPORTS_ASSOCIATION rayGenShaderRootSigAssociation = {};
@@ -1212,6 +1922,27 @@ void Create_Pipeline_State_Object(D3D12Global &d3d, DXRGlobal &dxr)
 
 	subobjects[index++] = rayGenShaderRootSigAssociationObject;
 
+	// Add a state subobject for the hit group root signature, which adds the per geometry constants
+	D3D12_STATE_SUBOBJECT hitGroupRootSigObject = {};
+	hitGroupRootSigObject.Type = D3D12_STATE_SUBOBJECT_TYPE_LOCAL_ROOT_SIGNATURE;
+	hitGroupRootSigObject.pDesc = &dxr.hit.chs.pRootSignature;
+
+	subobjects[index++] = hitGroupRootSigObject;
+
+	// Add a state subobject for the association between the hit group and its root signature
+	const WCHAR* hitGroupRootSigExports[] = { L"HitGroup", L"SphereHitGroup" };
+
+	D3D12_SUBOBJECT_TO_EXPORTS_ASSOCIATION hitGroupRootSigAssociation = {};
+	hitGroupRootSigAssociation.NumExports = _countof(hitGroupRootSigExports);
+	hitGroupRootSigAssociation.pExports = hitGroupRootSigExports;
+	hitGroupRootSigAssociation.pSubobjectToAssociate = &subobjects[(index - 1)];
+
+	D3D12_STATE_SUBOBJECT hitGroupRootSigAssociationObject = {};
+	hitGroupRootSigAssociationObject.Type = D3D12_STATE_SUBOBJECT_TYPE_SUBOBJECT_TO_EXPORTS_ASSOCIATION;
+	hitGroupRootSigAssociationObject.pDesc = &hitGroupRootSigAssociation;
+
+	subobjects[index++] = hitGroupRootSigAssociationObject;
+
 	D3D12_STATE_SUBOBJECT globalRootSig;
 	globalRootSig.Type = D3D12_STATE_SUBOBJECT_TYPE_GLOBAL_ROOT_SIGNATURE;
 	globalRootSig.pDesc = &dxr.miss.pRootSignature;
@@ -1246,15 +1977,16 @@ void Create_Pipeline_State_Object(D3D12Global &d3d, DXRGlobal &dxr)
 /**
 * Create the DXR shader table.
 */
-void Create_Shader_Table(D3D12Global &d3d, DXRGlobal &dxr, D3D12Resources &resources) 
+void Create_Shader_Table(D3D12Global &d3d, DXRGlobal &dxr, D3D12Resources &resources, const Model &model) 
 {
 	/*
 	The Shader Table layout is as follows:
 	Entry 0 - Ray Generation program
 	Entry 1 - Miss program
-	Entry 2 - Closest Hit program
+	Entry 2+ - Closest Hit program, one entry per mesh chunk (BLAS geometry)
+	Last entry - Sphere hit group, when the model has spheres
 	All entries in the SBT must have the same size, so we will choose it base on the largest required entry.
-	The ray-gen program requires the largest entry - sizeof(program identifier) + 4 bytes for a descriptor-table + 8 bytes for a constant buffer descriptor.
+	The hit group requires the largest entry - sizeof(program identifier) + 8 bytes for a descriptor-table + 16 bytes of geometry constants.
 	The entry size must be aligned up to D3D12_RAYTRACING_SHADER_BINDING_TABLE_RECORD_BYTE_ALIGNMENT
 	*/
 
@@ -1263,9 +1995,12 @@ void Create_Shader_Table(D3D12Global &d3d, DXRGlobal &dxr, D3D12Resources &resou
 
 	dxr.sbtEntrySize = progIdSize;
 	dxr.sbtEntrySize += 8;					// CBV/SRV/UAV descriptor table
+	dxr.sbtEntrySize += 16;					// Geometry constants
 	dxr.sbtEntrySize = ALIGN(D3D12_RAYTRACING_SHADER_RECORD_BYTE_ALIGNMENT, dxr.sbtEntrySize);
 
-	sbtSize = (dxr.sbtEntrySize * 3);
+	dxr.hitGroupCount = static_cast<uint32_t>(model.chunks.size() + (model.spheres.empty() ? 0 : 1));
+
+	sbtSize = (dxr.sbtEntrySize * (2 + dxr.hitGroupCount));
 	sbtSize = ALIGN(D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT, sbtSize);
 
 	// Create the shader table buffers
@@ -1287,12 +2022,31 @@ void Create_Shader_Table(D3D12Global &d3d, DXRGlobal &dxr, D3D12Resources &resou
 	pData += dxr.sbtEntrySize;
 	memcpy(pData, dxr.rtpsoInfo->GetShaderIdentifier(L"Miss_5"), progIdSize);
 
-	// Entry 2 - Closest Hit program and local root argument data (descriptor table, constant buffer, and IB/VB pointers)
-	pData += dxr.sbtEntrySize;
-	memcpy(pData, dxr.rtpsoInfo->GetShaderIdentifier(L"HitGroup"), progIdSize);
+	// Entry 2+ - Closest Hit program and local root argument data (descriptor table and geometry constants)
+	for (const MeshChunk &chunk : model.chunks)
+	{
+		pData += dxr.sbtEntrySize;
+		memcpy(pData, dxr.rtpsoInfo->GetShaderIdentifier(L"HitGroup"), progIdSize);
+
+		// Set the root arg data. Point to start of descriptor heap
+		*reinterpret_cast<D3D12_GPU_DESCRIPTOR_HANDLE*>(pData + progIdSize) = resources.cbvSrvUavHeap->GetGPUDescriptorHandleForHeapStart();
+
+		// Tell the shaders where the chunk's indices are and how wide they are
+		uint32_t* constants = reinterpret_cast<uint32_t*>(pData + progIdSize + 8);
+		constants[0] = static_cast<uint32_t>(chunk.indexByteOffset);
+		constants[1] = chunk.indexStride;
+		constants[2] = chunk.baseVertex;
+		constants[3] = 0;
+	}
 
-	// Set the root arg data. Point to start of descriptor heap
-	*reinterpret_cast<D3D12_GPU_DESCRIPTOR_HANDLE*>(pData + progIdSize) = resources.cbvSrvUavHeap->GetGPUDescriptorHandleForHeapStart();
+	// Last entry - Sphere hit group, the spheres are found by InstanceID so the geometry constants are unused
+	if (!model.spheres.empty())
+	{
+		pData += dxr.sbtEntrySize;
+		memcpy(pData, dxr.rtpsoInfo->GetShaderIdentifier(L"SphereHitGroup"), progIdSize);
+		*reinterpret_cast<D3D12_GPU_DESCRIPTOR_HANDLE*>(pData + progIdSize) = resources.cbvSrvUavHeap->GetGPUDescriptorHandleForHeapStart();
+		memset(pData + progIdSize + 8, 0, 16);
+	}
 
 	// Unmap
 	dxr.sbt->Unmap(0, nullptr);
@@ -1304,16 +2058,19 @@ void Create_Shader_Table(D3D12Global &d3d, DXRGlobal &dxr, D3D12Resources &resou
 void Create_CBVSRVUAV_Heap(D3D12Global &d3d, DXRGlobal &dxr, D3D12Resources &resources, const Model &model)
 {
 	// Describe the CBV/SRV/UAV heap
-	// Need 7 entries:
+	// Need 10 entries:
 	// 1 CBV for the ViewCB
 	// 1 CBV for the MaterialCB
 	// 1 UAV for the RT output
 	// 1 SRV for the Scene BVH
 	// 1 SRV for the index buffer
-	// 1 SRV for the vertex buffer
+	// 1 SRV for the vertex attribute buffer
 	// 1 SRV for the texture
+	// 1 SRV for the sphere buffer
+	// 1 SRV for the vertex position buffer
+	// 1 UAV for the texture feedback flags
 	D3D12_DESCRIPTOR_HEAP_DESC desc = {};
-	desc.NumDescriptors = 7;
+	desc.NumDescriptors = 10;
 	desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
 	desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
 
@@ -1363,35 +2120,72 @@ void Create_CBVSRVUAV_Heap(D3D12Global &d3d, DXRGlobal &dxr, D3D12Resources &res
 	indexSRVDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_RAW;
 	indexSRVDesc.Buffer.StructureByteStride = 0;
 	indexSRVDesc.Buffer.FirstElement = 0;
-	indexSRVDesc.Buffer.NumElements = (static_cast<UINT>(model.indices.size()) * sizeof(UINT)) / sizeof(float);
+	indexSRVDesc.Buffer.NumElements = static_cast<UINT>(resources.indexBufferView.SizeInBytes / sizeof(float));
 	indexSRVDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
 
 	handle.ptr += handleIncrement;
 	d3d.device->CreateShaderResourceView(resources.indexBuffer, &indexSRVDesc, handle);
 
-	// Create the vertex buffer SRV
+	// Create the vertex attribute buffer SRV
 	D3D12_SHADER_RESOURCE_VIEW_DESC vertexSRVDesc;
 	vertexSRVDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
 	vertexSRVDesc.Format = DXGI_FORMAT_R32_TYPELESS;
 	vertexSRVDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_RAW;
 	vertexSRVDesc.Buffer.StructureByteStride = 0;
 	vertexSRVDesc.Buffer.FirstElement = 0;
-	vertexSRVDesc.Buffer.NumElements = (static_cast<UINT>(model.vertices.size()) * sizeof(Vertex)) / sizeof(float);
+	vertexSRVDesc.Buffer.NumElements = static_cast<UINT>((static_cast<UINT64>(model.attributes.size()) * sizeof(VertexAttributes)) / sizeof(float));
 	vertexSRVDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
 
 	handle.ptr += handleIncrement;
-	d3d.device->CreateShaderResourceView(resources.vertexBuffer, &vertexSRVDesc, handle);
+	d3d.device->CreateShaderResourceView(resources.attributeBuffer, &vertexSRVDesc, handle);
 
 	// Create the material texture SRV
 	D3D12_SHADER_RESOURCE_VIEW_DESC textureSRVDesc = {};
-	textureSRVDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	textureSRVDesc.Format = resources.texture ? resources.texture->GetDesc().Format : DXGI_FORMAT_R8G8B8A8_UNORM;
 	textureSRVDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	textureSRVDesc.Texture2D.MipLevels = 1;
+	textureSRVDesc.Texture2D.MipLevels = resources.texture ? resources.texture->GetDesc().MipLevels : 1;
 	textureSRVDesc.Texture2D.MostDetailedMip = 0;
 	textureSRVDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
 
 	handle.ptr += handleIncrement;
 	d3d.device->CreateShaderResourceView(resources.texture, &textureSRVDesc, handle);
+
+	// Create the sphere buffer SRV, a null descriptor when the model has no spheres
+	D3D12_SHADER_RESOURCE_VIEW_DESC sphereSRVDesc;
+	sphereSRVDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
+	sphereSRVDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+	sphereSRVDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_RAW;
+	sphereSRVDesc.Buffer.StructureByteStride = 0;
+	sphereSRVDesc.Buffer.FirstElement = 0;
+	sphereSRVDesc.Buffer.NumElements = static_cast<UINT>((static_cast<UINT64>(model.spheres.size()) * sizeof(Sphere)) / sizeof(float));
+	sphereSRVDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+
+	handle.ptr += handleIncrement;
+	d3d.device->CreateShaderResourceView(resources.sphereBuffer, &sphereSRVDesc, handle);
+
+	// Create the vertex position buffer SRV, read by the hit shader for the triangle's world space area
+	D3D12_SHADER_RESOURCE_VIEW_DESC positionSRVDesc;
+	positionSRVDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
+	positionSRVDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+	positionSRVDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_RAW;
+	positionSRVDesc.Buffer.StructureByteStride = 0;
+	positionSRVDesc.Buffer.FirstElement = 0;
+	positionSRVDesc.Buffer.NumElements = static_cast<UINT>((static_cast<UINT64>(model.positions.size()) * sizeof(XMFLOAT3)) / sizeof(float));
+	positionSRVDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+
+	handle.ptr += handleIncrement;
+	d3d.device->CreateShaderResourceView(resources.vertexBuffer, &positionSRVDesc, handle);
+
+	// Create the texture feedback UAV, a null descriptor unless textures are loaded lazily or paged
+	D3D12_UNORDERED_ACCESS_VIEW_DESC feedbackUAVDesc = {};
+	feedbackUAVDesc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
+	feedbackUAVDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+	feedbackUAVDesc.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_RAW;
+	feedbackUAVDesc.Buffer.FirstElement = 0;
+	feedbackUAVDesc.Buffer.NumElements = max(resources.textureFeedbackWords, 1u);
+
+	handle.ptr += handleIncrement;
+	d3d.device->CreateUnorderedAccessView(resources.textureFeedback, nullptr, &feedbackUAVDesc, handle);
 }
 
 /**
@@ -1457,7 +2251,7 @@ void Build_Command_List(D3D12Global &d3d, DXRGlobal &dxr, D3D12Resources &resour
 	desc.MissShaderTable.StrideInBytes = dxr.sbtEntrySize;
 
 	desc.HitGroupTable.StartAddress = dxr.sbt->GetGPUVirtualAddress() + (dxr.sbtEntrySize * 2);
-	desc.HitGroupTable.SizeInBytes = dxr.sbtEntrySize;			// Only a single Hit program entry
+	desc.HitGroupTable.SizeInBytes = dxr.sbtEntrySize * dxr.hitGroupCount;		// One Hit program entry per BLAS geometry
 	desc.HitGroupTable.StrideInBytes = dxr.sbtEntrySize;
 
 	desc.Width = d3d.width;
@@ -1467,6 +2261,36 @@ void Build_Command_List(D3D12Global &d3d, DXRGlobal &dxr, D3D12Resources &resour
 	d3d.cmdList->SetPipelineState1(dxr.rtpso);
 	d3d.cmdList->DispatchRays(&desc);
 
+	// Read back the placeholder texture hit flags and the virtual texture page requests, checked once the frame completes
+	if (resources.textureFeedbackPending || resources.virtualTextureHeap)
+	{
+		const UINT64 feedbackSize = static_cast<UINT64>(resources.textureFeedbackWords) * sizeof(UINT32);
+
+		D3D12_RESOURCE_BARRIER feedbackBarrier = {};
+		feedbackBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+		feedbackBarrier.Transition.pResource = resources.textureFeedback;
+		feedbackBarrier.Transition.StateBefore = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+		feedbackBarrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_SOURCE;
+		feedbackBarrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+		d3d.cmdList->ResourceBarrier(1, &feedbackBarrier);
+
+		d3d.cmdList->CopyBufferRegion(resources.textureFeedbackReadback[d3d.frameIndex], 0, resources.textureFeedback, 0, feedbackSize);
+
+		// Page requests are per frame, start the next one from zero
+		if (resources.textureFeedbackClear)
+		{
+			feedbackBarrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_SOURCE;
+			feedbackBarrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_DEST;
+			d3d.cmdList->ResourceBarrier(1, &feedbackBarrier);
+
+			d3d.cmdList->CopyBufferRegion(resources.textureFeedback, 0, resources.textureFeedbackClear, 0, feedbackSize);
+		}
+
+		feedbackBarrier.Transition.StateBefore = feedbackBarrier.Transition.StateAfter;
+		feedbackBarrier.Transition.StateAfter = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+		d3d.cmdList->ResourceBarrier(1, &feedbackBarrier);
+	}
+
 	// Transition DXR output to a copy source
 	OutputBarriers[1].Transition.StateBefore = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
 	OutputBarriers[1].Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_SOURCE;
@@ -1497,9 +2321,13 @@ void Destroy(DXRGlobal &dxr)
 	SAFE_RELEASE(dxr.TLAS.pScratch);
 	SAFE_RELEASE(dxr.TLAS.pResult);
 	SAFE_RELEASE(dxr.TLAS.pInstanceDesc);
-	SAFE_RELEASE(dxr.BLAS.pScratch);
-	SAFE_RELEASE(dxr.BLAS.pResult);
-	SAFE_RELEASE(dxr.BLAS.pInstanceDesc);
+	for (AccelerationStructureBuffer &blas : dxr.BLAS)
+	{
+		SAFE_RELEASE(blas.pScratch);
+		SAFE_RELEASE(blas.pResult);
+	}
+	SAFE_RELEASE(dxr.sphereBLAS.pScratch);
+	SAFE_RELEASE(dxr.sphereBLAS.pResult);
 	SAFE_RELEASE(dxr.sbt);
 	SAFE_RELEASE(dxr.rgs.blob);
 	SAFE_RELEASE(dxr.miss.blob);
@@ -0,0 +1,443 @@
+/* Copyright (c) 2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Primitives.h"
+#include "Utils.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace Primitives
+{
+
+//--------------------------------------------------------------------------------------
+// Unit Primitives
+//--------------------------------------------------------------------------------------
+
+/**
+ * A unit primitive in object space, generated once per shape and tessellation and copied into the model for every primitive that uses it.
+ */
+struct PrimitiveTemplate
+{
+	vector<XMFLOAT3>	positions;
+	vector<XMFLOAT3>	normals;
+	vector<uint32_t>	indices;
+};
+
+/**
+ * Clamp a tessellation to the range the shape can be built with.
+ */
+static uint32_t GetTessellation(PrimitiveShape shape, uint32_t tessellation)
+{
+	switch (shape)
+	{
+	case PrimitiveShape::Sphere:
+	case PrimitiveShape::Cylinder:
+		return max(tessellation, 3u);
+	case PrimitiveShape::Capsule:
+		return max((tessellation + 1) & ~1u, 2u);		// even, so both ends get the same rings
+	case PrimitiveShape::Icosphere:
+		return min(tessellation, 7u);
+	case PrimitiveShape::Plane:
+		return max(tessellation, 1u);
+	default:
+		return 0;
+	}
+}
+
+/**
+ * Get the exact number of vertices and indices of a primitive without generating it.
+ * Spheres and capsules have twice as many longitude segments as latitude segments, and close each end with a single pole vertex.
+ */
+PrimitiveSize GetPrimitiveSize(PrimitiveShape shape, uint32_t tessellation)
+{
+	uint32_t t = GetTessellation(shape, tessellation);
+	switch (shape)
+	{
+	case PrimitiveShape::Sphere:
+		return { 2 + (t - 1) * (2 * t), 6 * (2 * t) * (t - 1) };
+	case PrimitiveShape::Icosphere:
+		return { 10 * (1u << (2 * t)) + 2, 60 * (1u << (2 * t)) };
+	case PrimitiveShape::Box:
+		return { 24, 36 };
+	case PrimitiveShape::Plane:
+		return { (t + 1) * (t + 1), 6 * t * t };
+	case PrimitiveShape::Cylinder:
+		return { 4 * t + 2, 12 * t };
+	case PrimitiveShape::Capsule:
+		return { 2 + t * (2 * t), 6 * (2 * t) * t };
+	}
+	return { 0, 0 };
+}
+
+/**
+ * Build a surface of revolution around Y from rings of latitude, closed by a pole vertex at each end.
+ * The longitude trig table is computed once and shared by every ring, and each ring computes its latitude trig once.
+ */
+static void BuildLathe(PrimitiveTemplate &primitive, uint32_t longitudeSegments, const vector<float> &latitudes, const vector<float> &offsets, float radius)
+{
+	vector<float> sines(longitudeSegments);
+	vector<float> cosines(longitudeSegments);
+	for (uint32_t j = 0; j < longitudeSegments; j++)
+	{
+		XMScalarSinCos(&sines[j], &cosines[j], j * XM_2PI / longitudeSegments);
+	}
+
+	uint32_t ringCount = static_cast<uint32_t>(latitudes.size());
+	primitive.positions.reserve(2 + ringCount * longitudeSegments);
+	primitive.normals.reserve(2 + ringCount * longitudeSegments);
+	primitive.indices.reserve(6 * longitudeSegments * ringCount);
+
+	primitive.positions.push_back(XMFLOAT3(0.f, offsets.front() - radius, 0.f));
+	primitive.normals.push_back(XMFLOAT3(0.f, -1.f, 0.f));
+	for (uint32_t i = 0; i < ringCount; i++)
+	{
+		float dy, dxz;
+		XMScalarSinCos(&dy, &dxz, latitudes[i]);
+		for (uint32_t j = 0; j < longitudeSegments; j++)
+		{
+			XMFLOAT3 normal(sines[j] * dxz, dy, cosines[j] * dxz);
+			primitive.positions.push_back(XMFLOAT3(normal.x * radius, normal.y * radius + offsets[i], normal.z * radius));
+			primitive.normals.push_back(normal);
+		}
+	}
+	primitive.positions.push_back(XMFLOAT3(0.f, offsets.back() + radius, 0.f));
+	primitive.normals.push_back(XMFLOAT3(0.f, 1.f, 0.f));
+
+	// Fan from the bottom pole, quads between the rings, and a fan to the top pole
+	uint32_t topPole = 1 + ringCount * longitudeSegments;
+	for (uint32_t j = 0; j < longitudeSegments; j++)
+	{
+		uint32_t nextJ = (j + 1) % longitudeSegments;
+		primitive.indices.insert(primitive.indices.end(), { 0, 1 + j, 1 + nextJ });
+	}
+	for (uint32_t i = 0; i + 1 < ringCount; i++)
+	{
+		uint32_t ring = 1 + i * longitudeSegments;
+		uint32_t nextRing = ring + longitudeSegments;
+		for (uint32_t j = 0; j < longitudeSegments; j++)
+		{
+			uint32_t nextJ = (j + 1) % longitudeSegments;
+			primitive.indices.insert(primitive.indices.end(), { ring + j, nextRing + j, ring + nextJ });
+			primitive.indices.insert(primitive.indices.end(), { ring + nextJ, nextRing + j, nextRing + nextJ });
+		}
+	}
+	uint32_t lastRing = topPole - longitudeSegments;
+	for (uint32_t j = 0; j < longitudeSegments; j++)
+	{
+		uint32_t nextJ = (j + 1) % longitudeSegments;
+		primitive.indices.insert(primitive.indices.end(), { lastRing + j, topPole, lastRing + nextJ });
+	}
+}
+
+static void BuildSphere(PrimitiveTemplate &primitive, uint32_t latitudeSegments)
+{
+	vector<float> latitudes, offsets;
+	for (uint32_t i = 1; i < latitudeSegments; i++)
+	{
+		latitudes.push_back((i * XM_PI / latitudeSegments) - XM_PIDIV2);
+		offsets.push_back(0.f);
+	}
+	BuildLathe(primitive, 2 * latitudeSegments, latitudes, offsets, 1.f);
+}
+
+static void BuildCapsule(PrimitiveTemplate &primitive, uint32_t latitudeSegments)
+{
+	// The equator ring is repeated, once for each end, and the band between the copies is the cylinder
+	vector<float> latitudes, offsets;
+	for (uint32_t i = 1; i <= latitudeSegments / 2; i++)
+	{
+		latitudes.push_back((i * XM_PI / latitudeSegments) - XM_PIDIV2);
+		offsets.push_back(-0.5f);
+	}
+	for (uint32_t i = latitudeSegments / 2; i < latitudeSegments; i++)
+	{
+		latitudes.push_back((i * XM_PI / latitudeSegments) - XM_PIDIV2);
+		offsets.push_back(0.5f);
+	}
+	BuildLathe(primitive, 2 * latitudeSegments, latitudes, offsets, 0.5f);
+}
+
+static void BuildIcosphere(PrimitiveTemplate &primitive, uint32_t subdivisions)
+{
+	const float x = 0.525731112f;
+	const float z = 0.850650808f;
+	primitive.positions = {
+		{ -x, 0, z }, { x, 0, z }, { -x, 0, -z }, { x, 0, -z },
+		{ 0, z, x }, { 0, z, -x }, { 0, -z, x }, { 0, -z, -x },
+		{ z, x, 0 }, { -z, x, 0 }, { z, -x, 0 }, { -z, -x, 0 }
+	};
+	primitive.indices = {
+		0, 4, 1,  0, 9, 4,  9, 5, 4,  4, 5, 8,  4, 8, 1,
+		8, 10, 1,  8, 3, 10,  5, 3, 8,  5, 2, 3,  2, 7, 3,
+		7, 10, 3,  7, 6, 10,  7, 11, 6,  11, 0, 6,  0, 1, 6,
+		6, 1, 10,  9, 0, 11,  9, 11, 2,  9, 2, 5,  7, 2, 11
+	};
+
+	// Split every triangle into four, sharing the midpoint of each edge between its two triangles
+	for (uint32_t level = 0; level < subdivisions; level++)
+	{
+		map<uint64_t, uint32_t> midpoints;
+		auto getMidpoint = [&](uint32_t a, uint32_t b)
+		{
+			uint64_t key = (static_cast<uint64_t>(min(a, b)) << 32) | max(a, b);
+			auto found = midpoints.find(key);
+			if (found != midpoints.end()) return found->second;
+
+			XMVECTOR midpoint = XMVector3Normalize(XMVectorAdd(XMLoadFloat3(&primitive.positions[a]), XMLoadFloat3(&primitive.positions[b])));
+			XMFLOAT3 position;
+			XMStoreFloat3(&position, midpoint);
+			primitive.positions.push_back(position);
+
+			uint32_t index = static_cast<uint32_t>(primitive.positions.size() - 1);
+			midpoints[key] = index;
+			return index;
+		};
+
+		vector<uint32_t> indices;
+		indices.reserve(primitive.indices.size() * 4);
+		for (size_t i = 0; i < primitive.indices.size(); i += 3)
+		{
+			uint32_t a = primitive.indices[i + 0];
+			uint32_t b = primitive.indices[i + 1];
+			uint32_t c = primitive.indices[i + 2];
+			uint32_t ab = getMidpoint(a, b);
+			uint32_t bc = getMidpoint(b, c);
+			uint32_t ca = getMidpoint(c, a);
+			indices.insert(indices.end(), { a, ab, ca,  ab, b, bc,  ca, bc, c,  ab, bc, ca });
+		}
+		primitive.indices.swap(indices);
+	}
+
+	primitive.normals = primitive.positions;
+}
+
+static void BuildBox(PrimitiveTemplate &primitive)
+{
+	const XMFLOAT3 faceNormals[6] = { { 0, 0, 1 }, { 0, 0, -1 }, { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 } };
+	for (const XMFLOAT3 &n : faceNormals)
+	{
+		// Two edges of the face, perpendicular to its normal and to each other
+		XMFLOAT3 s1(n.y, n.z, n.x);
+		XMFLOAT3 s2(n.y * s1.z - n.z * s1.y, n.z * s1.x - n.x * s1.z, n.x * s1.y - n.y * s1.x);
+
+		uint32_t first = static_cast<uint32_t>(primitive.positions.size());
+		primitive.positions.push_back(XMFLOAT3(n.x - s1.x - s2.x, n.y - s1.y - s2.y, n.z - s1.z - s2.z));
+		primitive.positions.push_back(XMFLOAT3(n.x - s1.x + s2.x, n.y - s1.y + s2.y, n.z - s1.z + s2.z));
+		primitive.positions.push_back(XMFLOAT3(n.x + s1.x + s2.x, n.y + s1.y + s2.y, n.z + s1.z + s2.z));
+		primitive.positions.push_back(XMFLOAT3(n.x + s1.x - s2.x, n.y + s1.y - s2.y, n.z + s1.z - s2.z));
+		primitive.normals.insert(primitive.normals.end(), 4, n);
+		primitive.indices.insert(primitive.indices.end(), { first, first + 1, first + 2, first, first + 2, first + 3 });
+	}
+}
+
+static void BuildPlane(PrimitiveTemplate &primitive, uint32_t segments)
+{
+	for (uint32_t i = 0; i <= segments; i++)
+	{
+		float z = -1.f + (2.f * i) / segments;
+		for (uint32_t j = 0; j <= segments; j++)
+		{
+			primitive.positions.push_back(XMFLOAT3(-1.f + (2.f * j) / segments, 0.f, z));
+		}
+	}
+	primitive.normals.assign(primitive.positions.size(), XMFLOAT3(0.f, 1.f, 0.f));
+
+	uint32_t stride = segments + 1;
+	for (uint32_t i = 0; i < segments; i++)
+	{
+		for (uint32_t j = 0; j < segments; j++)
+		{
+			uint32_t corner = i * stride + j;
+			primitive.indices.insert(primitive.indices.end(), { corner, corner + stride, corner + 1 });
+			primitive.indices.insert(primitive.indices.end(), { corner + 1, corner + stride, corner + stride + 1 });
+		}
+	}
+}
+
+static void BuildCylinder(PrimitiveTemplate &primitive, uint32_t segments)
+{
+	vector<float> sines(segments);
+	vector<float> cosines(segments);
+	for (uint32_t j = 0; j < segments; j++)
+	{
+		XMScalarSinCos(&sines[j], &cosines[j], j * XM_2PI / segments);
+	}
+
+	// The side, a bottom and top ring with radial normals
+	for (float y : { -1.f, 1.f })
+	{
+		for (uint32_t j = 0; j < segments; j++)
+		{
+			primitive.positions.push_back(XMFLOAT3(sines[j], y, cosines[j]));
+			primitive.normals.push_back(XMFLOAT3(sines[j], 0.f, cosines[j]));
+		}
+	}
+	for (uint32_t j = 0; j < segments; j++)
+	{
+		uint32_t nextJ = (j + 1) % segments;
+		primitive.indices.insert(primitive.indices.end(), { j, segments + j, nextJ });
+		primitive.indices.insert(primitive.indices.end(), { nextJ, segments + j, segments + nextJ });
+	}
+
+	// The caps, a fan around a center vertex with axial normals
+	for (float y : { -1.f, 1.f })
+	{
+		uint32_t center = static_cast<uint32_t>(primitive.positions.size());
+		primitive.positions.push_back(XMFLOAT3(0.f, y, 0.f));
+		primitive.normals.push_back(XMFLOAT3(0.f, y, 0.f));
+		for (uint32_t j = 0; j < segments; j++)
+		{
+			primitive.positions.push_back(XMFLOAT3(sines[j], y, cosines[j]));
+			primitive.normals.push_back(XMFLOAT3(0.f, y, 0.f));
+		}
+		for (uint32_t j = 0; j < segments; j++)
+		{
+			uint32_t nextJ = (j + 1) % segments;
+			primitive.indices.insert(primitive.indices.end(), { center, center + 1 + j, center + 1 + nextJ });
+		}
+	}
+}
+
+/**
+ * Get the unit primitive for a shape and tessellation, generating it on first use.
+ * Templates are never freed, so the returned reference stays valid.
+ */
+static const PrimitiveTemplate& GetTemplate(PrimitiveShape shape, uint32_t tessellation)
+{
+	static mutex cacheMutex;
+	static map<pair<PrimitiveShape, uint32_t>, unique_ptr<PrimitiveTemplate>> cache;
+
+	tessellation = GetTessellation(shape, tessellation);
+
+	lock_guard<mutex> lock(cacheMutex);
+	unique_ptr<PrimitiveTemplate> &entry = cache[make_pair(shape, tessellation)];
+	if (!entry)
+	{
+		entry.reset(new PrimitiveTemplate());
+		switch (shape)
+		{
+		case PrimitiveShape::Sphere: BuildSphere(*entry, tessellation); break;
+		case PrimitiveShape::Icosphere: BuildIcosphere(*entry, tessellation); break;
+		case PrimitiveShape::Box: BuildBox(*entry); break;
+		case PrimitiveShape::Plane: BuildPlane(*entry, tessellation); break;
+		case PrimitiveShape::Cylinder: BuildCylinder(*entry, tessellation); break;
+		case PrimitiveShape::Capsule: BuildCapsule(*entry, tessellation); break;
+		}
+	}
+	return *entry;
+}
+
+//--------------------------------------------------------------------------------------
+// Primitive Writing
+//--------------------------------------------------------------------------------------
+
+static void WriteTemplate(const PrimitiveTemplate &unit, const Primitive &primitive, uint32_t baseVertex, XMFLOAT3* positions, VertexAttributes* attributes, uint32_t* indices)
+{
+	XMMATRIX transform = XMLoadFloat4x4(&primitive.transform);
+	XMMATRIX normalTransform = XMMatrixTranspose(XMMatrixInverse(nullptr, transform));
+
+	for (size_t v = 0; v < unit.positions.size(); v++)
+	{
+		XMStoreFloat3(&positions[v], XMVector3Transform(XMLoadFloat3(&unit.positions[v]), transform));
+		XMStoreFloat3(&attributes[v].normal, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&unit.normals[v]), normalTransform)));
+		attributes[v].color = primitive.color;
+		attributes[v].material = primitive.material;
+	}
+
+	for (size_t i = 0; i < unit.indices.size(); i++)
+	{
+		indices[i] = unit.indices[i] + baseVertex;
+	}
+}
+
+void WritePrimitive(const Primitive &primitive, uint32_t baseVertex, XMFLOAT3* positions, VertexAttributes* attributes, uint32_t* indices)
+{
+	WriteTemplate(GetTemplate(primitive.shape, primitive.tessellation), primitive, baseVertex, positions, attributes, indices);
+}
+
+void AddPrimitives(Model &model, const vector<Primitive> &primitives)
+{
+	// Lay out the primitives after the model's existing geometry
+	vector<size_t> firstVertices(primitives.size());
+	vector<size_t> firstIndices(primitives.size());
+	size_t vertexCount = model.positions.size();
+	size_t indexCount = model.indices.size();
+	for (size_t p = 0; p < primitives.size(); p++)
+	{
+		PrimitiveSize size = GetPrimitiveSize(primitives[p].shape, primitives[p].tessellation);
+		firstVertices[p] = vertexCount;
+		firstIndices[p] = indexCount;
+		vertexCount += size.vertexCount;
+		indexCount += size.indexCount;
+	}
+
+	if (vertexCount > UINT32_MAX)
+	{
+		throw runtime_error("Error: too many primitive vertices for 32-bit indices!");
+	}
+
+	model.positions.resize(vertexCount);
+	model.attributes.resize(vertexCount);
+	model.indices.resize(indexCount);
+
+	Utils::ParallelFor(primitives.size(), 256, [&](size_t first, size_t last)
+	{
+		// Neighbouring primitives usually share a template, so only look it up when the shape changes
+		const PrimitiveTemplate* unit = nullptr;
+		for (size_t p = first; p < last; p++)
+		{
+			const Primitive &primitive = primitives[p];
+			if (!unit || primitive.shape != primitives[p - 1].shape || primitive.tessellation != primitives[p - 1].tessellation)
+			{
+				unit = &GetTemplate(primitive.shape, primitive.tessellation);
+			}
+
+			size_t v = firstVertices[p];
+			WriteTemplate(*unit, primitive, static_cast<uint32_t>(v), &model.positions[v], &model.attributes[v], &model.indices[firstIndices[p]]);
+		}
+	});
+}
+
+void AddPrimitive(Model &model, const Primitive &primitive)
+{
+	AddPrimitives(model, { primitive });
+}
+
+XMFLOAT4X4 GetTransform(XMFLOAT3 position, XMFLOAT3 scale, XMFLOAT3 rotation)
+{
+	XMMATRIX transform = XMMatrixScaling(scale.x, scale.y, scale.z);
+	transform = XMMatrixMultiply(transform, XMMatrixRotationRollPitchYaw(rotation.x, rotation.y, rotation.z));
+	transform = XMMatrixMultiply(transform, XMMatrixTranslation(position.x, position.y, position.z));
+
+	XMFLOAT4X4 result;
+	XMStoreFloat4x4(&result, transform);
+	return result;
+}
+
+}
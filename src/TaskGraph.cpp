@@ -0,0 +1,166 @@
+/* Copyright (c) 2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "TaskGraph.h"
+#include "Utils.h"
+
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <chrono>
+
+size_t TaskGraph::Add(const char* name, const function<void()> &work, const vector<size_t> &dependencies, bool mainThread)
+{
+	for (size_t dependency : dependencies)
+	{
+		if (dependency >= m_Tasks.size())
+		{
+			throw runtime_error("Error: task dependencies must be added first!");
+		}
+		m_Tasks[dependency].dependents.push_back(m_Tasks.size());
+	}
+
+	Task task;
+	task.name = name;
+	task.work = work;
+	task.dependencies = dependencies;
+	task.mainThread = mainThread;
+	task.waiting = dependencies.size();
+	task.start = 0;
+	task.end = 0;
+	m_Tasks.push_back(task);
+	return m_Tasks.size() - 1;
+}
+
+void TaskGraph::Run()
+{
+	mutex lock;
+	condition_variable signal;
+	deque<size_t> ready;
+	size_t remaining = m_Tasks.size();
+	exception_ptr error;
+
+	for (size_t i = 0; i < m_Tasks.size(); i++)
+	{
+		if (m_Tasks[i].waiting == 0) ready.push_back(i);
+	}
+
+	auto t0 = chrono::high_resolution_clock::now();
+	auto elapsed = [&t0]() { return chrono::duration<double, milli>(chrono::high_resolution_clock::now() - t0).count(); };
+
+	auto worker = [&](bool mainThread)
+	{
+		unique_lock<mutex> guard(lock);
+		while (true)
+		{
+			// Find a task this thread may run
+			deque<size_t>::iterator next;
+			signal.wait(guard, [&]()
+			{
+				if (remaining == 0 || error) return true;
+				next = find_if(ready.begin(), ready.end(), [&](size_t i) { return mainThread || !m_Tasks[i].mainThread; });
+				return next != ready.end();
+			});
+			if (remaining == 0 || error) break;
+
+			size_t index = *next;
+			ready.erase(next);
+			Task &task = m_Tasks[index];
+
+			guard.unlock();
+			task.start = elapsed();
+			exception_ptr taskError;
+			try
+			{
+				task.work();
+			}
+			catch (...)
+			{
+				taskError = current_exception();
+			}
+			task.end = elapsed();
+			guard.lock();
+
+			if (taskError && !error) error = taskError;
+			for (size_t dependent : task.dependents)
+			{
+				if (--m_Tasks[dependent].waiting == 0) ready.push_back(dependent);
+			}
+			remaining--;
+			signal.notify_all();
+		}
+	};
+
+	// The calling thread runs tasks too, and is the only one to run main thread tasks
+	vector<thread> threads;
+	size_t workers = min(Utils::GetWorkerCount(), m_Tasks.size());
+	for (size_t w = 1; w < workers; w++) threads.emplace_back(worker, false);
+	worker(true);
+	for (auto &t : threads) t.join();
+
+	m_WallTime = elapsed();
+	if (error) rethrow_exception(error);
+}
+
+void TaskGraph::Report() const
+{
+	if (m_Tasks.empty()) return;
+
+	// Find the longest chain of task durations through the graph, tasks are already in dependency order
+	vector<double> pathTime(m_Tasks.size(), 0.0);
+	vector<size_t> previous(m_Tasks.size(), SIZE_MAX);
+	double taskTime = 0;
+	size_t last = 0;
+	for (size_t i = 0; i < m_Tasks.size(); i++)
+	{
+		for (size_t dependency : m_Tasks[i].dependencies)
+		{
+			if (pathTime[dependency] > pathTime[i])
+			{
+				pathTime[i] = pathTime[dependency];
+				previous[i] = dependency;
+			}
+		}
+
+		double duration = m_Tasks[i].end - m_Tasks[i].start;
+		pathTime[i] += duration;
+		taskTime += duration;
+		if (pathTime[i] > pathTime[last]) last = i;
+	}
+
+	vector<size_t> path;
+	for (size_t i = last; i != SIZE_MAX; i = previous[i]) path.push_back(i);
+	reverse(path.begin(), path.end());
+
+	Utils::Log("Startup: %.2f ms wall time, %.2f ms of work in %zu tasks\n", m_WallTime, taskTime, m_Tasks.size());
+	Utils::Log("Critical path: %.2f ms\n", pathTime[last]);
+	for (size_t i : path)
+	{
+		const Task &task = m_Tasks[i];
+		Utils::Log("  %-32s %8.2f ms (%.2f - %.2f ms)\n", task.name.c_str(), task.end - task.start, task.start, task.end);
+	}
+}
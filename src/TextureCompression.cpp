@@ -0,0 +1,677 @@
+/* Copyright (c) 2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "TextureCompression.h"
+#include "Utils.h"
+#include "HighResolutionClock.h"
+
+namespace TextureCompression
+{
+
+static bool IsBlockCompressed(DXGI_FORMAT format)
+{
+	return format == DXGI_FORMAT_BC1_UNORM || format == DXGI_FORMAT_BC7_UNORM;
+}
+
+static UINT GetMipSize(int size, UINT mip)
+{
+	return max(static_cast<UINT>(size) >> mip, 1u);
+}
+
+size_t GetRowPitch(const TextureInfo &texture, UINT mip)
+{
+	UINT width = GetMipSize(texture.width, mip);
+	if (IsBlockCompressed(texture.format)) return static_cast<size_t>((width + 3) / 4) * texture.stride;
+	return static_cast<size_t>(width) * texture.stride;
+}
+
+UINT GetRowCount(const TextureInfo &texture, UINT mip)
+{
+	UINT height = GetMipSize(texture.height, mip);
+	return IsBlockCompressed(texture.format) ? (height + 3) / 4 : height;
+}
+
+size_t GetMipOffset(const TextureInfo &texture, UINT mip)
+{
+	size_t offset = 0;
+	for (UINT m = 0; m < mip; m++) offset += GetRowPitch(texture, m) * GetRowCount(texture, m);
+	return offset;
+}
+
+//--------------------------------------------------------------------------------------
+// Blocks
+//--------------------------------------------------------------------------------------
+
+/**
+ * A 4x4 block of texels, one plane per channel so four texels are processed at a time.
+ */
+struct Block
+{
+	alignas(16) float channels[4][16];
+};
+
+/**
+ * Gather a block from an RGBA8 level, repeating the last row and column of levels smaller than a block.
+ */
+static void GatherBlock(const UINT8* pixels, UINT width, UINT height, UINT blockX, UINT blockY, Block &block)
+{
+	for (UINT y = 0; y < 4; y++)
+	{
+		const UINT8* row = pixels + static_cast<size_t>(min(blockY * 4 + y, height - 1)) * width * 4;
+		for (UINT x = 0; x < 4; x++)
+		{
+			const UINT8* texel = row + min(blockX * 4 + x, width - 1) * 4;
+			for (UINT c = 0; c < 4; c++) block.channels[c][y * 4 + x] = texel[c];
+		}
+	}
+}
+
+/**
+ * Find the mean of a block and the axis its texels spread along most, by power iteration on their covariance.
+ */
+static void GetBlockAxis(const Block &block, UINT channels, float mean[4], float axis[4])
+{
+	float covariance[4][4] = {};
+	for (UINT c = 0; c < 4; c++)
+	{
+		mean[c] = 0.f;
+		axis[c] = 0.f;
+		if (c >= channels) continue;
+		for (UINT i = 0; i < 16; i++) mean[c] += block.channels[c][i];
+		mean[c] /= 16.f;
+	}
+
+	for (UINT i = 0; i < 16; i++)
+	{
+		for (UINT a = 0; a < channels; a++)
+		{
+			for (UINT b = a; b < channels; b++)
+			{
+				covariance[a][b] += (block.channels[a][i] - mean[a]) * (block.channels[b][i] - mean[b]);
+			}
+		}
+	}
+
+	// Seed with the covariance row of the channel that varies most. A fixed seed such as (1, 1, 1) is orthogonal to the
+	// axis of anti-correlated blocks, a red to green edge for one, and the iteration would collapse to zero.
+	UINT widest = 0;
+	for (UINT c = 1; c < channels; c++)
+	{
+		if (covariance[c][c] > covariance[widest][widest]) widest = c;
+	}
+	for (UINT c = 0; c < channels; c++) axis[c] = (widest <= c) ? covariance[widest][c] : covariance[c][widest];
+	if (covariance[widest][widest] < 1e-6f)
+	{
+		for (UINT c = 0; c < channels; c++) axis[c] = 1.f;
+	}
+
+	for (UINT iteration = 0; iteration < 8; iteration++)
+	{
+		float next[4] = {};
+		float length = 0.f;
+		for (UINT a = 0; a < channels; a++)
+		{
+			for (UINT b = 0; b < channels; b++) next[a] += ((a <= b) ? covariance[a][b] : covariance[b][a]) * axis[b];
+			length = max(length, fabsf(next[a]));
+		}
+
+		// A flat block has no spread, any axis will do
+		if (length < 1e-6f) break;
+		for (UINT c = 0; c < channels; c++) axis[c] = next[c] / length;
+	}
+
+	float length = 0.f;
+	for (UINT c = 0; c < channels; c++) length += axis[c] * axis[c];
+	length = sqrtf(length);
+	for (UINT c = 0; c < channels; c++) axis[c] /= length;
+}
+
+/**
+ * Project the texels of a block onto a line.
+ */
+static void ProjectBlock(const Block &block, UINT channels, const float origin[4], const float direction[4], float projections[16])
+{
+	for (UINT i = 0; i < 16; i += 4)
+	{
+		__m128 t = _mm_setzero_ps();
+		for (UINT c = 0; c < channels; c++)
+		{
+			__m128 offset = _mm_sub_ps(_mm_load_ps(&block.channels[c][i]), _mm_set1_ps(origin[c]));
+			t = _mm_add_ps(t, _mm_mul_ps(offset, _mm_set1_ps(direction[c])));
+		}
+		_mm_storeu_ps(projections + i, t);
+	}
+}
+
+/**
+ * Pick, for each texel, the nearest of the evenly spaced levels between two endpoints.
+ * Texels off the line are equally far from every level, so the nearest level is the one nearest their projection.
+ */
+static void SelectIndices(const Block &block, UINT channels, const float endpoint0[4], const float endpoint1[4], UINT levels, UINT8 indices[16])
+{
+	float direction[4] = {};
+	float lengthSquared = 0.f;
+	for (UINT c = 0; c < channels; c++)
+	{
+		direction[c] = endpoint1[c] - endpoint0[c];
+		lengthSquared += direction[c] * direction[c];
+	}
+
+	if (lengthSquared < 1e-6f)
+	{
+		memset(indices, 0, 16);
+		return;
+	}
+
+	float scale = (levels - 1) / lengthSquared;
+	for (UINT c = 0; c < channels; c++) direction[c] *= scale;
+
+	alignas(16) float projections[16];
+	alignas(16) int32_t levelIndices[16];
+	ProjectBlock(block, channels, endpoint0, direction, projections);
+	for (UINT i = 0; i < 16; i += 4)
+	{
+		__m128 t = _mm_min_ps(_mm_max_ps(_mm_load_ps(projections + i), _mm_setzero_ps()), _mm_set1_ps(static_cast<float>(levels - 1)));
+		_mm_store_si128(reinterpret_cast<__m128i*>(levelIndices + i), _mm_cvtps_epi32(t));
+	}
+	for (UINT i = 0; i < 16; i++) indices[i] = static_cast<UINT8>(levelIndices[i]);
+}
+
+/**
+ * Packs fields into a block least significant bit first.
+ */
+struct BlockWriter
+{
+	uint64_t	bits[2];
+	UINT		position;
+
+	BlockWriter() : position(0) { bits[0] = bits[1] = 0; }
+
+	void Write(uint64_t value, UINT count)
+	{
+		if (position >= 64) bits[1] |= value << (position - 64);
+		else
+		{
+			bits[0] |= value << position;
+			if (position + count > 64) bits[1] |= value >> (64 - position);
+		}
+		position += count;
+	}
+};
+
+//--------------------------------------------------------------------------------------
+// BC1
+//--------------------------------------------------------------------------------------
+
+static uint16_t PackRGB565(const float color[4])
+{
+	UINT r = static_cast<UINT>(min(max(color[0] * 31.f / 255.f + 0.5f, 0.f), 31.f));
+	UINT g = static_cast<UINT>(min(max(color[1] * 63.f / 255.f + 0.5f, 0.f), 63.f));
+	UINT b = static_cast<UINT>(min(max(color[2] * 31.f / 255.f + 0.5f, 0.f), 31.f));
+	return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+static void UnpackRGB565(uint16_t packed, float color[4])
+{
+	UINT r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+	color[0] = static_cast<float>((r << 3) | (r >> 2));
+	color[1] = static_cast<float>((g << 2) | (g >> 4));
+	color[2] = static_cast<float>((b << 3) | (b >> 2));
+	color[3] = 255.f;
+}
+
+/**
+ * Encode an opaque block with endpoints at the ends of its principal axis, pulled in by a sixteenth of the range
+ * so outlying texels do not stretch the palette.
+ */
+static void EncodeBC1Block(const Block &block, UINT8* output)
+{
+	float mean[4], axis[4];
+	GetBlockAxis(block, 3, mean, axis);
+
+	float projections[16];
+	ProjectBlock(block, 3, mean, axis, projections);
+	float low = projections[0], high = projections[0];
+	for (UINT i = 1; i < 16; i++)
+	{
+		low = min(low, projections[i]);
+		high = max(high, projections[i]);
+	}
+	float inset = (high - low) / 16.f;
+	low += inset;
+	high -= inset;
+
+	float endpoints[2][4];
+	for (UINT c = 0; c < 3; c++)
+	{
+		endpoints[0][c] = mean[c] + axis[c] * high;
+		endpoints[1][c] = mean[c] + axis[c] * low;
+	}
+
+	uint16_t color0 = PackRGB565(endpoints[0]);
+	uint16_t color1 = PackRGB565(endpoints[1]);
+	uint32_t packedIndices = 0;
+
+	// The four color palette needs color0 above color1; equal endpoints leave every texel on color0
+	if (color0 != color1)
+	{
+		if (color0 < color1) swap(color0, color1);
+		UnpackRGB565(color0, endpoints[0]);
+		UnpackRGB565(color1, endpoints[1]);
+
+		// Palette order is color0, color1, then the points a third and two thirds of the way from color0
+		static const UINT8 paletteOrder[4] = { 0, 2, 3, 1 };
+		UINT8 indices[16];
+		SelectIndices(block, 3, endpoints[0], endpoints[1], 4, indices);
+		for (UINT i = 0; i < 16; i++) packedIndices |= static_cast<uint32_t>(paletteOrder[indices[i]]) << (2 * i);
+	}
+
+	memcpy(output, &color0, 2);
+	memcpy(output + 2, &color1, 2);
+	memcpy(output + 4, &packedIndices, 4);
+}
+
+//--------------------------------------------------------------------------------------
+// BC7
+//--------------------------------------------------------------------------------------
+
+static const UINT BC7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+/**
+ * Quantize an endpoint to the 7 bits per channel and shared low bit of mode 6, choosing the low bit that fits it best.
+ */
+static void QuantizeMode6Endpoint(const float endpoint[4], UINT quantized[4], UINT &pBit, float decoded[4])
+{
+	float bestError = FLT_MAX;
+	for (UINT p = 0; p < 2; p++)
+	{
+		UINT candidate[4];
+		float error = 0.f;
+		for (UINT c = 0; c < 4; c++)
+		{
+			candidate[c] = static_cast<UINT>(min(max((endpoint[c] - p) / 2.f + 0.5f, 0.f), 127.f));
+			float difference = static_cast<float>((candidate[c] << 1) | p) - endpoint[c];
+			error += difference * difference;
+		}
+
+		if (error < bestError)
+		{
+			bestError = error;
+			pBit = p;
+			for (UINT c = 0; c < 4; c++)
+			{
+				quantized[c] = candidate[c];
+				decoded[c] = static_cast<float>((candidate[c] << 1) | p);
+			}
+		}
+	}
+}
+
+static float GetMode6Error(const Block &block, const float decoded[2][4], const UINT8 indices[16])
+{
+	float error = 0.f;
+	for (UINT i = 0; i < 16; i++)
+	{
+		UINT weight = BC7Weights[indices[i]];
+		for (UINT c = 0; c < 4; c++)
+		{
+			UINT value = ((64 - weight) * static_cast<UINT>(decoded[0][c]) + weight * static_cast<UINT>(decoded[1][c]) + 32) >> 6;
+			float difference = static_cast<float>(value) - block.channels[c][i];
+			error += difference * difference;
+		}
+	}
+	return error;
+}
+
+/**
+ * Encode a block in BC7 mode 6: one subset, RGBA endpoints, and 4-bit indices. The endpoints start at the ends of the
+ * block's principal axis and are then refit by least squares to the indices they produced, keeping whichever fits better.
+ */
+static void EncodeBC7Block(const Block &block, UINT8* output)
+{
+	float mean[4], axis[4];
+	GetBlockAxis(block, 4, mean, axis);
+
+	float projections[16];
+	ProjectBlock(block, 4, mean, axis, projections);
+	float low = projections[0], high = projections[0];
+	for (UINT i = 1; i < 16; i++)
+	{
+		low = min(low, projections[i]);
+		high = max(high, projections[i]);
+	}
+
+	float endpoints[2][4];
+	for (UINT c = 0; c < 4; c++)
+	{
+		endpoints[0][c] = mean[c] + axis[c] * low;
+		endpoints[1][c] = mean[c] + axis[c] * high;
+	}
+
+	float bestError = FLT_MAX;
+	UINT bestQuantized[2][4], bestPBits[2];
+	UINT8 bestIndices[16];
+	for (UINT pass = 0; pass < 2; pass++)
+	{
+		UINT quantized[2][4], pBits[2];
+		float decoded[2][4];
+		UINT8 indices[16];
+		QuantizeMode6Endpoint(endpoints[0], quantized[0], pBits[0], decoded[0]);
+		QuantizeMode6Endpoint(endpoints[1], quantized[1], pBits[1], decoded[1]);
+		SelectIndices(block, 4, decoded[0], decoded[1], 16, indices);
+
+		float error = GetMode6Error(block, decoded, indices);
+		if (error < bestError)
+		{
+			bestError = error;
+			memcpy(bestQuantized, quantized, sizeof(quantized));
+			memcpy(bestPBits, pBits, sizeof(pBits));
+			memcpy(bestIndices, indices, sizeof(indices));
+		}
+		if (bestError == 0.f) break;
+
+		// Refit the endpoints to the chosen weights
+		float a = 0.f, b = 0.f, d = 0.f;
+		float right0[4] = {}, right1[4] = {};
+		for (UINT i = 0; i < 16; i++)
+		{
+			float w = BC7Weights[indices[i]] / 64.f;
+			a += (1.f - w) * (1.f - w);
+			b += (1.f - w) * w;
+			d += w * w;
+			for (UINT c = 0; c < 4; c++)
+			{
+				right0[c] += (1.f - w) * block.channels[c][i];
+				right1[c] += w * block.channels[c][i];
+			}
+		}
+
+		float determinant = a * d - b * b;
+		if (fabsf(determinant) < 1e-6f) break;
+		for (UINT c = 0; c < 4; c++)
+		{
+			endpoints[0][c] = min(max((d * right0[c] - b * right1[c]) / determinant, 0.f), 255.f);
+			endpoints[1][c] = min(max((a * right1[c] - b * right0[c]) / determinant, 0.f), 255.f);
+		}
+	}
+
+	// The first index is stored without its top bit, so it must be below 8
+	if (bestIndices[0] & 8)
+	{
+		swap(bestQuantized[0], bestQuantized[1]);
+		swap(bestPBits[0], bestPBits[1]);
+		for (UINT i = 0; i < 16; i++) bestIndices[i] = 15 - bestIndices[i];
+	}
+
+	BlockWriter writer;
+	writer.Write(1 << 6, 7);
+	for (UINT c = 0; c < 4; c++)
+	{
+		writer.Write(bestQuantized[0][c], 7);
+		writer.Write(bestQuantized[1][c], 7);
+	}
+	writer.Write(bestPBits[0], 1);
+	writer.Write(bestPBits[1], 1);
+	writer.Write(bestIndices[0], 3);
+	for (UINT i = 1; i < 16; i++) writer.Write(bestIndices[i], 4);
+
+	memcpy(output, writer.bits, 16);
+}
+
+//--------------------------------------------------------------------------------------
+// Compression
+//--------------------------------------------------------------------------------------
+
+void Compress(TextureInfo &texture, DXGI_FORMAT format)
+{
+	if (texture.format != DXGI_FORMAT_R8G8B8A8_UNORM || !IsBlockCompressed(format)) return;
+	if ((texture.width % 4) != 0 || (texture.height % 4) != 0)
+	{
+		Utils::Log("Texture: %dx%d is not a multiple of 4 texels on each side, left uncompressed\n", texture.width, texture.height);
+		return;
+	}
+
+	HighResolutionClock clock;
+
+	TextureInfo compressed;
+	compressed.width = texture.width;
+	compressed.height = texture.height;
+	compressed.mipLevels = texture.mipLevels;
+	compressed.format = format;
+	compressed.stride = (format == DXGI_FORMAT_BC1_UNORM) ? 8 : 16;
+	compressed.pixels.resize(GetMipOffset(compressed, compressed.mipLevels));
+
+	for (UINT mip = 0; mip < static_cast<UINT>(texture.mipLevels); mip++)
+	{
+		const UINT8* source = texture.pixels.data() + GetMipOffset(texture, mip);
+		const UINT width = GetMipSize(texture.width, mip);
+		const UINT height = GetMipSize(texture.height, mip);
+		const UINT blocksX = (width + 3) / 4;
+		UINT8* blocks = compressed.pixels.data() + GetMipOffset(compressed, mip);
+
+		Utils::ParallelFor(GetRowCount(compressed, mip), 1, [&](size_t first, size_t last)
+		{
+			Block block;
+			for (size_t y = first; y < last; y++)
+			{
+				UINT8* output = blocks + y * blocksX * compressed.stride;
+				for (UINT x = 0; x < blocksX; x++, output += compressed.stride)
+				{
+					GatherBlock(source, width, height, x, static_cast<UINT>(y), block);
+					if (format == DXGI_FORMAT_BC1_UNORM) EncodeBC1Block(block, output);
+					else EncodeBC7Block(block, output);
+				}
+			}
+		});
+	}
+
+	size_t sourceSize = texture.pixels.size();
+	texture = move(compressed);
+
+	clock.Tick();
+	Utils::Log("Texture: compressed %dx%d to %s, %.1f MB to %.1f MB in %.2f ms\n", texture.width, texture.height, (format == DXGI_FORMAT_BC1_UNORM) ? "BC1" : "BC7",
+		sourceSize / (1024.0 * 1024.0), texture.pixels.size() / (1024.0 * 1024.0), clock.GetDeltaMilliseconds());
+}
+
+//--------------------------------------------------------------------------------------
+// DDS Files
+//--------------------------------------------------------------------------------------
+
+struct DDSPixelFormat
+{
+	uint32_t	size;
+	uint32_t	flags;
+	uint32_t	fourCC;
+	uint32_t	rgbBitCount;
+	uint32_t	rBitMask;
+	uint32_t	gBitMask;
+	uint32_t	bBitMask;
+	uint32_t	aBitMask;
+};
+
+struct DDSHeader
+{
+	uint32_t		size;
+	uint32_t		flags;
+	uint32_t		height;
+	uint32_t		width;
+	uint32_t		pitchOrLinearSize;
+	uint32_t		depth;
+	uint32_t		mipMapCount;
+	uint32_t		reserved1[11];
+	DDSPixelFormat	pixelFormat;
+	uint32_t		caps;
+	uint32_t		caps2;
+	uint32_t		caps3;
+	uint32_t		caps4;
+	uint32_t		reserved2;
+};
+
+struct DDSHeaderDX10
+{
+	uint32_t	dxgiFormat;
+	uint32_t	resourceDimension;
+	uint32_t	miscFlag;
+	uint32_t	arraySize;
+	uint32_t	miscFlags2;
+};
+
+static const uint32_t DDSMagic = 0x20534444;					// "DDS "
+static const uint32_t DDSFourCCDX10 = 0x30315844;				// "DX10"
+static const uint32_t DDSFourCCDXT1 = 0x31545844;				// "DXT1"
+static const uint32_t DDSPixelFormatFourCC = 0x4;
+static const uint32_t DDSPixelFormatRGB = 0x40;
+static const uint32_t DDSHeaderFlags = 0x1 | 0x2 | 0x4 | 0x1000;	// caps, height, width, pixel format
+static const uint32_t DDSHeaderFlagLinearSize = 0x80000;
+static const uint32_t DDSHeaderFlagPitch = 0x8;
+static const uint32_t DDSHeaderFlagMipMapCount = 0x20000;
+static const uint32_t DDSCapsTexture = 0x1000;
+static const uint32_t DDSCapsMipMap = 0x8 | 0x400000;			// complex, mipmap
+static const uint32_t DDSDimensionTexture2D = 3;
+
+size_t ReadDDSHeader(const UINT8* data, size_t size, size_t fileSize, const string &filepath, TextureInfo &texture)
+{
+	DDSHeader header;
+	size_t offset = sizeof(uint32_t) + sizeof(DDSHeader);
+	if (size < offset || *reinterpret_cast<const uint32_t*>(data) != DDSMagic)
+	{
+		throw runtime_error("Error: '" + filepath + "' is not a DDS file!");
+	}
+	memcpy(&header, data + sizeof(uint32_t), sizeof(DDSHeader));
+
+	DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+	if ((header.pixelFormat.flags & DDSPixelFormatFourCC) && header.pixelFormat.fourCC == DDSFourCCDX10)
+	{
+		DDSHeaderDX10 extension;
+		if (size < offset + sizeof(DDSHeaderDX10)) throw runtime_error("Error: DDS file '" + filepath + "' is truncated!");
+		memcpy(&extension, data + offset, sizeof(DDSHeaderDX10));
+		offset += sizeof(DDSHeaderDX10);
+
+		DXGI_FORMAT stored = static_cast<DXGI_FORMAT>(extension.dxgiFormat);
+		if (extension.resourceDimension == DDSDimensionTexture2D && (stored == DXGI_FORMAT_R8G8B8A8_UNORM || IsBlockCompressed(stored))) format = stored;
+	}
+	else if ((header.pixelFormat.flags & DDSPixelFormatFourCC) && header.pixelFormat.fourCC == DDSFourCCDXT1)
+	{
+		format = DXGI_FORMAT_BC1_UNORM;
+	}
+	else if ((header.pixelFormat.flags & DDSPixelFormatRGB) && header.pixelFormat.rgbBitCount == 32 && header.pixelFormat.rBitMask == 0x000000ff &&
+		header.pixelFormat.gBitMask == 0x0000ff00 && header.pixelFormat.bBitMask == 0x00ff0000)
+	{
+		format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	}
+
+	if (format == DXGI_FORMAT_UNKNOWN)
+	{
+		throw runtime_error("Error: DDS file '" + filepath + "' is not an RGBA8, BC1, or BC7 2D texture!");
+	}
+
+	texture.width = static_cast<int>(header.width);
+	texture.height = static_cast<int>(header.height);
+	texture.format = format;
+	texture.stride = (format == DXGI_FORMAT_BC1_UNORM) ? 8 : (format == DXGI_FORMAT_BC7_UNORM) ? 16 : 4;
+	texture.mipLevels = ((header.flags & DDSHeaderFlagMipMapCount) && header.mipMapCount > 0) ? static_cast<int>(min(header.mipMapCount, 16u)) : 1;
+
+	if (texture.width <= 0 || texture.height <= 0 || fileSize - offset < GetMipOffset(texture, texture.mipLevels))
+	{
+		throw runtime_error("Error: DDS file '" + filepath + "' is truncated!");
+	}
+	return offset;
+}
+
+void LoadDDS(const string &filepath, TextureInfo &texture)
+{
+	// The texels are read straight into the texture's pixels, a mapping would only be copied from
+	ifstream file(filepath, ios::ate | ios::binary);
+	if (!file.is_open())
+	{
+		throw runtime_error("Error: failed to open DDS file '" + filepath + "'!");
+	}
+	const size_t fileSize = static_cast<size_t>(file.tellg());
+
+	UINT8 header[sizeof(uint32_t) + sizeof(DDSHeader) + sizeof(DDSHeaderDX10)];
+	const size_t headerSize = min(fileSize, sizeof(header));
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(header), static_cast<streamsize>(headerSize));
+
+	const size_t offset = ReadDDSHeader(header, headerSize, fileSize, filepath, texture);
+	texture.pixels.resize(GetMipOffset(texture, texture.mipLevels));
+	file.seekg(static_cast<streamoff>(offset));
+	file.read(reinterpret_cast<char*>(texture.pixels.data()), static_cast<streamsize>(texture.pixels.size()));
+	if (!file.good())
+	{
+		throw runtime_error("Error: failed to read DDS file '" + filepath + "'!");
+	}
+}
+
+void SaveDDS(const string &filepath, const TextureInfo &texture)
+{
+	DDSHeader header = {};
+	header.size = sizeof(DDSHeader);
+	header.flags = DDSHeaderFlags | DDSHeaderFlagMipMapCount | (IsBlockCompressed(texture.format) ? DDSHeaderFlagLinearSize : DDSHeaderFlagPitch);
+	header.height = texture.height;
+	header.width = texture.width;
+	header.pitchOrLinearSize = static_cast<uint32_t>(IsBlockCompressed(texture.format) ? GetRowPitch(texture) * GetRowCount(texture) : GetRowPitch(texture));
+	header.mipMapCount = texture.mipLevels;
+	header.pixelFormat.size = sizeof(DDSPixelFormat);
+	header.pixelFormat.flags = DDSPixelFormatFourCC;
+	header.pixelFormat.fourCC = DDSFourCCDX10;
+	header.caps = DDSCapsTexture | ((texture.mipLevels > 1) ? DDSCapsMipMap : 0);
+
+	DDSHeaderDX10 extension = {};
+	extension.dxgiFormat = static_cast<uint32_t>(texture.format);
+	extension.resourceDimension = DDSDimensionTexture2D;
+	extension.arraySize = 1;
+
+	// Written beside the destination under a name no other writer uses, then renamed into place, so a reader never sees a partial file
+	string temporaryPath = Utils::GetTemporaryPath(filepath);
+	{
+		ofstream file(temporaryPath, ios::binary | ios::trunc);
+		if (!file.is_open())
+		{
+			throw runtime_error("Error: failed to create DDS file '" + temporaryPath + "'!");
+		}
+
+		file.write(reinterpret_cast<const char*>(&DDSMagic), sizeof(DDSMagic));
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(&extension), sizeof(extension));
+		file.write(reinterpret_cast<const char*>(texture.pixels.data()), static_cast<streamsize>(GetMipOffset(texture, texture.mipLevels)));
+		if (!file.good())
+		{
+			file.close();
+			DeleteFileA(temporaryPath.c_str());
+			throw runtime_error("Error: failed to write DDS file '" + filepath + "'!");
+		}
+	}
+
+	if (!MoveFileExA(temporaryPath.c_str(), filepath.c_str(), MOVEFILE_REPLACE_EXISTING))
+	{
+		DeleteFileA(temporaryPath.c_str());
+		throw runtime_error("Error: failed to replace DDS file '" + filepath + "'!");
+	}
+}
+
+}
@@ -0,0 +1,983 @@
+/* Copyright (c) 2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Textures.h"
+#include "Utils.h"
+#include "TextureCompression.h"
+#include "HighResolutionClock.h"
+
+namespace Textures
+{
+
+//--------------------------------------------------------------------------------------
+// Textures
+//--------------------------------------------------------------------------------------
+
+static const UINT PixelSizes[] = { 3, 3, 1 };		// source bytes per pixel, by PixelFormat
+
+/**
+* A shuffle step converts the pixels of one 16 byte source window into RGBA: four pixels of a three channel format, or sixteen grey
+* pixels. The window of a mirrored step ends at the step's last pixel instead of starting at its first, so neither reads past the row.
+*/
+struct PixelShuffle
+{
+	alignas(16) UINT8	masks[4][16];
+	UINT				pixelsPerStep;
+	UINT				outputs;		// 16 byte outputs per step
+	UINT				slack;			// unused window bytes before the first pixel of a mirrored step
+};
+
+static PixelShuffle GetPixelShuffle(PixelFormat format, bool mirror)
+{
+	PixelShuffle shuffle;
+	const UINT size = PixelSizes[static_cast<int>(format)];
+	shuffle.pixelsPerStep = (size == 1) ? 16 : 4;
+	shuffle.outputs = shuffle.pixelsPerStep / 4;
+	shuffle.slack = 16 - shuffle.pixelsPerStep * size;
+
+	for (UINT q = 0; q < shuffle.outputs; q++)
+	{
+		for (UINT i = 0; i < 4; i++)
+		{
+			UINT p = 4 * q + i;
+			UINT offset = mirror ? shuffle.slack + (shuffle.pixelsPerStep - 1 - p) * size : p * size;
+			for (UINT c = 0; c < 3; c++)
+			{
+				UINT channel = (format == PixelFormat::Grey) ? 0 : (format == PixelFormat::BGR) ? 2 - c : c;
+				shuffle.masks[q][4 * i + c] = static_cast<UINT8>(offset + channel);
+			}
+			shuffle.masks[q][4 * i + 3] = 0x80;		// zeroed, then set by the alpha mask
+		}
+	}
+	return shuffle;
+}
+
+/**
+* Convert pixels [first, last) of a row one at a time. Finishes the rows the shuffle kernels leave short.
+*/
+static void ConvertRowScalar(const UINT8* source, PixelFormat format, bool mirror, UINT width, UINT first, UINT last, UINT8* destination)
+{
+	const UINT size = PixelSizes[static_cast<int>(format)];
+	for (UINT x = first; x < last; x++)
+	{
+		const UINT8* pixel = source + (mirror ? width - 1 - x : x) * size;
+		UINT8* output = destination + x * 4;
+		switch (format)
+		{
+		case PixelFormat::RGB:	output[0] = pixel[0]; output[1] = pixel[1]; output[2] = pixel[2]; break;
+		case PixelFormat::BGR:	output[0] = pixel[2]; output[1] = pixel[1]; output[2] = pixel[0]; break;
+		case PixelFormat::Grey:	output[0] = output[1] = output[2] = pixel[0]; break;
+		}
+		output[3] = 0xff;
+	}
+}
+
+/**
+* Source window of the shuffle step starting at pixel x.
+*/
+static inline const UINT8* GetPixelWindow(const UINT8* source, const PixelShuffle &shuffle, UINT size, bool mirror, UINT width, UINT x)
+{
+	return mirror ? source + (width - x - shuffle.pixelsPerStep) * size - shuffle.slack : source + x * size;
+}
+
+/**
+* Convert the front of a row with SSSE3 byte shuffles, returning how many pixels were converted.
+*/
+static UINT ConvertRowSSSE3(const UINT8* source, const PixelShuffle &shuffle, UINT size, bool mirror, UINT width, UINT8* destination)
+{
+	const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xff000000));
+	__m128i masks[4];
+	for (UINT q = 0; q < shuffle.outputs; q++) masks[q] = _mm_load_si128(reinterpret_cast<const __m128i*>(shuffle.masks[q]));
+
+	UINT x = 0;
+	for (; (width - x) * size >= 16; x += shuffle.pixelsPerStep)
+	{
+		__m128i window = _mm_loadu_si128(reinterpret_cast<const __m128i*>(GetPixelWindow(source, shuffle, size, mirror, width, x)));
+		for (UINT q = 0; q < shuffle.outputs; q++)
+		{
+			__m128i pixels = _mm_or_si128(_mm_shuffle_epi8(window, masks[q]), alpha);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + x * 4 + q * 16), pixels);
+		}
+	}
+	return x;
+}
+
+/**
+* Convert the front of a row with AVX2, two shuffle steps at a time, one per 128-bit lane.
+*/
+static UINT ConvertRowAVX2(const UINT8* source, const PixelShuffle &shuffle, UINT size, bool mirror, UINT width, UINT8* destination)
+{
+	const __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xff000000));
+	__m256i masks[4];
+	for (UINT q = 0; q < shuffle.outputs; q++) masks[q] = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(shuffle.masks[q])));
+
+	const UINT step = shuffle.pixelsPerStep;
+	UINT x = 0;
+	for (; x + step < width && (width - x - step) * size >= 16; x += 2 * step)
+	{
+		__m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(GetPixelWindow(source, shuffle, size, mirror, width, x)));
+		__m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(GetPixelWindow(source, shuffle, size, mirror, width, x + step)));
+		__m256i window = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+		for (UINT q = 0; q < shuffle.outputs; q++)
+		{
+			__m256i pixels = _mm256_or_si256(_mm256_shuffle_epi8(window, masks[q]), alpha);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + x * 4 + q * 16), _mm256_castsi256_si128(pixels));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + (x + step) * 4 + q * 16), _mm256_extracti128_si256(pixels, 1));
+		}
+	}
+
+	// One SSSE3 sized step may still fit
+	return x + ConvertRowSSSE3(mirror ? source : source + x * size, shuffle, size, mirror, width - x, destination + x * 4);
+}
+
+enum class PixelKernel { Scalar, SSSE3, AVX2 };
+
+/**
+* Pick the widest kernel the processor and operating system support.
+*/
+static PixelKernel GetPixelKernel()
+{
+	int info[4];
+	__cpuid(info, 0);
+	const int highest = info[0];
+
+	__cpuid(info, 1);
+	const bool ssse3 = (info[2] & (1 << 9)) != 0;
+	const bool avxSaved = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && ((_xgetbv(0) & 6) == 6);
+
+	bool avx2 = false;
+	if (highest >= 7 && avxSaved)
+	{
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] & (1 << 5)) != 0;
+	}
+	return avx2 ? PixelKernel::AVX2 : ssse3 ? PixelKernel::SSSE3 : PixelKernel::Scalar;
+}
+
+void ConvertPixels(const UINT8* source, PixelFormat format, UINT width, UINT height, bool flip, bool mirror, UINT8* destination)
+{
+	static const PixelKernel kernel = GetPixelKernel();
+
+	const UINT size = PixelSizes[static_cast<int>(format)];
+	const PixelShuffle shuffle = GetPixelShuffle(format, mirror);
+	const size_t sourcePitch = static_cast<size_t>(width) * size;
+	const size_t destinationPitch = static_cast<size_t>(width) * 4;
+
+	Utils::ParallelFor(height, max(static_cast<size_t>(1), (1 << 18) / max(destinationPitch, static_cast<size_t>(1))), [&](size_t first, size_t last)
+	{
+		for (size_t y = first; y < last; y++)
+		{
+			const UINT8* sourceRow = source + (flip ? height - 1 - y : y) * sourcePitch;
+			UINT8* destinationRow = destination + y * destinationPitch;
+
+			UINT converted = 0;
+			if (kernel == PixelKernel::AVX2) converted = ConvertRowAVX2(sourceRow, shuffle, size, mirror, width, destinationRow);
+			else if (kernel == PixelKernel::SSSE3) converted = ConvertRowSSSE3(sourceRow, shuffle, size, mirror, width, destinationRow);
+			ConvertRowScalar(sourceRow, format, mirror, width, converted, width, destinationRow);
+		}
+	});
+}
+
+void FormatTexture(TextureInfo &info, stbi_uc* pixels)
+{
+	HighResolutionClock clock;
+
+	info.pixels.resize(static_cast<size_t>(info.width) * info.height * 4);
+	info.stride = 4;
+	info.format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	ConvertPixels(pixels, PixelFormat::RGB, info.width, info.height, true, true, info.pixels.data());
+
+	clock.Tick();
+	double milliseconds = clock.GetDeltaMilliseconds();
+	double bytes = static_cast<double>(info.width) * info.height * 7;		// three read and four written per pixel
+	Utils::Log("Texture: converted %dx%d RGB to RGBA in %.2f ms (%.2f GB/s)\n", info.width, info.height, milliseconds, bytes / (max(milliseconds, 0.001) * 1.0e6));
+}
+
+/**
+* Average 2x2 blocks of an RGBA8 level into the next level down, two texels at a time. An odd last row or column
+* of the source is averaged with itself.
+*/
+static void DownsampleRow(const UINT8* row0, const UINT8* row1, UINT sourceWidth, UINT width, UINT8* destination)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i rounding = _mm_set1_epi16(2);
+
+	UINT x = 0;
+	for (; x + 2 <= width && 2 * x + 4 <= sourceWidth; x += 2)
+	{
+		__m128i top = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+		__m128i bottom = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+
+		// Sum the rows per channel, then the horizontal pairs
+		__m128i left = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+		__m128i right = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+		left = _mm_add_epi16(left, _mm_srli_si128(left, 8));
+		right = _mm_add_epi16(right, _mm_srli_si128(right, 8));
+
+		__m128i average = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(left, right), rounding), 2);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(destination + x * 4), _mm_packus_epi16(average, average));
+	}
+
+	for (; x < width; x++)
+	{
+		UINT x0 = min(2 * x, sourceWidth - 1) * 4;
+		UINT x1 = min(2 * x + 1, sourceWidth - 1) * 4;
+		for (UINT c = 0; c < 4; c++)
+		{
+			destination[x * 4 + c] = static_cast<UINT8>((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+		}
+	}
+}
+
+void GenerateMips(TextureInfo &info)
+{
+	if (info.format != DXGI_FORMAT_R8G8B8A8_UNORM || info.mipLevels != 1 || info.width <= 0 || info.height <= 0) return;
+
+	HighResolutionClock clock;
+
+	int levels = 1;
+	while ((max(info.width, info.height) >> levels) > 0) levels++;
+	info.mipLevels = levels;
+	info.pixels.resize(TextureCompression::GetMipOffset(info, levels));
+
+	for (UINT mip = 1; mip < static_cast<UINT>(levels); mip++)
+	{
+		const UINT8* source = info.pixels.data() + TextureCompression::GetMipOffset(info, mip - 1);
+		UINT8* destination = info.pixels.data() + TextureCompression::GetMipOffset(info, mip);
+		const UINT sourceWidth = max(static_cast<UINT>(info.width) >> (mip - 1), 1u);
+		const UINT sourceHeight = max(static_cast<UINT>(info.height) >> (mip - 1), 1u);
+		const UINT width = max(sourceWidth >> 1, 1u);
+		const UINT height = max(sourceHeight >> 1, 1u);
+
+		Utils::ParallelFor(height, max(static_cast<size_t>(1), static_cast<size_t>(16384 / width)), [&](size_t first, size_t last)
+		{
+			for (size_t y = first; y < last; y++)
+			{
+				const UINT8* row0 = source + min(2 * static_cast<UINT>(y), sourceHeight - 1) * sourceWidth * 4;
+				const UINT8* row1 = source + min(2 * static_cast<UINT>(y) + 1, sourceHeight - 1) * sourceWidth * 4;
+				DownsampleRow(row0, row1, sourceWidth, width, destination + y * width * 4);
+			}
+		});
+	}
+
+	clock.Tick();
+	Utils::Log("Texture: generated %d mip levels for %dx%d in %.2f ms\n", levels, info.width, info.height, clock.GetDeltaMilliseconds());
+}
+
+/**
+* Filter taps of an area resample from source to target texels along one axis. Each target texel averages the source
+* texels it covers, weighted by how much of each it covers, with at most tapCount taps.
+*/
+struct ResampleTaps
+{
+	vector<UINT> first;
+	vector<UINT> count;
+	vector<float> weights;
+	UINT tapCount;
+};
+
+static ResampleTaps GetResampleTaps(UINT source, UINT target)
+{
+	ResampleTaps taps;
+	const double scale = static_cast<double>(source) / target;
+	taps.tapCount = static_cast<UINT>(ceil(scale)) + 1;
+	taps.first.resize(target);
+	taps.count.resize(target);
+	taps.weights.assign(static_cast<size_t>(target) * taps.tapCount, 0.f);
+
+	for (UINT i = 0; i < target; i++)
+	{
+		const double start = i * scale;
+		const double end = min((i + 1) * scale, static_cast<double>(source));
+		const UINT first = min(static_cast<UINT>(start), source - 1);
+		const UINT last = min(static_cast<UINT>(ceil(end)), source);
+
+		taps.first[i] = first;
+		taps.count[i] = min(last - first, taps.tapCount);
+		for (UINT k = 0; k < taps.count[i]; k++)
+		{
+			const double overlap = min(end, first + k + 1.0) - max(start, static_cast<double>(first + k));
+			taps.weights[static_cast<size_t>(i) * taps.tapCount + k] = static_cast<float>(overlap / scale);
+		}
+	}
+	return taps;
+}
+
+void ResampleTexture(TextureInfo &info, int width, int height)
+{
+	if (info.format != DXGI_FORMAT_R8G8B8A8_UNORM || width <= 0 || height <= 0) return;
+	if (width > info.width || height > info.height || (width == info.width && height == info.height)) return;
+
+	HighResolutionClock clock;
+
+	const UINT sourceWidth = static_cast<UINT>(info.width);
+	const UINT sourceHeight = static_cast<UINT>(info.height);
+	const ResampleTaps columns = GetResampleTaps(sourceWidth, static_cast<UINT>(width));
+	const ResampleTaps rows = GetResampleTaps(sourceHeight, static_cast<UINT>(height));
+
+	// Horizontal pass: every source row to width float texels
+	vector<__m128> filtered(static_cast<size_t>(sourceHeight) * width);
+	Utils::ParallelFor(sourceHeight, max(static_cast<size_t>(1), static_cast<size_t>(16384 / sourceWidth)), [&](size_t first, size_t last)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		for (size_t y = first; y < last; y++)
+		{
+			const UINT8* source = info.pixels.data() + y * sourceWidth * 4;
+			__m128* destination = filtered.data() + y * width;
+			for (int x = 0; x < width; x++)
+			{
+				const UINT8* texels = source + columns.first[x] * 4;
+				const float* weights = columns.weights.data() + static_cast<size_t>(x) * columns.tapCount;
+
+				__m128 sum = _mm_setzero_ps();
+				for (UINT k = 0; k < columns.count[x]; k++)
+				{
+					int packed;
+					memcpy(&packed, texels + k * 4, 4);
+					__m128i texel = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_cvtepi32_ps(texel), _mm_set1_ps(weights[k])));
+				}
+				destination[x] = sum;
+			}
+		}
+	});
+
+	// Vertical pass: weighted sum of the filtered rows under each target row, rounded back to bytes
+	vector<UINT8> pixels(static_cast<size_t>(width) * height * 4);
+	Utils::ParallelFor(height, max(static_cast<size_t>(1), static_cast<size_t>(16384 / width)), [&](size_t first, size_t last)
+	{
+		for (size_t y = first; y < last; y++)
+		{
+			const __m128* source = filtered.data() + static_cast<size_t>(rows.first[y]) * width;
+			const float* weights = rows.weights.data() + y * rows.tapCount;
+			UINT8* destination = pixels.data() + y * width * 4;
+			for (int x = 0; x < width; x++)
+			{
+				__m128 sum = _mm_setzero_ps();
+				for (UINT k = 0; k < rows.count[y]; k++)
+				{
+					sum = _mm_add_ps(sum, _mm_mul_ps(source[static_cast<size_t>(k) * width + x], _mm_set1_ps(weights[k])));
+				}
+				__m128i texel = _mm_cvtps_epi32(sum);
+				texel = _mm_packus_epi16(_mm_packs_epi32(texel, texel), texel);
+				int packed = _mm_cvtsi128_si32(texel);
+				memcpy(destination + x * 4, &packed, 4);
+			}
+		}
+	});
+
+	clock.Tick();
+	Utils::Log("Texture: resampled %dx%d to %dx%d in %.2f ms\n", info.width, info.height, width, height, clock.GetDeltaMilliseconds());
+
+	info.pixels = move(pixels);
+	info.width = width;
+	info.height = height;
+	info.mipLevels = 1;
+}
+
+TextureInfo LoadTexture(string filepath) 
+{
+	TextureInfo result;
+	if (Utils::GetExtension(filepath) == ".dds")
+	{
+		TextureCompression::LoadDDS(filepath, result);
+		return result;
+	}
+
+	// Load image pixels with stb_image
+	stbi_uc* pixels = stbi_load(filepath.c_str(), &result.width, &result.height, &result.stride, STBI_rgb);
+	if (!pixels) 
+	{
+		throw runtime_error("Error: failed to load image!");
+	}
+
+	FormatTexture(result, pixels);
+	stbi_image_free(pixels);
+	return result;
+}
+
+TextureInfo LoadTexture(const vector<UINT8> &data)
+{
+	return LoadTexture(data.data(), data.size());
+}
+
+TextureInfo LoadTexture(const UINT8* data, size_t size)
+{
+	TextureInfo result;
+
+	// Load image pixels with stb_image
+	stbi_uc* pixels = stbi_load_from_memory(data, static_cast<int>(size), &result.width, &result.height, &result.stride, STBI_rgb);
+	if (!pixels)
+	{
+		throw runtime_error("Error: failed to load image!");
+	}
+
+	FormatTexture(result, pixels);
+	stbi_image_free(pixels);
+	return result;
+}
+
+/**
+* Write mips from firstMip on of tightly packed texels, laid out as layout describes them, to the destination's footprints.
+* Rows are written in order and never read back, upload heaps are write combined.
+*/
+static void WriteTextureMips(const UINT8* source, const TextureInfo &layout, UINT firstMip, UINT8* destination, const vector<TextureFootprint> &footprints)
+{
+	for (UINT i = 0; i < footprints.size(); i++)
+	{
+		const UINT mip = firstMip + i;
+		const UINT8* sourceRows = source + TextureCompression::GetMipOffset(layout, mip);
+		const size_t pitch = TextureCompression::GetRowPitch(layout, mip);
+		const UINT rows = TextureCompression::GetRowCount(layout, mip);
+		UINT8* destinationRows = destination + footprints[i].offset;
+
+		if (footprints[i].rowPitch == pitch)
+		{
+			memcpy(destinationRows, sourceRows, pitch * rows);
+			continue;
+		}
+		for (UINT row = 0; row < rows; row++)
+		{
+			memcpy(destinationRows + row * footprints[i].rowPitch, sourceRows + row * pitch, pitch);
+		}
+	}
+}
+
+void WriteTexture(const TextureInfo &texture, UINT8* destination, const vector<TextureFootprint> &footprints)
+{
+	WriteTextureMips(texture.pixels.data(), texture, 0, destination, footprints);
+}
+
+//--------------------------------------------------------------------------------------
+// Texture Cache
+//--------------------------------------------------------------------------------------
+
+/**
+* Bump when the decoded payload changes for the same source and options, so stale cache entries are never read.
+*/
+static const uint64_t TextureCacheVersion = 1;
+
+/**
+* Hash a buffer a 64-bit word at a time, 1 MB chunks in parallel with the chunk hashes combined in order.
+*/
+static uint64_t HashBytes(const UINT8* data, size_t size)
+{
+	const size_t chunkSize = 1 << 20;
+	const size_t chunkCount = (size + chunkSize - 1) / chunkSize;
+	vector<uint64_t> chunkHashes(chunkCount);
+
+	Utils::ParallelFor(chunkCount, 1, [&](size_t first, size_t last)
+	{
+		for (size_t c = first; c < last; c++)
+		{
+			const UINT8* chunk = data + c * chunkSize;
+			const size_t length = min(chunkSize, size - c * chunkSize);
+
+			uint64_t hash = 0x9e3779b97f4a7c15ull ^ c;
+			size_t i = 0;
+			for (; i + 8 <= length; i += 8)
+			{
+				uint64_t word;
+				memcpy(&word, chunk + i, 8);
+				hash ^= word * 0xff51afd7ed558ccdull;
+				hash = ((hash << 29) | (hash >> 35)) * 0xc4ceb9fe1a85ec53ull;
+			}
+			for (; i < length; i++) hash = Utils::HashCombine(hash, chunk[i]);
+			chunkHashes[c] = hash;
+		}
+	});
+
+	uint64_t hash = Utils::HashCombine(14695981039346656037ull, size);
+	for (uint64_t chunkHash : chunkHashes) hash = Utils::HashCombine(hash, chunkHash);
+	return hash;
+}
+
+/**
+* Bytes of texture memory used by the textures loaded so far, counted against ConfigInfo::textureBudget.
+*/
+static atomic<size_t> textureMemoryUsed(0);
+
+/**
+* Bytes a width x height texture takes in the given format with its full mip chain, about a third more than the top level.
+*/
+static size_t GetTextureMemory(int width, int height, DXGI_FORMAT format)
+{
+	size_t blocks = static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4);
+	size_t bytes = static_cast<size_t>(width) * height * 4;
+	if (format == DXGI_FORMAT_BC1_UNORM) bytes = blocks * 8;
+	else if (format == DXGI_FORMAT_BC7_UNORM) bytes = blocks * 16;
+	return bytes + bytes / 3;
+}
+
+/**
+* Size a texture is loaded at: no wider than its material's target resolution, keeping the aspect ratio, then halved
+* until it fits in what is left of the texture budget. Sides stay multiples of 4 when the format is block compressed.
+*/
+static void GetTextureTargetSize(int width, int height, const Material &material, const ConfigInfo &config, int &targetWidth, int &targetHeight)
+{
+	targetWidth = width;
+	targetHeight = height;
+	if (material.textureTargetResolution > 0 && material.textureTargetResolution < width)
+	{
+		targetWidth = material.textureTargetResolution;
+		targetHeight = max(1, static_cast<int>(static_cast<int64_t>(height) * targetWidth / width));
+	}
+
+	if (config.textureBudget > 0)
+	{
+		const size_t used = textureMemoryUsed.load();
+		const size_t remaining = (config.textureBudget > used) ? config.textureBudget - used : 0;
+		while ((targetWidth > 1 || targetHeight > 1) && GetTextureMemory(targetWidth, targetHeight, config.textureFormat) > remaining)
+		{
+			targetWidth = max(1, targetWidth / 2);
+			targetHeight = max(1, targetHeight / 2);
+		}
+	}
+
+	if (config.textureFormat != DXGI_FORMAT_R8G8B8A8_UNORM && (targetWidth != width || targetHeight != height))
+	{
+		targetWidth = max(4, targetWidth & ~3);
+		targetHeight = max(4, targetHeight & ~3);
+		if (targetWidth > width || targetHeight > height)
+		{
+			targetWidth = width;
+			targetHeight = height;
+		}
+	}
+}
+
+/**
+* Number of leading mips of a texture loaded with its mip chain to drop for the top level to be no larger than the target size.
+*/
+static UINT GetDroppedMips(const TextureInfo &texture, int targetWidth, int targetHeight)
+{
+	UINT drop = 0;
+	while (drop + 1 < static_cast<UINT>(texture.mipLevels) && ((texture.width >> drop) > targetWidth || (texture.height >> drop) > targetHeight)) drop++;
+	return drop;
+}
+
+/**
+* Drop the leading mips of a texture loaded with its mip chain until the top level is no larger than the target size.
+*/
+static void DropTopMips(TextureInfo &texture, int targetWidth, int targetHeight)
+{
+	const UINT drop = GetDroppedMips(texture, targetWidth, targetHeight);
+	if (drop == 0) return;
+
+	const size_t offset = TextureCompression::GetMipOffset(texture, drop);
+	texture.pixels.erase(texture.pixels.begin(), texture.pixels.begin() + offset);
+	texture.width = max(texture.width >> drop, 1);
+	texture.height = max(texture.height >> drop, 1);
+	texture.mipLevels -= drop;
+}
+
+/**
+* Write a DDS file's mips, from the first within the material's target size on, straight from the mapped file to the memory
+* allocate returns, and describe them in texture. Returns false without allocating when the texels still need resampling,
+* mips, or compression for the configuration.
+*/
+static bool IngestDDS(const string &filepath, const Material &material, const ConfigInfo &config, const TextureAllocator &allocate, TextureInfo &texture)
+{
+	MappedFile file;
+	Utils::MapFile(filepath, file);
+	try
+	{
+		TextureInfo stored;
+		const size_t offset = TextureCompression::ReadDDSHeader(file.data, file.size, file.size, filepath, stored);
+
+		int targetWidth, targetHeight;
+		GetTextureTargetSize(stored.width, stored.height, material, config, targetWidth, targetHeight);
+		const UINT drop = GetDroppedMips(stored, targetWidth, targetHeight);
+
+		texture.width = max(stored.width >> drop, 1);
+		texture.height = max(stored.height >> drop, 1);
+		texture.stride = stored.stride;
+		texture.format = stored.format;
+		texture.mipLevels = stored.mipLevels - drop;
+
+		const bool rgba8 = (texture.format == DXGI_FORMAT_R8G8B8A8_UNORM);
+		const bool resample = (texture.mipLevels == 1) && (texture.width > targetWidth || texture.height > targetHeight);
+		const bool mips = rgba8 && (texture.mipLevels == 1) && (texture.width > 1 || texture.height > 1);
+		const bool compress = rgba8 && (config.textureFormat != DXGI_FORMAT_R8G8B8A8_UNORM);
+		if (resample || mips || compress)
+		{
+			Utils::UnmapFile(file);
+			return false;
+		}
+
+		vector<TextureFootprint> footprints;
+		UINT8* destination = allocate(texture, footprints);
+		WriteTextureMips(file.data + offset, stored, drop, destination, footprints);
+	}
+	catch (...)
+	{
+		Utils::UnmapFile(file);
+		throw;
+	}
+	Utils::UnmapFile(file);
+	return true;
+}
+
+/**
+* Decode, resample, mip, and compress a texture from its encoded image, or read the result of doing so from the texture cache.
+* Entries are named by the hash of the encoded image and the conversion options, and hold the GPU-ready payload as a DDS file,
+* so a warm start reads the entry instead of decoding the image. With an allocator, a cache hit is written from the mapped
+* entry straight to the memory it returns and the texture comes back without pixels.
+*/
+static TextureInfo ConvertTexture(const UINT8* data, size_t size, const Material &material, const ConfigInfo &config, const TextureAllocator &allocate)
+{
+	HighResolutionClock clock;
+
+	// The header alone gives the image size, so the target size is known before deciding whether to decode
+	int width, height, channels;
+	if (!stbi_info_from_memory(data, static_cast<int>(size), &width, &height, &channels))
+	{
+		throw runtime_error("Error: failed to load image!");
+	}
+
+	int targetWidth, targetHeight;
+	GetTextureTargetSize(width, height, material, config, targetWidth, targetHeight);
+
+	string cachePath;
+	if (config.textureCache)
+	{
+		uint64_t key = HashBytes(data, size);
+		key = Utils::HashCombine(key, TextureCacheVersion);
+		key = Utils::HashCombine(key, static_cast<uint64_t>(config.textureFormat));
+		key = Utils::HashCombine(key, static_cast<uint64_t>(targetWidth));
+		key = Utils::HashCombine(key, static_cast<uint64_t>(targetHeight));
+
+		char name[32];
+		sprintf_s(name, "%016llx.dds", static_cast<unsigned long long>(key));
+		cachePath = string("cache\\textures\\") + name;
+
+		TextureInfo cached;
+		try
+		{
+			if (GetFileAttributesA(cachePath.c_str()) != INVALID_FILE_ATTRIBUTES)
+			{
+				if (!allocate || !IngestDDS(cachePath, material, config, allocate, cached)) TextureCompression::LoadDDS(cachePath, cached);
+				clock.Tick();
+				Utils::Log("Texture cache: hit %s in %.2f ms\n", cachePath.c_str(), clock.GetDeltaMilliseconds());
+				return cached;
+			}
+		}
+		catch (const exception &e)
+		{
+			Utils::Log("%s\n", e.what());
+		}
+	}
+
+	TextureInfo texture = LoadTexture(data, size);
+	ResampleTexture(texture, targetWidth, targetHeight);
+	GenerateMips(texture);
+	TextureCompression::Compress(texture, config.textureFormat);
+
+	if (!cachePath.empty())
+	{
+		try
+		{
+			CreateDirectoryA("cache", NULL);
+			CreateDirectoryA("cache\\textures", NULL);
+			TextureCompression::SaveDDS(cachePath, texture);
+		}
+		catch (const exception &e)
+		{
+			// The texture is still usable, it will be converted again on the next run
+			Utils::Log("%s\n", e.what());
+		}
+	}
+
+	clock.Tick();
+	Utils::Log("Texture cache: miss, converted in %.2f ms\n", clock.GetDeltaMilliseconds());
+	return texture;
+}
+
+/**
+* Number of mips of an atlas whose entries stay apart, down to the mip where the padding is a single texel.
+*/
+static UINT GetAtlasMipLevels(UINT padding)
+{
+	UINT levels = 1;
+	while ((padding >> levels) > 0) levels++;
+	return levels;
+}
+
+TextureInfo LoadMaterialTexture(const Material &material, const ConfigInfo &config, const TextureAllocator &allocate)
+{
+	TextureInfo texture;
+	bool written = false;
+	if (!material.textureAtlas.pixels.empty())
+	{
+		texture = material.textureAtlas;
+
+		int targetWidth, targetHeight;
+		GetTextureTargetSize(texture.width, texture.height, material, config, targetWidth, targetHeight);
+		const UINT padding = static_cast<UINT>(static_cast<uint64_t>(AtlasPadding) * targetWidth / texture.width);
+		ResampleTexture(texture, targetWidth, targetHeight);
+
+		// Coarser mips would blend neighbouring entries and the unused area, the chain stops where the padding is one texel
+		GenerateMips(texture);
+		const UINT levels = GetAtlasMipLevels(max(padding, 1u));
+		if (static_cast<UINT>(texture.mipLevels) > levels)
+		{
+			texture.mipLevels = levels;
+			texture.pixels.resize(TextureCompression::GetMipOffset(texture, levels));
+		}
+		TextureCompression::Compress(texture, config.textureFormat);
+	}
+	else if (!material.textureData.empty())
+	{
+		texture = ConvertTexture(material.textureData.data(), material.textureData.size(), material, config, allocate);
+		written = texture.pixels.empty();
+	}
+	else if (Utils::GetExtension(material.texturePath) == ".dds" && allocate && IngestDDS(material.texturePath, material, config, allocate, texture))
+	{
+		written = true;
+	}
+	else if (Utils::GetExtension(material.texturePath) == ".dds")
+	{
+		texture = LoadTexture(material.texturePath);
+
+		int targetWidth, targetHeight;
+		GetTextureTargetSize(texture.width, texture.height, material, config, targetWidth, targetHeight);
+		DropTopMips(texture, targetWidth, targetHeight);
+		if (texture.mipLevels == 1) ResampleTexture(texture, targetWidth, targetHeight);
+
+		GenerateMips(texture);
+		TextureCompression::Compress(texture, config.textureFormat);
+	}
+	else
+	{
+		MappedFile file;
+		Utils::MapFile(material.texturePath, file);
+		try
+		{
+			texture = ConvertTexture(file.data, file.size, material, config, allocate);
+			written = texture.pixels.empty();
+			Utils::UnmapFile(file);
+		}
+		catch (...)
+		{
+			Utils::UnmapFile(file);
+			throw;
+		}
+	}
+
+	const size_t bytes = TextureCompression::GetMipOffset(texture, texture.mipLevels);
+	const size_t used = textureMemoryUsed.fetch_add(bytes) + bytes;
+	if (config.textureBudget > 0 && used > config.textureBudget)
+	{
+		Utils::Log("Texture: %zu KB of textures exceeds the %zu KB budget\n", used >> 10, config.textureBudget >> 10);
+	}
+
+	if (allocate && !written)
+	{
+		vector<TextureFootprint> footprints;
+		UINT8* destination = allocate(texture, footprints);
+		WriteTexture(texture, destination, footprints);
+		vector<UINT8>().swap(texture.pixels);
+	}
+	return texture;
+}
+
+//--------------------------------------------------------------------------------------
+// Texture Atlas
+//--------------------------------------------------------------------------------------
+
+/**
+* Bottom-left skyline: the top edge of the packed rectangles, left to right, as spans of equal height.
+*/
+struct SkylineSpan
+{
+	UINT x;
+	UINT y;
+	UINT width;
+};
+
+/**
+* Height a width x height rectangle would rest at with its left edge on span i, or false if it does not fit in size x size.
+*/
+static bool FitSkyline(const vector<SkylineSpan> &skyline, size_t i, UINT width, UINT height, UINT size, UINT &y)
+{
+	if (skyline[i].x + width > size) return false;
+
+	y = 0;
+	UINT covered = 0;
+	for (size_t s = i; covered < width; s++)
+	{
+		if (s >= skyline.size()) return false;
+		y = max(y, skyline[s].y);
+		if (y + height > size) return false;
+		covered += skyline[s].width;
+	}
+	return true;
+}
+
+/**
+* Place rectangles tallest first, each where it rests lowest with the narrowest span breaking ties, and raise the skyline
+* under it. Returns false when they do not all fit in size x size.
+*/
+static bool PackSkyline(const vector<UINT> &widths, const vector<UINT> &heights, UINT size, vector<UINT> &x, vector<UINT> &y)
+{
+	vector<size_t> order(widths.size());
+	for (size_t i = 0; i < order.size(); i++) order[i] = i;
+	sort(order.begin(), order.end(), [&](size_t a, size_t b) { return heights[a] != heights[b] ? heights[a] > heights[b] : widths[a] > widths[b]; });
+
+	vector<SkylineSpan> skyline = { { 0, 0, size } };
+	x.assign(widths.size(), 0);
+	y.assign(widths.size(), 0);
+
+	for (size_t r : order)
+	{
+		const UINT width = widths[r];
+		const UINT height = heights[r];
+
+		size_t best = skyline.size();
+		UINT bestTop = UINT_MAX;
+		UINT bestWidth = UINT_MAX;
+		UINT bestY = 0;
+		for (size_t i = 0; i < skyline.size(); i++)
+		{
+			UINT top;
+			if (!FitSkyline(skyline, i, width, height, size, top)) continue;
+			if (top + height < bestTop || (top + height == bestTop && skyline[i].width < bestWidth))
+			{
+				best = i;
+				bestTop = top + height;
+				bestWidth = skyline[i].width;
+				bestY = top;
+			}
+		}
+		if (best == skyline.size()) return false;
+
+		x[r] = skyline[best].x;
+		y[r] = bestY;
+
+		// The rectangle's top becomes a span, and the spans it covers shrink or go
+		const SkylineSpan placed = { skyline[best].x, bestTop, width };
+		skyline.insert(skyline.begin() + best, placed);
+		for (size_t s = best + 1; s < skyline.size();)
+		{
+			const UINT right = placed.x + placed.width;
+			if (skyline[s].x >= right) break;
+			const UINT overlap = min(right - skyline[s].x, skyline[s].width);
+			skyline[s].x += overlap;
+			skyline[s].width -= overlap;
+			if (skyline[s].width == 0) skyline.erase(skyline.begin() + s);
+			else break;
+		}
+
+		// Merge neighbours of equal height
+		for (size_t s = 0; s + 1 < skyline.size();)
+		{
+			if (skyline[s].y == skyline[s + 1].y)
+			{
+				skyline[s].width += skyline[s + 1].width;
+				skyline.erase(skyline.begin() + s + 1);
+			}
+			else s++;
+		}
+	}
+	return true;
+}
+
+TextureInfo BuildTextureAtlas(const vector<TextureInfo> &textures, UINT padding, vector<XMFLOAT4> &rects)
+{
+	HighResolutionClock clock;
+	const UINT maxSize = D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION;
+
+	vector<TextureInfo> scaled;
+	const vector<TextureInfo>* sources = &textures;
+
+	const UINT alignment = 4 << (GetAtlasMipLevels(padding) - 1);
+
+	vector<UINT> widths(textures.size()), heights(textures.size()), x, y;
+	UINT size = 0;
+	for (;;)
+	{
+		uint64_t area = 0;
+		UINT largest = 1;
+		for (size_t t = 0; t < sources->size(); t++)
+		{
+			widths[t] = ALIGN(alignment, (*sources)[t].width + 2 * padding);
+			heights[t] = ALIGN(alignment, (*sources)[t].height + 2 * padding);
+			area += static_cast<uint64_t>(widths[t]) * heights[t];
+			largest = max(largest, max(widths[t], heights[t]));
+		}
+
+		size = 1;
+		while (size < largest || static_cast<uint64_t>(size) * size < area) size *= 2;
+		while (size <= maxSize && !PackSkyline(widths, heights, size, x, y)) size *= 2;
+		if (size <= maxSize) break;
+
+		// Too large for one texture, halve everything and try again
+		if (scaled.empty()) scaled = textures;
+		for (TextureInfo &texture : scaled) ResampleTexture(texture, max(texture.width / 2, 1), max(texture.height / 2, 1));
+		sources = &scaled;
+	}
+
+	TextureInfo atlas;
+	atlas.width = size;
+	atlas.height = size;
+	atlas.pixels.assign(static_cast<size_t>(size) * size * 4, 0);
+
+	rects.resize(sources->size());
+	Utils::ParallelFor(sources->size(), 1, [&](size_t first, size_t last)
+	{
+		for (size_t t = first; t < last; t++)
+		{
+			const TextureInfo &texture = (*sources)[t];
+			const UINT width = static_cast<UINT>(texture.width);
+			const UINT height = static_cast<UINT>(texture.height);
+
+			// Copy the rows with their edge texels repeated into the padding, the padding rows repeat the edge rows
+			for (UINT row = 0; row < heights[t]; row++)
+			{
+				const UINT sourceRow = static_cast<UINT>(min(max(static_cast<int>(row) - static_cast<int>(padding), 0), static_cast<int>(height) - 1));
+				const UINT8* source = texture.pixels.data() + static_cast<size_t>(sourceRow) * width * 4;
+				UINT8* destination = atlas.pixels.data() + (static_cast<size_t>(y[t] + row) * size + x[t]) * 4;
+
+				for (UINT column = 0; column < padding; column++) memcpy(destination + column * 4, source, 4);
+				memcpy(destination + padding * 4, source, static_cast<size_t>(width) * 4);
+				for (UINT column = padding + width; column < widths[t]; column++) memcpy(destination + column * 4, source + (width - 1) * 4, 4);
+			}
+
+			rects[t] = XMFLOAT4(
+				static_cast<float>(x[t] + padding) / size,
+				static_cast<float>(y[t] + padding) / size,
+				static_cast<float>(width) / size,
+				static_cast<float>(height) / size);
+		}
+	});
+
+	clock.Tick();
+	Utils::Log("Texture atlas: packed %zu textures into %ux%u in %.2f ms\n", sources->size(), size, size, clock.GetDeltaMilliseconds());
+	return atlas;
+}
+
+}
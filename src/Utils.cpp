@@ -28,6 +28,10 @@
 #pragma once
 
 #include "Utils.h"
+#include "Primitives.h"
+#include "Textures.h"
+#include "TextureCompression.h"
+#include "HighResolutionClock.h"
 
 namespace std
 {
@@ -99,124 +103,2230 @@ HRESULT ParseCommandLine(LPWSTR lpCmdLine, ConfigInfo &config)
 			}
 
 			if (strcmp(str, "-model") == 0)
+			{
+				// Take every following argument up to the next option as a model path
+				i++;
+				while (i < argc)
+				{
+					wcstombs(str, argv[i], 256);
+					if (str[0] == '-') break;
+					config.models.push_back(str);
+					i++;
+				}
+				if (!config.models.empty()) config.model = config.models[0];
+				continue;
+			}
+
+			if (strcmp(str, "-morton") == 0)
+			{
+				config.mortonOrder = true;
+				i++;
+				continue;
+			}
+
+			if (strcmp(str, "-index32") == 0)
+			{
+				config.wideIndices = true;
+				i++;
+				continue;
+			}
+
+			if (strcmp(str, "-lod") == 0)
+			{
+				config.generateLods = true;
+				i++;
+				continue;
+			}
+
+			if (strcmp(str, "-texformat") == 0)
+			{
+				i++;
+				wcstombs(str, argv[i], 256);
+				if (strcmp(str, "bc1") == 0) config.textureFormat = DXGI_FORMAT_BC1_UNORM;
+				else if (strcmp(str, "bc7") == 0) config.textureFormat = DXGI_FORMAT_BC7_UNORM;
+				else config.textureFormat = DXGI_FORMAT_R8G8B8A8_UNORM;
+				i++;
+				continue;
+			}
+
+			if (strcmp(str, "-savedds") == 0)
+			{
+				config.saveTextures = true;
+				i++;
+				continue;
+			}
+
+			if (strcmp(str, "-notexcache") == 0)
+			{
+				config.textureCache = false;
+				i++;
+				continue;
+			}
+
+			if (strcmp(str, "-lazytextures") == 0)
+			{
+				config.lazyTextures = true;
+				i++;
+				continue;
+			}
+
+			if (strcmp(str, "-vtbudget") == 0)
+			{
+				i++;
+				wcstombs(str, argv[i], 256);
+				config.virtualTextureBudget = static_cast<size_t>(atoi(str)) << 20;
+				i++;
+				continue;
+			}
+
+			if (strcmp(str, "-texbudget") == 0)
 			{
 				i++;
 				wcstombs(str, argv[i], 256);
-				config.model = str;
+				config.textureBudget = static_cast<size_t>(atoi(str)) << 20;
 				i++;
 				continue;
 			}
 
-			i++;
+			i++;
+		}
+	}
+	else {
+		return E_FAIL;
+	}
+
+	LocalFree(argv);
+	return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+// Error Messaging
+//--------------------------------------------------------------------------------------
+
+// Static initialization runs on the thread that owns the window and its message queue
+static const thread::id mainThread = this_thread::get_id();
+
+/**
+* Report a failed HRESULT. On the main thread the message is shown and the application quits, on other threads, such as
+* startup tasks, it is thrown so the thread waiting on them reports it.
+*/
+void Validate(HRESULT hr, LPWSTR msg)
+{
+	if (FAILED(hr))
+	{
+		if (this_thread::get_id() != mainThread)
+		{
+			char str[256];
+			wcstombs(str, msg, 256);
+			str[255] = '\0';
+			throw runtime_error(str);
+		}
+
+		MessageBox(NULL, msg, L"Error", MB_OK);
+		PostQuitMessage(EXIT_FAILURE);
+	}
+}
+
+/**
+* Write a formatted message to the debugger output.
+*/
+void Log(const char* format, ...)
+{
+	char buffer[1024];
+
+	va_list args;
+	va_start(args, format);
+	vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+
+	OutputDebugStringA(buffer);
+}
+
+//--------------------------------------------------------------------------------------
+// Parallel Helpers
+//--------------------------------------------------------------------------------------
+
+// Set on threads of a pool that already occupies every core, where ParallelFor runs its ranges serially
+static thread_local bool serialParallelFor = false;
+
+/**
+* Get the number of hardware threads available for CPU work.
+*/
+size_t GetWorkerCount()
+{
+	size_t count = static_cast<size_t>(thread::hardware_concurrency());
+	return (count > 0) ? count : 1;
+}
+
+/**
+* Split [0, count) into contiguous ranges of at least grainSize elements and run them across the available cores.
+* The calling thread processes the first range. Called from a LoadModels worker, the whole range runs on the calling thread.
+* An exception thrown by a range is rethrown on the calling thread once every range has finished.
+*/
+void ParallelFor(size_t count, size_t grainSize, const function<void(size_t, size_t)> &body)
+{
+	if (count == 0) return;
+
+	size_t workers = serialParallelFor ? 1 : GetWorkerCount();
+	size_t maxWorkers = (count + grainSize - 1) / max(grainSize, (size_t)1);
+	workers = min(workers, maxWorkers);
+	if (workers <= 1)
+	{
+		body(0, count);
+		return;
+	}
+
+	size_t rangeSize = (count + workers - 1) / workers;
+	size_t ranges = (count + rangeSize - 1) / rangeSize;
+	vector<exception_ptr> errors(ranges);
+	auto run = [&](size_t r)
+	{
+		try
+		{
+			body(r * rangeSize, min((r + 1) * rangeSize, count));
+		}
+		catch (...)
+		{
+			errors[r] = current_exception();
+		}
+	};
+
+	vector<thread> threads;
+	for (size_t r = 1; r < ranges; r++) threads.emplace_back(run, r);
+
+	run(0);
+	for (auto &t : threads) t.join();
+
+	for (const exception_ptr &error : errors)
+	{
+		if (error) rethrow_exception(error);
+	}
+}
+
+/**
+* Fold a value into an FNV-1a style hash.
+*/
+uint64_t HashCombine(uint64_t hash, uint64_t value)
+{
+	return (hash ^ value) * 1099511628211ull;
+}
+
+//--------------------------------------------------------------------------------------
+// File Reading
+//--------------------------------------------------------------------------------------
+
+vector<char> ReadFile(const string &filename) 
+{
+	ifstream file(filename, ios::ate | ios::binary);
+
+	if (!file.is_open()) 
+	{
+		throw std::runtime_error("Error: failed to open file!");
+	}
+
+	size_t fileSize = (size_t)file.tellg();
+	std::vector<char> buffer(fileSize);
+
+	file.seekg(0);
+	file.read(buffer.data(), fileSize);
+	file.close();
+
+	return buffer;
+}
+
+/**
+* Map a file into memory for reading.
+*/
+void MapFile(const string &filename, MappedFile &file)
+{
+	file.file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file.file == INVALID_HANDLE_VALUE)
+	{
+		throw std::runtime_error("Error: failed to open file!");
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file.file, &size) || size.QuadPart == 0)
+	{
+		UnmapFile(file);
+		throw std::runtime_error("Error: failed to map empty file!");
+	}
+	file.size = static_cast<size_t>(size.QuadPart);
+
+	file.mapping = CreateFileMappingA(file.file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (file.mapping != NULL)
+	{
+		file.data = static_cast<const UINT8*>(MapViewOfFile(file.mapping, FILE_MAP_READ, 0, 0, 0));
+	}
+
+	if (file.data == nullptr)
+	{
+		UnmapFile(file);
+		throw std::runtime_error("Error: failed to map file!");
+	}
+}
+
+/**
+* Release a mapped file.
+*/
+void UnmapFile(MappedFile &file)
+{
+	if (file.data) UnmapViewOfFile(file.data);
+	if (file.mapping) CloseHandle(file.mapping);
+	if (file.file != INVALID_HANDLE_VALUE) CloseHandle(file.file);
+	file = MappedFile();
+}
+
+/**
+* Name of a temporary file beside filepath, unique to this process and call, to write a file under before renaming it into place.
+*/
+string GetTemporaryPath(const string &filepath)
+{
+	static atomic<uint32_t> counter(0);
+
+	char suffix[48];
+	sprintf_s(suffix, ".%lu.%u.tmp", static_cast<unsigned long>(GetCurrentProcessId()), counter++);
+	return filepath + suffix;
+}
+
+/**
+* Get the lower case extension of a path, including the dot.
+*/
+string GetExtension(const string &filepath)
+{
+	size_t dot = filepath.find_last_of('.');
+	size_t slash = filepath.find_last_of("\\/");
+	if (dot == string::npos || (slash != string::npos && dot < slash)) return "";
+
+	string extension = filepath.substr(dot);
+	transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(tolower(c)); });
+	return extension;
+}
+
+//--------------------------------------------------------------------------------------
+// Model Loading
+//--------------------------------------------------------------------------------------
+
+/**
+* Load a model, choosing the loader from the file extension.
+*/
+void LoadModel(string filepath, Model &model, Material &material)
+{
+	string extension = GetExtension(filepath);
+	if (extension == ".glb")
+	{
+		LoadGLB(filepath, model, material);
+	}
+	else if (extension == ".ply")
+	{
+		LoadPLY(filepath, model, material);
+	}
+	else if (extension == ".scene" || extension == ".sceneb")
+	{
+		LoadScene(filepath, model, material);
+	}
+	else
+	{
+		LoadOBJ(filepath, model, material);
+	}
+}
+
+/**
+* Read a scene manifest, one model path per line relative to the manifest. Lines starting with # are comments.
+*/
+static void ReadManifest(const string &filepath, vector<string> &paths)
+{
+	ifstream file(filepath);
+	if (!file.is_open())
+	{
+		throw runtime_error("Error: failed to open manifest!");
+	}
+
+	string directory = filepath.substr(0, filepath.find_last_of("\\/") + 1);
+	string line;
+	while (getline(file, line))
+	{
+		size_t first = line.find_first_not_of(" \t\r");
+		if (first == string::npos || line[first] == '#') continue;
+		size_t last = line.find_last_not_of(" \t\r");
+		string path = line.substr(first, last - first + 1);
+
+		// Absolute paths are used as is
+		bool absolute = (path[0] == '\\' || path[0] == '/' || (path.size() > 1 && path[1] == ':'));
+		paths.push_back(absolute ? path : directory + path);
+	}
+}
+
+/**
+* Append one loaded asset to the scene model as its own meshes and instances.
+*/
+static void AppendModel(Model &scene, const Model &asset)
+{
+	scene.spheres.insert(scene.spheres.end(), asset.spheres.begin(), asset.spheres.end());
+	scene.lights.insert(scene.lights.end(), asset.lights.begin(), asset.lights.end());
+	scene.cameraPath.insert(scene.cameraPath.end(), asset.cameraPath.begin(), asset.cameraPath.end());
+
+	const size_t baseVertex = scene.positions.size();
+	const size_t baseIndex = scene.indices.size();
+	const uint32_t baseMesh = static_cast<uint32_t>(scene.meshes.size());
+
+	scene.positions.insert(scene.positions.end(), asset.positions.begin(), asset.positions.end());
+	scene.attributes.insert(scene.attributes.end(), asset.attributes.begin(), asset.attributes.end());
+	scene.indices.resize(baseIndex + asset.indices.size());
+	for (size_t i = 0; i < asset.indices.size(); i++)
+	{
+		scene.indices[baseIndex + i] = static_cast<uint32_t>(asset.indices[i] + baseVertex);
+	}
+
+	// Loaders that don't produce meshes load a single mesh
+	if (asset.meshes.empty())
+	{
+		Mesh mesh = {};
+		mesh.firstIndex = baseIndex;
+		mesh.indexCount = asset.indices.size();
+		scene.meshes.push_back(mesh);
+	}
+
+	for (Mesh mesh : asset.meshes)
+	{
+		mesh.firstIndex += baseIndex;
+		scene.meshes.push_back(mesh);
+	}
+
+	// Loaders that don't produce instances place each mesh once at the origin
+	if (asset.instances.empty())
+	{
+		for (size_t m = baseMesh; m < scene.meshes.size(); m++)
+		{
+			MeshInstance instance = {};
+			instance.mesh = static_cast<uint32_t>(m);
+			XMStoreFloat4x4(&instance.transform, XMMatrixIdentity());
+			scene.instances.push_back(instance);
+		}
+		return;
+	}
+
+	for (MeshInstance instance : asset.instances)
+	{
+		instance.mesh += baseMesh;
+		scene.instances.push_back(instance);
+	}
+}
+
+/**
+* Whether all of an asset's texture coordinates lie in [0, 1]. Repeating textures cannot be packed, their coordinates
+* would be clamped to the edges of their rectangle.
+*/
+static bool HasUnitTextureCoordinates(const Model &asset)
+{
+	const float tolerance = 1e-3f;
+	for (const VertexAttributes &attribute : asset.attributes)
+	{
+		if (attribute.color.x != 2) continue;
+		if (attribute.color.y < -tolerance || attribute.color.y > 1.f + tolerance || attribute.color.z < -tolerance || attribute.color.z > 1.f + tolerance) return false;
+	}
+	return true;
+}
+
+/**
+* Decode the textures of several assets' materials and pack them into one atlas, set on the bound material. Each asset
+* gets the rectangle of the atlas its texture coordinates map into, zero for assets without a texture, whose texture
+* is block compressed, or whose texture repeats, none of which can be packed.
+*/
+static void PackMaterialTextures(const vector<Model> &assets, const vector<Material> &materials, Material &material, vector<XMFLOAT4> &rects)
+{
+	vector<size_t> textured;
+	for (size_t a = 0; a < materials.size(); a++)
+	{
+		if (!materials[a].HasTexture()) continue;
+		if (!HasUnitTextureCoordinates(assets[a]))
+		{
+			Log("Texture atlas: %s repeats its texture, left out of the atlas\n", materials[a].texturePath.c_str());
+			continue;
+		}
+		textured.push_back(a);
+	}
+	if (textured.size() < 2) return;
+
+	vector<TextureInfo> textures(textured.size());
+	vector<exception_ptr> errors(textured.size());
+	ParallelFor(textured.size(), 1, [&](size_t first, size_t last)
+	{
+		for (size_t t = first; t < last; t++)
+		{
+			try
+			{
+				const Material &source = materials[textured[t]];
+				TextureInfo &texture = textures[t];
+				texture = source.textureData.empty() ? Textures::LoadTexture(source.texturePath) : Textures::LoadTexture(source.textureData);
+
+				// DDS files may carry mips, only the top level is packed
+				if (texture.format != DXGI_FORMAT_R8G8B8A8_UNORM) continue;
+				texture.pixels.resize(TextureCompression::GetMipOffset(texture, 1));
+				texture.mipLevels = 1;
+
+				if (source.textureTargetResolution > 0 && source.textureTargetResolution < texture.width)
+				{
+					Textures::ResampleTexture(texture, source.textureTargetResolution, max(1, texture.height * source.textureTargetResolution / texture.width));
+				}
+			}
+			catch (...)
+			{
+				errors[t] = current_exception();
+			}
+		}
+	});
+	for (const exception_ptr &error : errors)
+	{
+		if (error) rethrow_exception(error);
+	}
+
+	vector<TextureInfo> packed;
+	vector<size_t> packedAssets;
+	for (size_t t = 0; t < textured.size(); t++)
+	{
+		if (textures[t].format != DXGI_FORMAT_R8G8B8A8_UNORM) continue;
+		packed.push_back(move(textures[t]));
+		packedAssets.push_back(textured[t]);
+	}
+	if (packed.size() < 2) return;
+
+	vector<XMFLOAT4> packedRects;
+	material.textureAtlas = Textures::BuildTextureAtlas(packed, Textures::AtlasPadding, packedRects);
+	material.name = "atlas";
+	material.texturePath = "";
+	material.textureData.clear();
+	material.textureTargetResolution = 0;
+	for (size_t p = 0; p < packedAssets.size(); p++) rects[packedAssets[p]] = packedRects[p];
+}
+
+/**
+* Load several models, or the models listed in .manifest files, into one scene.
+* Each asset is loaded into its own model on a pool of worker threads, then appended as separate meshes.
+* A single albedo texture is bound, so textured vertices of assets other than the first textured one are shaded flat.
+*/
+void LoadModels(const vector<string> &filepaths, Model &model, Material &material)
+{
+	HighResolutionClock clock;
+
+	vector<string> paths;
+	for (const string &filepath : filepaths)
+	{
+		if (GetExtension(filepath) == ".manifest") ReadManifest(filepath, paths);
+		else paths.push_back(filepath);
+	}
+
+	if (paths.empty())
+	{
+		throw runtime_error("Error: no models to load!");
+	}
+
+	vector<Model> assets(paths.size());
+	vector<Material> materials(paths.size());
+	vector<double> times(paths.size(), 0.0);
+	vector<exception_ptr> errors(paths.size());
+
+	// Workers take the next unloaded asset until none are left. With several workers the pool already fills the cores,
+	// so the loaders' inner loops run serially rather than spawning threads of their own.
+	atomic<size_t> next(0);
+	size_t workers = min(GetWorkerCount(), paths.size());
+	auto worker = [&]()
+	{
+		bool serial = serialParallelFor;
+		serialParallelFor = (workers > 1);
+		for (size_t a = next++; a < paths.size(); a = next++)
+		{
+			HighResolutionClock assetClock;
+			try
+			{
+				LoadModel(paths[a], assets[a], materials[a]);
+			}
+			catch (...)
+			{
+				errors[a] = current_exception();
+			}
+			assetClock.Tick();
+			times[a] = assetClock.GetDeltaMilliseconds();
+		}
+		serialParallelFor = serial;
+	};
+
+	vector<thread> threads;
+	for (size_t w = 1; w < workers; w++) threads.emplace_back(worker);
+	worker();
+	for (auto &t : threads) t.join();
+
+	double totalTime = 0;
+	for (size_t a = 0; a < paths.size(); a++)
+	{
+		if (errors[a]) rethrow_exception(errors[a]);
+		Log("Asset %s: %zu vertices, %zu triangles in %.2f ms\n", paths[a].c_str(), assets[a].positions.size(), assets[a].indices.size() / 3, times[a]);
+		totalTime += times[a];
+	}
+
+	// Bind the texture of the first textured asset, or an atlas of every textured asset's texture when there are several
+	int textured = -1;
+	vector<XMFLOAT4> atlasRects(paths.size(), XMFLOAT4(0.f, 0.f, 0.f, 0.f));
+	for (size_t a = 0; a < paths.size() && textured < 0; a++)
+	{
+		if (materials[a].HasTexture()) textured = static_cast<int>(a);
+	}
+	material = materials[textured >= 0 ? textured : 0];
+	if (textured >= 0) PackMaterialTextures(assets, materials, material, atlasRects);
+
+	for (size_t a = 0; a < paths.size(); a++)
+	{
+		if (atlasRects[a].z > 0)
+		{
+			// Move the asset's texture coordinates into its rectangle of the atlas
+			const XMFLOAT4 &rect = atlasRects[a];
+			for (VertexAttributes &attribute : assets[a].attributes)
+			{
+				if (attribute.color.x != 2) continue;
+				attribute.color.y = rect.x + min(max(attribute.color.y, 0.f), 1.f) * rect.z;
+				attribute.color.z = rect.y + min(max(attribute.color.z, 0.f), 1.f) * rect.w;
+			}
+		}
+		else if (textured >= 0 && static_cast<int>(a) != textured)
+		{
+			// Texture coordinates would sample another asset's texture
+			for (VertexAttributes &attribute : assets[a].attributes)
+			{
+				if (attribute.color.x == 2) attribute.color = XMFLOAT3(0.8f, 0.8f, 0.8f);
+			}
+		}
+		AppendModel(model, assets[a]);
+		assets[a] = Model();
+	}
+
+	clock.Tick();
+	Log("Loaded %zu assets in %.2f ms (%.2f ms summed across assets)\n", paths.size(), clock.GetDeltaMilliseconds(), totalTime);
+}
+
+void LoadOBJ(string filepath, Model &model, Material &material) 
+{
+	tinyobj::attrib_t attrib;
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+	std::string err;
+
+	// Load the OBJ and MTL files
+	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &err, filepath.c_str(), "materials\\")) 
+	{
+		throw std::runtime_error(err);
+	}
+
+	// Get the first material
+	// Only support a single material right now
+	if (materials.size() > 0) {
+		material.name = materials[0].name;
+		material.texturePath = materials[0].diffuse_texname;
+		material.textureTargetResolution = materials[0].diffuse_texopt.texture_resolution;
+	}
+	else {
+		material.name = "defaultMaterial";
+		material.texturePath = "";
+	}
+
+	// Parse the model and store the unique vertices, each shape as its own mesh
+	unordered_map<Vertex, uint32_t> uniqueVertices = {};
+	for (const auto &shape : shapes) 
+	{
+		Mesh mesh = {};
+		mesh.firstIndex = model.indices.size();
+
+		for (const auto &index : shape.mesh.indices) 
+		{
+			Vertex vertex = {
+				XMFLOAT3(//Position
+					attrib.vertices[3 * index.vertex_index + 2],
+					attrib.vertices[3 * index.vertex_index + 1],
+					attrib.vertices[3 * index.vertex_index + 0]),
+				XMFLOAT3(//Color
+					2,
+					1.f - attrib.texcoords[2 * index.texcoord_index + 0],
+					attrib.texcoords[2 * index.texcoord_index + 1]),
+				index.normal_index >= 0 ?
+				XMFLOAT3(//Normal
+					attrib.normals[3 * index.normal_index + 2],
+					attrib.normals[3 * index.normal_index + 1],
+					attrib.normals[3 * index.normal_index + 0]
+				)
+				: XMFLOAT3(0,0,1),
+				XMFLOAT3(1, 1, 0)//Material
+			};
+
+			// Fast find unique vertices using a hash
+			if (uniqueVertices.count(vertex) == 0) 
+			{
+				uniqueVertices[vertex] = model.AddVertex(vertex);
+			}
+
+			model.indices.push_back(uniqueVertices[vertex]);
+		}
+
+		mesh.indexCount = model.indices.size() - mesh.firstIndex;
+		if (mesh.indexCount > 0) model.meshes.push_back(mesh);
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// glTF Loading
+//--------------------------------------------------------------------------------------
+
+enum JsonType { JSON_NULL, JSON_BOOL, JSON_NUMBER, JSON_STRING, JSON_ARRAY, JSON_OBJECT };
+
+/**
+* A parsed JSON value, just enough to walk a glTF scene description.
+*/
+struct JsonValue
+{
+	JsonType			type = JSON_NULL;
+	double				number = 0;
+	string				text;
+	vector<string>		keys;			// object member names, parallel to items
+	vector<JsonValue>	items;			// array elements or object member values
+
+	const JsonValue* Find(const char* key) const
+	{
+		for (size_t i = 0; i < keys.size(); i++)
+		{
+			if (keys[i] == key) return &items[i];
+		}
+		return nullptr;
+	}
+
+	double GetNumber(const char* key, double fallback) const
+	{
+		const JsonValue* value = Find(key);
+		return (value && value->type == JSON_NUMBER) ? value->number : fallback;
+	}
+
+	int GetInt(const char* key, int fallback) const
+	{
+		return static_cast<int>(GetNumber(key, fallback));
+	}
+
+	size_t Size() const { return items.size(); }
+	const JsonValue& operator[](size_t index) const { return items[index]; }
+};
+
+static void SkipWhitespace(const char* &p)
+{
+	while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') p++;
+}
+
+static void ExpectCharacter(const char* &p, char c)
+{
+	SkipWhitespace(p);
+	if (*p != c)
+	{
+		throw runtime_error("Error: invalid glTF JSON!");
+	}
+	p++;
+}
+
+/**
+* Parse a JSON value from a null terminated string.
+*/
+static void ParseJson(const char* &p, JsonValue &value, int depth = 0)
+{
+	if (depth > 64)
+	{
+		throw runtime_error("Error: glTF JSON is nested too deeply!");
+	}
+
+	SkipWhitespace(p);
+	if (*p == '{' || *p == '[')
+	{
+		bool object = (*p == '{');
+		char close = object ? '}' : ']';
+		value.type = object ? JSON_OBJECT : JSON_ARRAY;
+		p++;
+
+		SkipWhitespace(p);
+		if (*p == close)
+		{
+			p++;
+			return;
+		}
+
+		while (true)
+		{
+			if (object)
+			{
+				JsonValue key;
+				SkipWhitespace(p);
+				if (*p != '"') throw runtime_error("Error: invalid glTF JSON object key!");
+				ParseJson(p, key, depth + 1);
+				ExpectCharacter(p, ':');
+				value.keys.push_back(key.text);
+			}
+
+			value.items.emplace_back();
+			ParseJson(p, value.items.back(), depth + 1);
+
+			SkipWhitespace(p);
+			if (*p == ',')
+			{
+				p++;
+				continue;
+			}
+			ExpectCharacter(p, close);
+			return;
+		}
+	}
+
+	if (*p == '"')
+	{
+		value.type = JSON_STRING;
+		p++;
+		while (*p != '"')
+		{
+			if (*p == 0) throw runtime_error("Error: unterminated glTF JSON string!");
+			if (*p != '\\')
+			{
+				value.text += *p++;
+				continue;
+			}
+
+			p++;
+			switch (*p)
+			{
+			case 'b': value.text += '\b'; break;
+			case 'f': value.text += '\f'; break;
+			case 'n': value.text += '\n'; break;
+			case 'r': value.text += '\r'; break;
+			case 't': value.text += '\t'; break;
+			case 'u':
+			{
+				// Encode the code unit as UTF-8, names and URIs are the only strings we read
+				unsigned int code = 0;
+				for (int i = 0; i < 4; i++)
+				{
+					char h = *++p;
+					code <<= 4;
+					if (h >= '0' && h <= '9') code |= (h - '0');
+					else if (h >= 'a' && h <= 'f') code |= (h - 'a' + 10);
+					else if (h >= 'A' && h <= 'F') code |= (h - 'A' + 10);
+					else throw runtime_error("Error: invalid glTF JSON escape!");
+				}
+				if (code < 0x80) value.text += static_cast<char>(code);
+				else if (code < 0x800)
+				{
+					value.text += static_cast<char>(0xC0 | (code >> 6));
+					value.text += static_cast<char>(0x80 | (code & 0x3F));
+				}
+				else
+				{
+					value.text += static_cast<char>(0xE0 | (code >> 12));
+					value.text += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+					value.text += static_cast<char>(0x80 | (code & 0x3F));
+				}
+				break;
+			}
+			case 0: throw runtime_error("Error: unterminated glTF JSON string!");
+			default: value.text += *p; break;
+			}
+			p++;
+		}
+		p++;
+		return;
+	}
+
+	if (strncmp(p, "true", 4) == 0 || strncmp(p, "false", 5) == 0)
+	{
+		value.type = JSON_BOOL;
+		value.number = (*p == 't') ? 1 : 0;
+		p += (*p == 't') ? 4 : 5;
+		return;
+	}
+
+	if (strncmp(p, "null", 4) == 0)
+	{
+		value.type = JSON_NULL;
+		p += 4;
+		return;
+	}
+
+	char* end = nullptr;
+	value.type = JSON_NUMBER;
+	value.number = strtod(p, &end);
+	if (end == p)
+	{
+		throw runtime_error("Error: invalid glTF JSON value!");
+	}
+	p = end;
+}
+
+/**
+* A strided range of glTF accessor elements, pointing straight into the mapped binary data.
+*/
+struct GltfAccessor
+{
+	const UINT8*	data;
+	size_t			count;
+	size_t			stride;
+	int				componentType;
+	int				components;
+};
+
+/**
+* Resolve an accessor to its buffer range, validating it against the buffer bounds.
+*/
+static GltfAccessor GetAccessor(const JsonValue &gltf, const vector<pair<const UINT8*, size_t>> &buffers, int index)
+{
+	const JsonValue* accessors = gltf.Find("accessors");
+	const JsonValue* bufferViews = gltf.Find("bufferViews");
+	if (!accessors || !bufferViews || index < 0 || index >= static_cast<int>(accessors->Size()))
+	{
+		throw runtime_error("Error: invalid glTF accessor!");
+	}
+
+	const JsonValue &accessor = (*accessors)[index];
+	if (accessor.Find("sparse") || !accessor.Find("bufferView"))
+	{
+		throw runtime_error("Error: sparse and zero filled glTF accessors are not supported!");
+	}
+
+	GltfAccessor result = {};
+	result.count = static_cast<size_t>(accessor.GetNumber("count", 0));
+	result.componentType = accessor.GetInt("componentType", 0);
+
+	const JsonValue* type = accessor.Find("type");
+	string typeName = type ? type->text : "";
+	if (typeName == "SCALAR") result.components = 1;
+	else if (typeName == "VEC2") result.components = 2;
+	else if (typeName == "VEC3") result.components = 3;
+	else if (typeName == "VEC4") result.components = 4;
+	else throw runtime_error("Error: unsupported glTF accessor type!");
+
+	size_t componentSize = 0;
+	switch (result.componentType)
+	{
+	case 5120: case 5121: componentSize = 1; break;		// BYTE, UNSIGNED_BYTE
+	case 5122: case 5123: componentSize = 2; break;		// SHORT, UNSIGNED_SHORT
+	case 5125: case 5126: componentSize = 4; break;		// UNSIGNED_INT, FLOAT
+	default: throw runtime_error("Error: unsupported glTF component type!");
+	}
+
+	int viewIndex = accessor.GetInt("bufferView", -1);
+	if (viewIndex < 0 || viewIndex >= static_cast<int>(bufferViews->Size()))
+	{
+		throw runtime_error("Error: invalid glTF buffer view!");
+	}
+
+	const JsonValue &view = (*bufferViews)[viewIndex];
+	int bufferIndex = view.GetInt("buffer", -1);
+	if (bufferIndex < 0 || bufferIndex >= static_cast<int>(buffers.size()) || buffers[bufferIndex].first == nullptr)
+	{
+		throw runtime_error("Error: invalid glTF buffer!");
+	}
+
+	size_t elementSize = componentSize * result.components;
+	size_t viewOffset = static_cast<size_t>(view.GetNumber("byteOffset", 0));
+	size_t viewLength = static_cast<size_t>(view.GetNumber("byteLength", 0));
+	size_t accessorOffset = static_cast<size_t>(accessor.GetNumber("byteOffset", 0));
+	result.stride = static_cast<size_t>(view.GetNumber("byteStride", 0));
+	if (result.stride == 0) result.stride = elementSize;
+
+	// The last element has to end inside both the view and the buffer
+	size_t end = accessorOffset + (result.count > 0 ? (result.count - 1) * result.stride + elementSize : 0);
+	if (end > viewLength || viewOffset + viewLength > buffers[bufferIndex].second)
+	{
+		throw runtime_error("Error: glTF accessor is out of bounds!");
+	}
+
+	result.data = buffers[bufferIndex].first + viewOffset + accessorOffset;
+	return result;
+}
+
+/**
+* Walk a node and its children, adding an instance for every node that references a loaded mesh.
+*/
+static void AddNodeInstances(const JsonValue &gltf, int nodeIndex, FXMMATRIX parent, const vector<int> &meshMap, Model &model, int depth)
+{
+	const JsonValue* nodes = gltf.Find("nodes");
+	if (!nodes || nodeIndex < 0 || nodeIndex >= static_cast<int>(nodes->Size()) || depth > 64)
+	{
+		throw runtime_error("Error: invalid glTF node hierarchy!");
+	}
+
+	const JsonValue &node = (*nodes)[nodeIndex];
+
+	// Node transforms are column major, which loads as the row vector form
+	XMMATRIX local = XMMatrixIdentity();
+	const JsonValue* matrix = node.Find("matrix");
+	if (matrix && matrix->Size() == 16)
+	{
+		XMFLOAT4X4 values;
+		for (int i = 0; i < 16; i++) values.m[i / 4][i % 4] = static_cast<float>((*matrix)[i].number);
+		local = XMLoadFloat4x4(&values);
+	}
+	else
+	{
+		const JsonValue* t = node.Find("translation");
+		const JsonValue* r = node.Find("rotation");
+		const JsonValue* s = node.Find("scale");
+
+		XMMATRIX scale = (s && s->Size() == 3) ? XMMatrixScaling((float)(*s)[0].number, (float)(*s)[1].number, (float)(*s)[2].number) : XMMatrixIdentity();
+		XMMATRIX rotation = (r && r->Size() == 4) ? XMMatrixRotationQuaternion(XMVectorSet((float)(*r)[0].number, (float)(*r)[1].number, (float)(*r)[2].number, (float)(*r)[3].number)) : XMMatrixIdentity();
+		XMMATRIX translation = (t && t->Size() == 3) ? XMMatrixTranslation((float)(*t)[0].number, (float)(*t)[1].number, (float)(*t)[2].number) : XMMatrixIdentity();
+		local = scale * rotation * translation;
+	}
+
+	XMMATRIX world = local * parent;
+
+	int mesh = node.GetInt("mesh", -1);
+	if (mesh >= 0 && mesh < static_cast<int>(meshMap.size()) && meshMap[mesh] >= 0)
+	{
+		// Swap x and z to match the axis convention of the OBJ loader
+		const XMMATRIX swapXZ(0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1);
+
+		MeshInstance instance = {};
+		instance.mesh = static_cast<uint32_t>(meshMap[mesh]);
+		XMStoreFloat4x4(&instance.transform, swapXZ * world * swapXZ);
+		model.instances.push_back(instance);
+	}
+
+	const JsonValue* children = node.Find("children");
+	if (children)
+	{
+		for (size_t c = 0; c < children->Size(); c++)
+		{
+			AddNodeInstances(gltf, static_cast<int>((*children)[c].number), world, meshMap, model, depth + 1);
+		}
+	}
+}
+
+/**
+* Load a binary glTF 2.0 (GLB) file.
+* The file is mapped and accessor ranges are decoded straight into the model's position, attribute, and index streams.
+* Each glTF mesh becomes a model mesh, nodes become instances, and materials are written to the per-vertex color and material attributes.
+* The renderer binds a single albedo texture, taken from the first textured material.
+*/
+void LoadGLB(string filepath, Model &model, Material &material)
+{
+	HighResolutionClock clock;
+
+	MappedFile file;
+	MapFile(filepath, file);
+
+	vector<MappedFile> externalFiles;
+	try
+	{
+		// Read the header and the JSON chunk
+		const uint32_t* header = reinterpret_cast<const uint32_t*>(file.data);
+		if (file.size < 20 || header[0] != 0x46546C67 || header[1] != 2 || header[2] > file.size)
+		{
+			throw runtime_error("Error: not a glTF 2.0 binary file!");
+		}
+
+		const size_t fileLength = header[2];
+		const uint32_t jsonLength = header[3];
+		if (header[4] != 0x4E4F534A || 20 + static_cast<size_t>(jsonLength) > fileLength)
+		{
+			throw runtime_error("Error: invalid GLB JSON chunk!");
+		}
+
+		string json(reinterpret_cast<const char*>(file.data + 20), jsonLength);
+		JsonValue gltf;
+		const char* cursor = json.c_str();
+		ParseJson(cursor, gltf);
+
+		// The optional binary chunk follows the JSON chunk
+		pair<const UINT8*, size_t> binaryChunk(nullptr, 0);
+		size_t binaryOffset = 20 + ALIGN(4, static_cast<size_t>(jsonLength));
+		if (binaryOffset + 8 <= fileLength)
+		{
+			const uint32_t* chunkHeader = reinterpret_cast<const uint32_t*>(file.data + binaryOffset);
+			if (chunkHeader[1] == 0x004E4942 && binaryOffset + 8 + chunkHeader[0] <= fileLength)
+			{
+				binaryChunk = make_pair(file.data + binaryOffset + 8, static_cast<size_t>(chunkHeader[0]));
+			}
+		}
+
+		// Resolve the buffers, external buffers are mapped from next to the GLB
+		string directory = filepath.substr(0, filepath.find_last_of("\\/") + 1);
+		vector<pair<const UINT8*, size_t>> buffers;
+		const JsonValue* bufferList = gltf.Find("buffers");
+		for (size_t b = 0; bufferList && b < bufferList->Size(); b++)
+		{
+			const JsonValue* uri = (*bufferList)[b].Find("uri");
+			if (!uri)
+			{
+				buffers.push_back(binaryChunk);
+			}
+			else if (uri->text.compare(0, 5, "data:") == 0)
+			{
+				buffers.push_back(make_pair(nullptr, 0));
+			}
+			else
+			{
+				externalFiles.emplace_back();
+				MapFile(directory + uri->text, externalFiles.back());
+				buffers.push_back(make_pair(externalFiles.back().data, externalFiles.back().size));
+			}
+		}
+
+		// Find the material that supplies the texture
+		const JsonValue* materials = gltf.Find("materials");
+		const JsonValue* textures = gltf.Find("textures");
+		const JsonValue* images = gltf.Find("images");
+		const JsonValue* bufferViews = gltf.Find("bufferViews");
+		int texturedMaterial = -1;
+
+		material.name = "defaultMaterial";
+		material.texturePath = "";
+		material.textureData.clear();
+
+		for (size_t m = 0; materials && textures && images && m < materials->Size() && texturedMaterial < 0; m++)
+		{
+			const JsonValue* pbr = (*materials)[m].Find("pbrMetallicRoughness");
+			const JsonValue* baseColorTexture = pbr ? pbr->Find("baseColorTexture") : nullptr;
+			if (!baseColorTexture) continue;
+
+			int textureIndex = baseColorTexture->GetInt("index", -1);
+			if (textureIndex < 0 || textureIndex >= static_cast<int>(textures->Size())) continue;
+
+			int imageIndex = (*textures)[textureIndex].GetInt("source", -1);
+			if (imageIndex < 0 || imageIndex >= static_cast<int>(images->Size())) continue;
+
+			const JsonValue &image = (*images)[imageIndex];
+			const JsonValue* uri = image.Find("uri");
+			int viewIndex = image.GetInt("bufferView", -1);
+
+			if (uri && uri->text.compare(0, 5, "data:") != 0)
+			{
+				material.texturePath = directory + uri->text;
+			}
+			else if (viewIndex >= 0 && bufferViews && viewIndex < static_cast<int>(bufferViews->Size()))
+			{
+				// Embedded images are copied, the mapping is released once the model is loaded
+				const JsonValue &view = (*bufferViews)[viewIndex];
+				int bufferIndex = view.GetInt("buffer", -1);
+				size_t offset = static_cast<size_t>(view.GetNumber("byteOffset", 0));
+				size_t length = static_cast<size_t>(view.GetNumber("byteLength", 0));
+				if (bufferIndex < 0 || bufferIndex >= static_cast<int>(buffers.size()) || !buffers[bufferIndex].first || offset + length > buffers[bufferIndex].second) continue;
+
+				const UINT8* imageData = buffers[bufferIndex].first + offset;
+				material.textureData.assign(imageData, imageData + length);
+			}
+			else continue;
+
+			texturedMaterial = static_cast<int>(m);
+			const JsonValue* name = (*materials)[m].Find("name");
+			material.name = name ? name->text : "defaultMaterial";
+		}
+
+		// Decode the mesh primitives into the model streams
+		const JsonValue* meshes = gltf.Find("meshes");
+		vector<int> meshMap(meshes ? meshes->Size() : 0, -1);
+
+		for (size_t m = 0; meshes && m < meshes->Size(); m++)
+		{
+			const JsonValue* primitives = (*meshes)[m].Find("primitives");
+			Mesh mesh = {};
+			mesh.firstIndex = model.indices.size();
+
+			for (size_t p = 0; primitives && p < primitives->Size(); p++)
+			{
+				const JsonValue &primitive = (*primitives)[p];
+				const JsonValue* attributes = primitive.Find("attributes");
+				if (primitive.GetInt("mode", 4) != 4 || !attributes || !attributes->Find("POSITION")) continue;
+
+				GltfAccessor positions = GetAccessor(gltf, buffers, attributes->GetInt("POSITION", -1));
+				if (positions.componentType != 5126 || positions.components != 3)
+				{
+					throw runtime_error("Error: glTF positions must be float3!");
+				}
+
+				GltfAccessor normals = {};
+				if (attributes->Find("NORMAL"))
+				{
+					normals = GetAccessor(gltf, buffers, attributes->GetInt("NORMAL", -1));
+					if (normals.componentType != 5126 || normals.components != 3 || normals.count != positions.count) normals.data = nullptr;
+				}
+
+				// Look up the primitive's material
+				int materialIndex = primitive.GetInt("material", -1);
+				XMFLOAT3 baseColor(1.f, 1.f, 1.f);
+				float reflection = 0.f;
+				if (materials && materialIndex >= 0 && materialIndex < static_cast<int>(materials->Size()))
+				{
+					const JsonValue* pbr = (*materials)[materialIndex].Find("pbrMetallicRoughness");
+					const JsonValue* factor = pbr ? pbr->Find("baseColorFactor") : nullptr;
+					if (factor && factor->Size() >= 3)
+					{
+						baseColor = XMFLOAT3((float)(*factor)[0].number, (float)(*factor)[1].number, (float)(*factor)[2].number);
+					}
+					if (pbr)
+					{
+						// Smooth metals reflect
+						reflection = (float)(pbr->GetNumber("metallicFactor", 1.0) * (1.0 - pbr->GetNumber("roughnessFactor", 1.0)));
+					}
+				}
+
+				GltfAccessor texcoords = {};
+				if (materialIndex == texturedMaterial && texturedMaterial >= 0 && attributes->Find("TEXCOORD_0"))
+				{
+					texcoords = GetAccessor(gltf, buffers, attributes->GetInt("TEXCOORD_0", -1));
+					if (texcoords.componentType != 5126 || texcoords.components != 2 || texcoords.count != positions.count) texcoords.data = nullptr;
+				}
+
+				// Write the vertex streams, swapping x and z to match the OBJ loader
+				const size_t baseVertex = model.positions.size();
+				model.positions.resize(baseVertex + positions.count);
+				model.attributes.resize(baseVertex + positions.count);
+
+				ParallelFor(positions.count, 16384, [&](size_t first, size_t last)
+				{
+					for (size_t v = first; v < last; v++)
+					{
+						const float* position = reinterpret_cast<const float*>(positions.data + v * positions.stride);
+						model.positions[baseVertex + v] = XMFLOAT3(position[2], position[1], position[0]);
+
+						VertexAttributes &attribute = model.attributes[baseVertex + v];
+						if (normals.data)
+						{
+							const float* normal = reinterpret_cast<const float*>(normals.data + v * normals.stride);
+							attribute.normal = XMFLOAT3(normal[2], normal[1], normal[0]);
+						}
+						else
+						{
+							attribute.normal = XMFLOAT3(0, 0, 1);
+						}
+
+						if (texcoords.data)
+						{
+							// glTF texture coordinates start at the top left, the texture is stored flipped on both axes
+							const float* uv = reinterpret_cast<const float*>(texcoords.data + v * texcoords.stride);
+							attribute.color = XMFLOAT3(2, 1.f - uv[0], 1.f - uv[1]);
+						}
+						else
+						{
+							attribute.color = baseColor;
+						}
+						attribute.material = XMFLOAT3(1, 1, reflection);
+					}
+				});
+
+				// Write the index stream
+				const size_t firstIndex = model.indices.size();
+				if (primitive.Find("indices"))
+				{
+					GltfAccessor indices = GetAccessor(gltf, buffers, primitive.GetInt("indices", -1));
+					if (indices.components != 1 || (indices.componentType != 5121 && indices.componentType != 5123 && indices.componentType != 5125))
+					{
+						throw runtime_error("Error: invalid glTF index accessor!");
+					}
+
+					size_t count = indices.count - (indices.count % 3);
+					model.indices.resize(firstIndex + count);
+					for (size_t i = 0; i < count; i++)
+					{
+						const UINT8* element = indices.data + i * indices.stride;
+						uint32_t index;
+						if (indices.componentType == 5125) index = *reinterpret_cast<const uint32_t*>(element);
+						else if (indices.componentType == 5123) index = *reinterpret_cast<const uint16_t*>(element);
+						else index = *element;
+
+						if (index >= positions.count)
+						{
+							throw runtime_error("Error: glTF index is out of range!");
+						}
+						model.indices[firstIndex + i] = static_cast<uint32_t>(baseVertex + index);
+					}
+				}
+				else
+				{
+					size_t count = positions.count - (positions.count % 3);
+					model.indices.resize(firstIndex + count);
+					for (size_t i = 0; i < count; i++) model.indices[firstIndex + i] = static_cast<uint32_t>(baseVertex + i);
+				}
+			}
+
+			mesh.indexCount = model.indices.size() - mesh.firstIndex;
+			if (mesh.indexCount > 0)
+			{
+				meshMap[m] = static_cast<int>(model.meshes.size());
+				model.meshes.push_back(mesh);
+			}
+		}
+
+		// Instance the meshes through the default scene's node hierarchy
+		const JsonValue* scenes = gltf.Find("scenes");
+		int sceneIndex = gltf.GetInt("scene", 0);
+		if (scenes && sceneIndex >= 0 && sceneIndex < static_cast<int>(scenes->Size()))
+		{
+			const JsonValue* roots = (*scenes)[sceneIndex].Find("nodes");
+			for (size_t n = 0; roots && n < roots->Size(); n++)
+			{
+				AddNodeInstances(gltf, static_cast<int>((*roots)[n].number), XMMatrixIdentity(), meshMap, model, 0);
+			}
+		}
+	}
+	catch (...)
+	{
+		for (MappedFile &external : externalFiles) UnmapFile(external);
+		UnmapFile(file);
+		throw;
+	}
+
+	for (MappedFile &external : externalFiles) UnmapFile(external);
+	UnmapFile(file);
+
+	clock.Tick();
+	Log("GLB: %zu meshes, %zu instances, %zu vertices, %zu triangles in %.2f ms\n",
+		model.meshes.size(), model.instances.size(), model.positions.size(), model.indices.size() / 3, clock.GetDeltaMilliseconds());
+}
+
+//--------------------------------------------------------------------------------------
+// PLY Loading
+//--------------------------------------------------------------------------------------
+
+enum PlyType { PLY_INVALID, PLY_INT8, PLY_UINT8, PLY_INT16, PLY_UINT16, PLY_INT32, PLY_UINT32, PLY_FLOAT32, PLY_FLOAT64 };
+
+struct PlyProperty
+{
+	string	name;
+	PlyType	type;
+	PlyType	countType;		// PLY_INVALID unless this is a list property
+	size_t	offset;			// byte offset within a fixed size element
+};
+
+struct PlyElement
+{
+	string				name;
+	size_t				count;
+	size_t				stride;		// 0 when the element contains list properties
+	vector<PlyProperty>	properties;
+
+	int Find(const char* propertyName) const
+	{
+		for (size_t i = 0; i < properties.size(); i++)
+		{
+			if (properties[i].name == propertyName) return static_cast<int>(i);
+		}
+		return -1;
+	}
+};
+
+static PlyType GetPlyType(const string &name)
+{
+	if (name == "char" || name == "int8") return PLY_INT8;
+	if (name == "uchar" || name == "uint8") return PLY_UINT8;
+	if (name == "short" || name == "int16") return PLY_INT16;
+	if (name == "ushort" || name == "uint16") return PLY_UINT16;
+	if (name == "int" || name == "int32") return PLY_INT32;
+	if (name == "uint" || name == "uint32") return PLY_UINT32;
+	if (name == "float" || name == "float32") return PLY_FLOAT32;
+	if (name == "double" || name == "float64") return PLY_FLOAT64;
+	throw runtime_error("Error: unknown PLY property type!");
+}
+
+static size_t GetPlyTypeSize(PlyType type)
+{
+	switch (type)
+	{
+	case PLY_INT8: case PLY_UINT8: return 1;
+	case PLY_INT16: case PLY_UINT16: return 2;
+	case PLY_INT32: case PLY_UINT32: case PLY_FLOAT32: return 4;
+	case PLY_FLOAT64: return 8;
+	default: return 0;
+	}
+}
+
+/**
+* Read a little endian PLY scalar. The data is unaligned, so values are copied out.
+*/
+static double ReadPlyValue(const UINT8* data, PlyType type)
+{
+	switch (type)
+	{
+	case PLY_INT8: return static_cast<int8_t>(*data);
+	case PLY_UINT8: return *data;
+	case PLY_INT16: { int16_t v; memcpy(&v, data, 2); return v; }
+	case PLY_UINT16: { uint16_t v; memcpy(&v, data, 2); return v; }
+	case PLY_INT32: { int32_t v; memcpy(&v, data, 4); return v; }
+	case PLY_UINT32: { uint32_t v; memcpy(&v, data, 4); return v; }
+	case PLY_FLOAT32: { float v; memcpy(&v, data, 4); return v; }
+	case PLY_FLOAT64: { double v; memcpy(&v, data, 8); return v; }
+	default: return 0;
+	}
+}
+
+static uint32_t ReadPlyIndex(const UINT8* data, PlyType type)
+{
+	uint32_t index;
+	switch (type)
+	{
+	case PLY_UINT8: case PLY_INT8: return *data;
+	case PLY_UINT16: case PLY_INT16: { uint16_t v; memcpy(&v, data, 2); return v; }
+	case PLY_UINT32: case PLY_INT32: memcpy(&index, data, 4); return index;
+	default: return 0;		// LoadPLY rejects index lists of other types before reading any
+	}
+}
+
+/**
+* Get the size in bytes of the element at data, walking its list properties.
+*/
+static size_t GetPlyElementSize(const PlyElement &element, const UINT8* data, const UINT8* end)
+{
+	if (element.stride > 0) return element.stride;
+
+	size_t size = 0;
+	for (const PlyProperty &property : element.properties)
+	{
+		if (property.countType == PLY_INVALID)
+		{
+			size += GetPlyTypeSize(property.type);
+			continue;
+		}
+
+		size_t countSize = GetPlyTypeSize(property.countType);
+		if (data + size + countSize > end)
+		{
+			throw runtime_error("Error: PLY file is truncated!");
+		}
+		size_t count = static_cast<size_t>(ReadPlyValue(data + size, property.countType));
+		size += countSize + count * GetPlyTypeSize(property.type);
+	}
+	return size;
+}
+
+/**
+* Load a binary little endian PLY file.
+* The file is mapped and the vertex and face blocks are converted straight into the model streams.
+* Triangle-only face blocks, the common case for scan data, are converted in parallel.
+*/
+void LoadPLY(string filepath, Model &model, Material &material)
+{
+	HighResolutionClock clock;
+
+	MappedFile file;
+	MapFile(filepath, file);
+
+	try
+	{
+		// Parse the text header
+		const char* text = reinterpret_cast<const char*>(file.data);
+		const char* textEnd = text + file.size;
+		if (file.size < 4 || strncmp(text, "ply", 3) != 0)
+		{
+			throw runtime_error("Error: not a PLY file!");
+		}
+
+		vector<PlyElement> elements;
+		bool binary = false;
+		const char* line = text;
+		const UINT8* body = nullptr;
+
+		while (line < textEnd)
+		{
+			const char* lineEnd = static_cast<const char*>(memchr(line, '\n', textEnd - line));
+			if (!lineEnd)
+			{
+				throw runtime_error("Error: PLY header is not terminated!");
+			}
+
+			stringstream tokens(string(line, lineEnd));
+			string keyword;
+			tokens >> keyword;
+			line = lineEnd + 1;
+
+			if (keyword == "format")
+			{
+				string format;
+				tokens >> format;
+				binary = (format == "binary_little_endian");
+			}
+			else if (keyword == "element")
+			{
+				PlyElement element = {};
+				tokens >> element.name >> element.count;
+				elements.push_back(element);
+			}
+			else if (keyword == "property")
+			{
+				if (elements.empty())
+				{
+					throw runtime_error("Error: PLY property outside of an element!");
+				}
+
+				PlyProperty property = {};
+				string type;
+				tokens >> type;
+				if (type == "list")
+				{
+					string countType;
+					tokens >> countType >> type;
+					property.countType = GetPlyType(countType);
+				}
+				property.type = GetPlyType(type);
+				tokens >> property.name;
+				elements.back().properties.push_back(property);
+			}
+			else if (keyword == "end_header")
+			{
+				body = reinterpret_cast<const UINT8*>(line);
+				break;
+			}
+		}
+
+		if (!body)
+		{
+			throw runtime_error("Error: PLY header is not terminated!");
+		}
+		if (!binary)
+		{
+			throw runtime_error("Error: only binary little endian PLY files are supported!");
+		}
+
+		// Lay out the fixed size elements
+		for (PlyElement &element : elements)
+		{
+			size_t offset = 0;
+			bool fixed = true;
+			for (PlyProperty &property : element.properties)
+			{
+				property.offset = offset;
+				offset += GetPlyTypeSize(property.type);
+				fixed &= (property.countType == PLY_INVALID);
+			}
+			element.stride = fixed ? offset : 0;
+		}
+
+		// Find the vertex and face blocks, skipping any other elements
+		const UINT8* end = file.data + file.size;
+		const UINT8* cursor = body;
+		const PlyElement* vertexElement = nullptr;
+		const PlyElement* faceElement = nullptr;
+		const UINT8* vertexData = nullptr;
+		const UINT8* faceData = nullptr;
+
+		for (const PlyElement &element : elements)
+		{
+			if (element.name == "vertex" && !vertexElement)
+			{
+				if (element.stride == 0)
+				{
+					throw runtime_error("Error: PLY vertex lists are not supported!");
+				}
+				vertexElement = &element;
+				vertexData = cursor;
+			}
+			else if (element.name == "face" && !faceElement)
+			{
+				faceElement = &element;
+				faceData = cursor;
+			}
+
+			if (vertexElement && faceElement) break;
+
+			// Step over the element's block
+			if (element.stride > 0)
+			{
+				if (static_cast<size_t>(end - cursor) / element.stride < element.count)
+				{
+					throw runtime_error("Error: PLY file is truncated!");
+				}
+				cursor += element.stride * element.count;
+			}
+			else
+			{
+				for (size_t i = 0; i < element.count; i++) cursor += GetPlyElementSize(element, cursor, end);
+				if (cursor > end)
+				{
+					throw runtime_error("Error: PLY file is truncated!");
+				}
+			}
+		}
+
+		if (!vertexElement || !faceElement)
+		{
+			throw runtime_error("Error: PLY file has no vertex or face element!");
+		}
+
+		// Check the vertex block and locate its properties
+		const size_t vertexCount = vertexElement->count;
+		const size_t vertexStride = vertexElement->stride;
+		if (static_cast<size_t>(end - vertexData) / vertexStride < vertexCount)
+		{
+			throw runtime_error("Error: PLY file is truncated!");
+		}
+
+		int x = vertexElement->Find("x"), y = vertexElement->Find("y"), z = vertexElement->Find("z");
+		int nx = vertexElement->Find("nx"), ny = vertexElement->Find("ny"), nz = vertexElement->Find("nz");
+		int r = vertexElement->Find("red"), g = vertexElement->Find("green"), b = vertexElement->Find("blue");
+		if (x < 0 || y < 0 || z < 0)
+		{
+			throw runtime_error("Error: PLY vertices have no position!");
+		}
+
+		const vector<PlyProperty> &properties = vertexElement->properties;
+		bool hasNormals = (nx >= 0 && ny >= 0 && nz >= 0);
+		bool hasColors = (r >= 0 && g >= 0 && b >= 0);
+
+		// Positions stored as three consecutive floats are copied without conversion
+		bool packedPositions = properties[x].type == PLY_FLOAT32 && properties[y].type == PLY_FLOAT32 && properties[z].type == PLY_FLOAT32 &&
+			properties[y].offset == properties[x].offset + 4 && properties[z].offset == properties[x].offset + 8;
+		bool packedNormals = hasNormals && properties[nx].type == PLY_FLOAT32 && properties[ny].type == PLY_FLOAT32 && properties[nz].type == PLY_FLOAT32 &&
+			properties[ny].offset == properties[nx].offset + 4 && properties[nz].offset == properties[nx].offset + 8;
+
+		// Integer colors are normalized by the range of their type
+		float colorScale = 1.f;
+		if (hasColors && properties[r].type != PLY_FLOAT32 && properties[r].type != PLY_FLOAT64)
+		{
+			colorScale = 1.f / static_cast<float>((1ull << (8 * GetPlyTypeSize(properties[r].type))) - 1);
+		}
+
+		material.name = "defaultMaterial";
+		material.texturePath = "";
+
+		const size_t baseVertex = model.positions.size();
+		model.positions.resize(baseVertex + vertexCount);
+		model.attributes.resize(baseVertex + vertexCount);
+
+		// Convert the vertex block, swapping x and z to match the OBJ loader
+		ParallelFor(vertexCount, 65536, [&](size_t first, size_t last)
+		{
+			for (size_t v = first; v < last; v++)
+			{
+				const UINT8* vertex = vertexData + v * vertexStride;
+				XMFLOAT3 &position = model.positions[baseVertex + v];
+				if (packedPositions)
+				{
+					float p[3];
+					memcpy(p, vertex + properties[x].offset, sizeof(p));
+					position = XMFLOAT3(p[2], p[1], p[0]);
+				}
+				else
+				{
+					position = XMFLOAT3(
+						static_cast<float>(ReadPlyValue(vertex + properties[z].offset, properties[z].type)),
+						static_cast<float>(ReadPlyValue(vertex + properties[y].offset, properties[y].type)),
+						static_cast<float>(ReadPlyValue(vertex + properties[x].offset, properties[x].type)));
+				}
+
+				VertexAttributes &attribute = model.attributes[baseVertex + v];
+				if (packedNormals)
+				{
+					float n[3];
+					memcpy(n, vertex + properties[nx].offset, sizeof(n));
+					attribute.normal = XMFLOAT3(n[2], n[1], n[0]);
+				}
+				else if (hasNormals)
+				{
+					attribute.normal = XMFLOAT3(
+						static_cast<float>(ReadPlyValue(vertex + properties[nz].offset, properties[nz].type)),
+						static_cast<float>(ReadPlyValue(vertex + properties[ny].offset, properties[ny].type)),
+						static_cast<float>(ReadPlyValue(vertex + properties[nx].offset, properties[nx].type)));
+				}
+				else
+				{
+					attribute.normal = XMFLOAT3(0, 0, 1);
+				}
+
+				if (hasColors)
+				{
+					attribute.color = XMFLOAT3(
+						static_cast<float>(ReadPlyValue(vertex + properties[r].offset, properties[r].type)) * colorScale,
+						static_cast<float>(ReadPlyValue(vertex + properties[g].offset, properties[g].type)) * colorScale,
+						static_cast<float>(ReadPlyValue(vertex + properties[b].offset, properties[b].type)) * colorScale);
+				}
+				else
+				{
+					attribute.color = XMFLOAT3(0.8f, 0.8f, 0.8f);
+				}
+				attribute.material = XMFLOAT3(1, 1, 0);
+			}
+		});
+
+		// Locate the face index list
+		int list = faceElement->Find("vertex_indices");
+		if (list < 0) list = faceElement->Find("vertex_index");
+		if (list < 0 || faceElement->properties[list].countType == PLY_INVALID)
+		{
+			throw runtime_error("Error: PLY faces have no vertex index list!");
+		}
+
+		// Checked here, the indices are read on worker threads that cannot report errors
+		const PlyProperty &indexList = faceElement->properties[list];
+		if (indexList.type != PLY_UINT8 && indexList.type != PLY_INT8 && indexList.type != PLY_UINT16 && indexList.type != PLY_INT16 &&
+			indexList.type != PLY_UINT32 && indexList.type != PLY_INT32)
+		{
+			throw runtime_error("Error: PLY face indices must be integers!");
+		}
+
+		const size_t countSize = GetPlyTypeSize(indexList.countType);
+		const size_t indexSize = GetPlyTypeSize(indexList.type);
+		const size_t faceCount = faceElement->count;
+
+		// When the index list is the only property and every face is a triangle, faces have a fixed size
+		const size_t triangleStride = countSize + 3 * indexSize;
+		bool triangles = (faceElement->properties.size() == 1) && (static_cast<size_t>(end - faceData) / triangleStride >= faceCount);
+		if (triangles)
+		{
+			atomic<bool> allTriangles(true);
+			ParallelFor(faceCount, 65536, [&](size_t first, size_t last)
+			{
+				for (size_t f = first; f < last && allTriangles; f++)
+				{
+					if (ReadPlyValue(faceData + f * triangleStride, indexList.countType) != 3) allTriangles = false;
+				}
+			});
+			triangles = allTriangles;
+		}
+
+		const size_t firstIndex = model.indices.size();
+		bool indicesValid = true;
+		if (triangles)
+		{
+			// Copy the indices out of the fixed size faces in parallel
+			model.indices.resize(firstIndex + faceCount * 3);
+			atomic<bool> inRange(true);
+			ParallelFor(faceCount, 65536, [&](size_t first, size_t last)
+			{
+				uint32_t* output = model.indices.data() + firstIndex;
+				uint32_t largest = 0;
+				for (size_t f = first; f < last; f++)
+				{
+					const UINT8* face = faceData + f * triangleStride + countSize;
+					for (size_t i = 0; i < 3; i++)
+					{
+						uint32_t index = ReadPlyIndex(face + i * indexSize, indexList.type);
+						largest = max(largest, index);
+						output[f * 3 + i] = static_cast<uint32_t>(baseVertex + index);
+					}
+				}
+				if (largest >= vertexCount) inRange = false;
+			});
+			indicesValid = inRange;
+		}
+		else
+		{
+			// Walk the variable size faces, triangulating polygons as fans
+			cursor = faceData;
+			model.indices.reserve(firstIndex + faceCount * 3);
+			for (size_t f = 0; f < faceCount; f++)
+			{
+				const UINT8* face = cursor;
+				size_t faceSize = GetPlyElementSize(*faceElement, face, end);
+				if (faceSize > static_cast<size_t>(end - face))
+				{
+					throw runtime_error("Error: PLY file is truncated!");
+				}
+				cursor += faceSize;
+
+				// Find the index list within the face
+				const UINT8* listData = face;
+				for (int p = 0; p < list; p++)
+				{
+					const PlyProperty &property = faceElement->properties[p];
+					if (property.countType == PLY_INVALID) listData += GetPlyTypeSize(property.type);
+					else listData += GetPlyTypeSize(property.countType) + static_cast<size_t>(ReadPlyValue(listData, property.countType)) * GetPlyTypeSize(property.type);
+				}
+
+				size_t count = static_cast<size_t>(ReadPlyValue(listData, indexList.countType));
+				if (count < 3) continue;
+
+				const UINT8* indices = listData + countSize;
+				uint32_t first = ReadPlyIndex(indices, indexList.type);
+				for (size_t i = 2; i < count; i++)
+				{
+					uint32_t a = ReadPlyIndex(indices + (i - 1) * indexSize, indexList.type);
+					uint32_t c = ReadPlyIndex(indices + i * indexSize, indexList.type);
+					indicesValid &= (first < vertexCount && a < vertexCount && c < vertexCount);
+					model.indices.push_back(static_cast<uint32_t>(baseVertex + first));
+					model.indices.push_back(static_cast<uint32_t>(baseVertex + a));
+					model.indices.push_back(static_cast<uint32_t>(baseVertex + c));
+				}
+			}
+		}
+
+		if (!indicesValid)
+		{
+			throw runtime_error("Error: PLY face index is out of range!");
+		}
+	}
+	catch (...)
+	{
+		UnmapFile(file);
+		throw;
+	}
+
+	UnmapFile(file);
+
+	clock.Tick();
+	Log("PLY: %zu vertices, %zu triangles in %.2f ms\n", model.positions.size(), model.indices.size() / 3, clock.GetDeltaMilliseconds());
+}
+
+//--------------------------------------------------------------------------------------
+// Scene Files
+//--------------------------------------------------------------------------------------
+
+/**
+* A compiled scene is a header followed by one section per Model stream. Each section holds the stream's structures exactly as
+* they are laid out in memory, so loading one is a copy out of the mapped file.
+*/
+enum SceneSectionType
+{
+	ScenePositions,
+	SceneAttributes,
+	SceneIndices,
+	SceneMeshes,
+	SceneInstances,
+	SceneSpheres,
+	SceneLights,
+	SceneCameraPath,
+	SceneSectionCount
+};
+
+struct SceneSection
+{
+	uint64_t	offset;			// from the start of the file, 16 byte aligned
+	uint64_t	count;
+	uint32_t	stride;			// element size, so a file written by a build with different structures is rejected
+	uint32_t	padding;
+};
+
+struct SceneFileHeader
+{
+	char			magic[8];
+	uint32_t		version;
+	uint32_t		sectionCount;
+	SceneSection	sections[SceneSectionCount];
+};
+
+static const char SceneMagic[8] = { 'D', 'X', 'R', 'S', 'C', 'E', 'N', 'E' };
+static const uint32_t SceneVersion = 1;
+
+template <typename T>
+static void AddSceneSection(SceneFileHeader &header, SceneSectionType type, const vector<T> &elements, uint64_t &offset)
+{
+	header.sections[type].offset = offset;
+	header.sections[type].count = elements.size();
+	header.sections[type].stride = sizeof(T);
+	header.sections[type].padding = 0;
+	offset = ALIGN(16, offset + elements.size() * sizeof(T));
+}
+
+template <typename T>
+static void ReadSceneSection(const MappedFile &file, const SceneFileHeader &header, SceneSectionType type, vector<T> &elements)
+{
+	const SceneSection &section = header.sections[type];
+	if (section.stride != sizeof(T) || section.offset > file.size || section.count > (file.size - section.offset) / sizeof(T))
+	{
+		throw runtime_error("Error: compiled scene is corrupt or was written by a different build!");
+	}
+
+	const T* first = reinterpret_cast<const T*>(file.data + section.offset);
+	elements.assign(first, first + section.count);
+}
+
+/**
+* Write a model as a compiled scene. The file is written next to its destination and renamed into place, so a
+* reader never sees a partial file.
+*/
+static void WriteSceneBinary(const string &filepath, const Model &model)
+{
+	SceneFileHeader header = {};
+	memcpy(header.magic, SceneMagic, sizeof(SceneMagic));
+	header.version = SceneVersion;
+	header.sectionCount = SceneSectionCount;
+
+	uint64_t offset = ALIGN(16, sizeof(SceneFileHeader));
+	AddSceneSection(header, ScenePositions, model.positions, offset);
+	AddSceneSection(header, SceneAttributes, model.attributes, offset);
+	AddSceneSection(header, SceneIndices, model.indices, offset);
+	AddSceneSection(header, SceneMeshes, model.meshes, offset);
+	AddSceneSection(header, SceneInstances, model.instances, offset);
+	AddSceneSection(header, SceneSpheres, model.spheres, offset);
+	AddSceneSection(header, SceneLights, model.lights, offset);
+	AddSceneSection(header, SceneCameraPath, model.cameraPath, offset);
+
+	const void* streams[SceneSectionCount] = {
+		model.positions.data(), model.attributes.data(), model.indices.data(), model.meshes.data(),
+		model.instances.data(), model.spheres.data(), model.lights.data(), model.cameraPath.data()
+	};
+
+	// Another process may compile the same scene at once, each writes its own temporary file
+	string temporaryPath = GetTemporaryPath(filepath);
+	{
+		ofstream file(temporaryPath, ios::binary | ios::trunc);
+		if (!file.is_open())
+		{
+			throw runtime_error("Error: failed to create compiled scene '" + temporaryPath + "'!");
+		}
+
+		const char zeros[16] = {};
+		uint64_t position = sizeof(SceneFileHeader);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(SceneFileHeader));
+		for (int s = 0; s < SceneSectionCount; s++)
+		{
+			const SceneSection &section = header.sections[s];
+			file.write(zeros, static_cast<streamsize>(section.offset - position));
+			file.write(static_cast<const char*>(streams[s]), static_cast<streamsize>(section.count * section.stride));
+			position = section.offset + section.count * section.stride;
+		}
+
+		if (!file.good())
+		{
+			file.close();
+			DeleteFileA(temporaryPath.c_str());
+			throw runtime_error("Error: failed to write compiled scene '" + temporaryPath + "'!");
 		}
-	}
-	else {
-		return E_FAIL;
 	}
 
-	LocalFree(argv);
-	return S_OK;
+	if (!MoveFileExA(temporaryPath.c_str(), filepath.c_str(), MOVEFILE_REPLACE_EXISTING))
+	{
+		DeleteFileA(temporaryPath.c_str());
+		throw runtime_error("Error: failed to replace compiled scene '" + filepath + "'!");
+	}
 }
 
-//--------------------------------------------------------------------------------------
-// Error Messaging
-//--------------------------------------------------------------------------------------
-
-void Validate(HRESULT hr, LPWSTR msg)
+static void LoadSceneBinary(const string &filepath, Model &model)
 {
-	if (FAILED(hr))
+	MappedFile file;
+	MapFile(filepath, file);
+	try
 	{
-		MessageBox(NULL, msg, L"Error", MB_OK);
-		PostQuitMessage(EXIT_FAILURE);
+		SceneFileHeader header;
+		if (file.size < sizeof(SceneFileHeader))
+		{
+			throw runtime_error("Error: compiled scene is truncated!");
+		}
+		memcpy(&header, file.data, sizeof(SceneFileHeader));
+
+		if (memcmp(header.magic, SceneMagic, sizeof(SceneMagic)) != 0 || header.version != SceneVersion || header.sectionCount != SceneSectionCount)
+		{
+			throw runtime_error("Error: '" + filepath + "' is not a compiled scene of this version!");
+		}
+
+		ReadSceneSection(file, header, ScenePositions, model.positions);
+		ReadSceneSection(file, header, SceneAttributes, model.attributes);
+		ReadSceneSection(file, header, SceneIndices, model.indices);
+		ReadSceneSection(file, header, SceneMeshes, model.meshes);
+		ReadSceneSection(file, header, SceneInstances, model.instances);
+		ReadSceneSection(file, header, SceneSpheres, model.spheres);
+		ReadSceneSection(file, header, SceneLights, model.lights);
+		ReadSceneSection(file, header, SceneCameraPath, model.cameraPath);
+	}
+	catch (...)
+	{
+		UnmapFile(file);
+		throw;
+	}
+	UnmapFile(file);
+
+	// The vertex streams must line up, and every index, mesh, and instance must stay inside them
+	bool valid = (model.attributes.size() == model.positions.size());
+	for (size_t i = 0; valid && i < model.indices.size(); i++) valid = (model.indices[i] < model.positions.size());
+	for (size_t m = 0; valid && m < model.meshes.size(); m++) valid = (model.meshes[m].firstIndex + model.meshes[m].indexCount <= model.indices.size());
+	for (size_t i = 0; valid && i < model.instances.size(); i++) valid = (model.instances[i].mesh < model.meshes.size());
+	if (!valid)
+	{
+		throw runtime_error("Error: compiled scene '" + filepath + "' references geometry it does not contain!");
 	}
 }
 
-//--------------------------------------------------------------------------------------
-// File Reading
-//--------------------------------------------------------------------------------------
-
-vector<char> ReadFile(const string &filename) 
+/**
+* Parse the text form of a scene. One statement per line, # starts a comment:
+*   material <name> <r> <g> <b> <diffuse> <specular> <reflection>
+*   use <material>                                  material of the statements that follow
+*   mesh <name> ... end                             vertex, triangle and primitive statements build the mesh
+*   vertex <x> <y> <z> <nx> <ny> <nz>
+*   triangle <a> <b> <c>                            vertices of the mesh, counted from 0
+*   primitive <shape> <tessellation> <transform>    sphere, icosphere, box, plane, cylinder, or capsule
+*   instance <mesh> <transform>                     meshes without instances are placed once at the origin
+*   sphere <x> <y> <z> <radius>                     analytic sphere
+*   light <x> <y> <z> [<swing>]
+*   camera <time> <x> <y> <z> <focus x> <focus y> <focus z>
+* A transform is a position, optionally followed by a scale and then a rotation in degrees around X, Y and Z.
+*/
+static void ParseScene(const string &filepath, Model &model)
 {
-	ifstream file(filename, ios::ate | ios::binary);
-
-	if (!file.is_open()) 
+	ifstream file(filepath);
+	if (!file.is_open())
 	{
-		throw std::runtime_error("Error: failed to open file!");
+		throw runtime_error("Error: failed to open scene '" + filepath + "'!");
 	}
 
-	size_t fileSize = (size_t)file.tellg();
-	std::vector<char> buffer(fileSize);
+	struct SceneMaterial { XMFLOAT3 color; XMFLOAT3 weights; };
+	struct PendingInstance { string mesh; XMFLOAT4X4 transform; size_t line; };
 
-	file.seekg(0);
-	file.read(buffer.data(), fileSize);
-	file.close();
+	map<string, SceneMaterial> materials;
+	map<string, uint32_t> meshNames;
+	vector<PendingInstance> instances;
+	SceneMaterial current = { XMFLOAT3(1.f, 1.f, 1.f), XMFLOAT3(1.f, 0.f, 0.f) };
+	int openMesh = -1;
+	size_t meshFirstVertex = 0;
 
-	return buffer;
-}
+	string text;
+	size_t lineNumber = 0;
+	while (getline(file, text))
+	{
+		lineNumber++;
+		size_t comment = text.find('#');
+		if (comment != string::npos) text.resize(comment);
 
-//--------------------------------------------------------------------------------------
-// Model Loading
-//--------------------------------------------------------------------------------------
+		istringstream line(text);
+		string keyword;
+		if (!(line >> keyword)) continue;
 
-void LoadModel(string filepath, Model &model, Material &material) 
-{
-	tinyobj::attrib_t attrib;
-	std::vector<tinyobj::shape_t> shapes;
-	std::vector<tinyobj::material_t> materials;
-	std::string err;
+		auto fail = [&](const string &message)
+		{
+			throw runtime_error("Error: " + filepath + " line " + to_string(lineNumber) + ": " + message);
+		};
+		auto readFloats = [&](size_t count)
+		{
+			vector<float> values(count);
+			for (float &value : values)
+			{
+				if (!(line >> value)) fail("expected " + to_string(count) + " numbers after '" + keyword + "'");
+			}
+			return values;
+		};
+		auto readTransform = [&]()
+		{
+			vector<float> values;
+			float value;
+			while (line >> value) values.push_back(value);
+			if (!line.eof() || (values.size() != 3 && values.size() != 6 && values.size() != 9)) fail("a transform is a position, then optionally a scale and a rotation");
+
+			XMFLOAT3 scale = (values.size() >= 6) ? XMFLOAT3(values[3], values[4], values[5]) : XMFLOAT3(1.f, 1.f, 1.f);
+			XMFLOAT3 rotation = (values.size() == 9) ? XMFLOAT3(XMConvertToRadians(values[6]), XMConvertToRadians(values[7]), XMConvertToRadians(values[8])) : XMFLOAT3(0.f, 0.f, 0.f);
+			return Primitives::GetTransform(XMFLOAT3(values[0], values[1], values[2]), scale, rotation);
+		};
+		auto requireMesh = [&]()
+		{
+			if (openMesh < 0) fail("'" + keyword + "' must be inside a mesh");
+		};
 
-	// Load the OBJ and MTL files
-	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &err, filepath.c_str(), "materials\\")) 
+		if (keyword == "material")
+		{
+			string name;
+			if (!(line >> name)) fail("expected a material name");
+			vector<float> values = readFloats(6);
+			materials[name] = { XMFLOAT3(values[0], values[1], values[2]), XMFLOAT3(values[3], values[4], values[5]) };
+		}
+		else if (keyword == "use")
+		{
+			string name;
+			line >> name;
+			auto found = materials.find(name);
+			if (found == materials.end()) fail("unknown material '" + name + "'");
+			current = found->second;
+		}
+		else if (keyword == "mesh")
+		{
+			string name;
+			if (openMesh >= 0) fail("meshes cannot be nested");
+			if (!(line >> name)) fail("expected a mesh name");
+			if (meshNames.count(name)) fail("mesh '" + name + "' is already defined");
+
+			Mesh mesh = {};
+			mesh.firstIndex = model.indices.size();
+			openMesh = static_cast<int>(model.meshes.size());
+			meshNames[name] = static_cast<uint32_t>(openMesh);
+			meshFirstVertex = model.positions.size();
+			model.meshes.push_back(mesh);
+		}
+		else if (keyword == "end")
+		{
+			requireMesh();
+			model.meshes[openMesh].indexCount = model.indices.size() - model.meshes[openMesh].firstIndex;
+			openMesh = -1;
+		}
+		else if (keyword == "vertex")
+		{
+			requireMesh();
+			vector<float> values = readFloats(6);
+			model.AddVertex({ XMFLOAT3(values[0], values[1], values[2]), current.color, XMFLOAT3(values[3], values[4], values[5]), current.weights });
+		}
+		else if (keyword == "triangle")
+		{
+			requireMesh();
+			for (int c = 0; c < 3; c++)
+			{
+				size_t index;
+				if (!(line >> index)) fail("expected three vertex numbers");
+				if (meshFirstVertex + index >= model.positions.size()) fail("vertex " + to_string(index) + " is not defined yet");
+				model.indices.push_back(static_cast<uint32_t>(meshFirstVertex + index));
+			}
+		}
+		else if (keyword == "primitive")
+		{
+			requireMesh();
+			static const map<string, PrimitiveShape> shapes = {
+				{ "sphere", PrimitiveShape::Sphere }, { "icosphere", PrimitiveShape::Icosphere }, { "box", PrimitiveShape::Box },
+				{ "plane", PrimitiveShape::Plane }, { "cylinder", PrimitiveShape::Cylinder }, { "capsule", PrimitiveShape::Capsule }
+			};
+
+			string shape;
+			uint32_t tessellation;
+			line >> shape;
+			auto found = shapes.find(shape);
+			if (found == shapes.end()) fail("unknown primitive '" + shape + "'");
+			if (!(line >> tessellation)) fail("expected a tessellation");
+			Primitives::AddPrimitive(model, { found->second, tessellation, readTransform(), current.color, current.weights });
+		}
+		else if (keyword == "instance")
+		{
+			PendingInstance instance;
+			if (!(line >> instance.mesh)) fail("expected a mesh name");
+			instance.transform = readTransform();
+			instance.line = lineNumber;
+			instances.push_back(instance);
+		}
+		else if (keyword == "sphere")
+		{
+			vector<float> values = readFloats(4);
+			model.spheres.push_back({ XMFLOAT3(values[0], values[1], values[2]), values[3], current.color, current.weights });
+		}
+		else if (keyword == "light")
+		{
+			vector<float> values = readFloats(3);
+			float swing = 0.f;
+			line >> swing;
+			model.lights.push_back({ XMFLOAT3(values[0], values[1], values[2]), swing });
+		}
+		else if (keyword == "camera")
+		{
+			vector<float> values = readFloats(7);
+			model.cameraPath.push_back({ values[0], XMFLOAT3(values[1], values[2], values[3]), XMFLOAT3(values[4], values[5], values[6]) });
+		}
+		else
+		{
+			fail("unknown statement '" + keyword + "'");
+		}
+	}
+
+	if (openMesh >= 0)
 	{
-		throw std::runtime_error(err);
+		throw runtime_error("Error: " + filepath + ": mesh is missing its 'end'");
 	}
 
-	// Get the first material
-	// Only support a single material right now
-	if (materials.size() > 0) {
-		material.name = materials[0].name;
-		material.texturePath = materials[0].diffuse_texname;
+	// Resolve the instances now that every mesh is known
+	vector<bool> instanced(model.meshes.size(), false);
+	for (const PendingInstance &pending : instances)
+	{
+		auto found = meshNames.find(pending.mesh);
+		if (found == meshNames.end())
+		{
+			throw runtime_error("Error: " + filepath + " line " + to_string(pending.line) + ": unknown mesh '" + pending.mesh + "'");
+		}
+
+		MeshInstance instance = {};
+		instance.mesh = found->second;
+		instance.transform = pending.transform;
+		model.instances.push_back(instance);
+		instanced[found->second] = true;
 	}
-	else {
-		material.name = "defaultMaterial";
-		material.texturePath = "";
+
+	for (uint32_t m = 0; m < model.meshes.size(); m++)
+	{
+		if (instanced[m]) continue;
+
+		MeshInstance instance = {};
+		instance.mesh = m;
+		XMStoreFloat4x4(&instance.transform, XMMatrixIdentity());
+		model.instances.push_back(instance);
 	}
 
-	// Parse the model and store the unique vertices
-	unordered_map<Vertex, uint32_t> uniqueVertices = {};
-	for (const auto &shape : shapes) 
+	stable_sort(model.cameraPath.begin(), model.cameraPath.end(), [](const CameraKey &a, const CameraKey &b) { return a.time < b.time; });
+}
+
+/**
+* Check whether a file was written after another, or the other does not exist.
+*/
+static bool IsFileNewer(const string &filepath, const string &otherFilepath)
+{
+	WIN32_FILE_ATTRIBUTE_DATA attributes, otherAttributes;
+	if (!GetFileAttributesExA(otherFilepath.c_str(), GetFileExInfoStandard, &otherAttributes)) return true;
+	if (!GetFileAttributesExA(filepath.c_str(), GetFileExInfoStandard, &attributes)) return false;
+	return CompareFileTime(&attributes.ftLastWriteTime, &otherAttributes.ftLastWriteTime) > 0;
+}
+
+/**
+* Load a scene file. A text scene is compiled to a binary scene beside it (.scene to .sceneb) the first time it loads or after it
+* changes, or when the binary scene was written by another version or build. The binary scene is then mapped and copied
+* without parsing.
+*/
+void LoadScene(string filepath, Model &model, Material &material)
+{
+	HighResolutionClock clock;
+
+	string binaryPath = filepath;
+	if (GetExtension(filepath) == ".scene")
 	{
-		for (const auto &index : shape.mesh.indices) 
+		binaryPath = filepath + "b";
+		bool compile = IsFileNewer(filepath, binaryPath);
+		if (!compile)
 		{
-			Vertex vertex = {
-				XMFLOAT3(//Position
-					attrib.vertices[3 * index.vertex_index + 2],
-					attrib.vertices[3 * index.vertex_index + 1],
-					attrib.vertices[3 * index.vertex_index + 0]),
-				XMFLOAT3(//Color
-					2,
-					1.f - attrib.texcoords[2 * index.texcoord_index + 0],
-					attrib.texcoords[2 * index.texcoord_index + 1]),
-				index.normal_index >= 0 ?
-				XMFLOAT3(//Normal
-					attrib.normals[3 * index.normal_index + 2],
-					attrib.normals[3 * index.normal_index + 1],
-					attrib.normals[3 * index.normal_index + 0]
-				)
-				: XMFLOAT3(0,0,1),
-				XMFLOAT3(1, 1, 0)//Material
-			};
-
-			// Fast find unique vertices using a hash
-			if (uniqueVertices.count(vertex) == 0) 
+			// A compiled scene from another version or build, or a damaged one, is compiled again from its source
+			try
+			{
+				LoadSceneBinary(binaryPath, model);
+			}
+			catch (const exception &e)
 			{
-				uniqueVertices[vertex] = static_cast<uint32_t>(model.vertices.size());
-				model.vertices.push_back(vertex);
+				Log("%s Recompiling %s\n", e.what(), filepath.c_str());
+				model = Model();
+				compile = true;
 			}
+		}
 
-			model.indices.push_back(uniqueVertices[vertex]);
+		if (compile)
+		{
+			Model compiled;
+			ParseScene(filepath, compiled);
+			try
+			{
+				WriteSceneBinary(binaryPath, compiled);
+				Log("Scene %s: compiled to %s\n", filepath.c_str(), binaryPath.c_str());
+			}
+			catch (const exception &e)
+			{
+				// A read-only scene directory still loads, just without the compiled copy
+				Log("%s\n", e.what());
+			}
+			model = move(compiled);
 		}
 	}
+	else
+	{
+		LoadSceneBinary(binaryPath, model);
+	}
+
+	clock.Tick();
+	Log("Scene %s: %zu meshes, %zu instances, %zu spheres, %zu vertices, %zu triangles in %.2f ms\n",
+		binaryPath.c_str(), model.meshes.size(), model.instances.size(), model.spheres.size(), model.positions.size(), model.indices.size() / 3, clock.GetDeltaMilliseconds());
+}
+
+/**
+* Sample the camera path at a time, looping over the path's duration.
+*/
+void SampleCameraPath(const vector<CameraKey> &path, double time, XMFLOAT3 &position, XMFLOAT3 &focus)
+{
+	position = path.front().position;
+	focus = path.front().focus;
+
+	float duration = path.back().time - path.front().time;
+	if (path.size() < 2 || duration <= 0.f) return;
+
+	float t = path.front().time + fmodf(static_cast<float>(time), duration);
+	size_t next = 1;
+	while (next < path.size() - 1 && path[next].time < t) next++;
+
+	const CameraKey &a = path[next - 1];
+	const CameraKey &b = path[next];
+	float blend = (b.time > a.time) ? (t - a.time) / (b.time - a.time) : 1.f;
+	blend = min(max(blend, 0.f), 1.f);
+
+	XMStoreFloat3(&position, XMVectorLerp(XMLoadFloat3(&a.position), XMLoadFloat3(&b.position), blend));
+	XMStoreFloat3(&focus, XMVectorLerp(XMLoadFloat3(&a.focus), XMLoadFloat3(&b.focus), blend));
 }
 
 //--------------------------------------------------------------------------------------
@@ -227,46 +2337,18 @@ void LoadCustomScene(Model &model, Material &material) {
 
 	material.name = "defaultMaterial";
 	material.texturePath = "";
-	// Initialize Vertices - Back
-	model.vertices.push_back({ XMFLOAT3(-8.0f, -2.0f, -20.0f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
-	model.vertices.push_back({ XMFLOAT3(8.0f, -2.0f, -20.0f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
-	model.vertices.push_back({ XMFLOAT3(8.0f, 10.0f, -20.0f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
-	model.vertices.push_back({ XMFLOAT3(-8.0f, 10.0f, -20.0f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
-
-	// Floor
-	model.vertices.push_back({ XMFLOAT3(-8.0f, -2.0f, -20.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
-	model.vertices.push_back({ XMFLOAT3(8.0f, -2.0f, -20.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
-	model.vertices.push_back({ XMFLOAT3(8.0f, -2.0f, -10.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
-	model.vertices.push_back({ XMFLOAT3(-8.0f, -2.0f, -10.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
-
 	// Side
-	model.vertices.push_back({ XMFLOAT3(-8.0f, -2.0f, -20.0f), XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
-	model.vertices.push_back({ XMFLOAT3(-8.0f, -2.0f, -10.0f), XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
-	model.vertices.push_back({ XMFLOAT3(-8.0f, 10.0f, -20.0f), XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
-
-	//Define Indicies for Triangles of Environment
-	// Back
-	model.indices.push_back(0);
-	model.indices.push_back(1);
-	model.indices.push_back(2);
-
-	model.indices.push_back(0);
-	model.indices.push_back(2);
-	model.indices.push_back(3);
-
-	// Floor
-	model.indices.push_back(4);
-	model.indices.push_back(6);
-	model.indices.push_back(5);
-
-	model.indices.push_back(4);
-	model.indices.push_back(7);
-	model.indices.push_back(6);
-
-	//Side
-	model.indices.push_back(8);
-	model.indices.push_back(10);
-	model.indices.push_back(9);
+	model.AddVertex({ XMFLOAT3(-8.0f, -2.0f, -20.0f), XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
+	model.AddVertex({ XMFLOAT3(-8.0f, -2.0f, -10.0f), XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
+	model.AddVertex({ XMFLOAT3(-8.0f, 10.0f, -20.0f), XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
+
+	model.indices.insert(model.indices.end(), { 0, 2, 1 });
+
+	// Back and Floor
+	Primitives::AddPrimitives(model, {
+		{ PrimitiveShape::Plane, 1, Primitives::GetTransform(XMFLOAT3(0.0f, 4.0f, -20.0f), XMFLOAT3(8.0f, 1.0f, 6.0f), XMFLOAT3(XM_PIDIV2, 0.0f, 0.0f)), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) },
+		{ PrimitiveShape::Plane, 1, Primitives::GetTransform(XMFLOAT3(0.0f, -2.0f, -15.0f), XMFLOAT3(8.0f, 1.0f, 5.0f)), XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) },
+	});
 
 	LoadSphere(model, material, XMFLOAT3(0.0, 0.0, -16.0), 4, XMFLOAT3(1, 1, 1), XMFLOAT3(0.0f, 0.0f, 1.0f));
 	LoadSphere(model, material, XMFLOAT3(-3.0, -1.0, -14.0), 2, XMFLOAT3(1, 1, 1), XMFLOAT3(0.0f, 0.0f, 1.0f));
@@ -278,208 +2360,92 @@ void LoadCustomAdvancedScene(Model &model, Material &material) {
 	material.name = "defaultMaterial";
 	material.texturePath = "";
 
-	//Environment Description
-	// Back
-	model.vertices.push_back({ XMFLOAT3(-8.0f, -2.0f, -20.0f), XMFLOAT3(0.61f, 0.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f) });
-	model.vertices.push_back({ XMFLOAT3(8.0f, -2.0f, -20.0f), XMFLOAT3(0.61f, 0.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f) });
-	model.vertices.push_back({ XMFLOAT3(8.0f, 10.0f, -20.0f), XMFLOAT3(0.61f, 0.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f) });
-	model.vertices.push_back({ XMFLOAT3(-8.0f, 10.0f, -20.0f), XMFLOAT3(0.61f, 0.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 0.0f) });
-
-	// Floor
-	model.vertices.push_back({ XMFLOAT3(-8.0f, -2.0f, -20.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 0.5f) });
-	model.vertices.push_back({ XMFLOAT3(8.0f, -2.0f, -20.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 0.5f) });
-	model.vertices.push_back({ XMFLOAT3(8.0f, -2.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 0.5f) });
-	model.vertices.push_back({ XMFLOAT3(-8.0f, -2.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 0.5f) });
-
-	// Right Side
-	model.vertices.push_back({ XMFLOAT3(-8.0f, -2.0f, -20.0f), XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT3(0.5f, 0.5f, 0.5f) });
-	model.vertices.push_back({ XMFLOAT3(-8.0f, -2.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT3(0.5f, 0.5f, 0.5f) });
-	model.vertices.push_back({ XMFLOAT3(-8.0f, 10.0f, -20.0f), XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT3(0.5f, 0.5f, 0.5f) });
-	model.vertices.push_back({ XMFLOAT3(-8.0f, 10.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT3(0.5f, 0.5f, 0.5f) });
-
-	// Left Side
-	model.vertices.push_back({ XMFLOAT3(8.0f, -2.0f, -20.0f), XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT3(0.5f, 0.5f, 0.5f) });
-	model.vertices.push_back({ XMFLOAT3(8.0f, -2.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT3(0.5f, 0.5f, 0.5f) });
-	model.vertices.push_back({ XMFLOAT3(8.0f, 10.0f, -20.0f), XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT3(0.5f, 0.5f, 0.5f) });
-	model.vertices.push_back({ XMFLOAT3(8.0f, 10.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT3(0.5f, 0.5f, 0.5f) });
-
 	//Ears
-	model.vertices.push_back({ XMFLOAT3(1.3f, 5.0f, -12.0f), XMFLOAT3(0.36f, 0.25f, 0.05f), XMFLOAT3(-1.5f, -1.0f, 1.31f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
-	model.vertices.push_back({ XMFLOAT3(0.3f, 3.75f, -14.0f), XMFLOAT3(0.36f, 0.25f, 0.05f), XMFLOAT3(-1.5f, -1.0f, 1.31f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
-	model.vertices.push_back({ XMFLOAT3(0.8f, 3.0f, -14.0f), XMFLOAT3(0.36f, 0.25f, 0.05f), XMFLOAT3(-1.5f, -1.0f, 1.31f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
+	model.AddVertex({ XMFLOAT3(1.3f, 5.0f, -12.0f), XMFLOAT3(0.36f, 0.25f, 0.05f), XMFLOAT3(-1.5f, -1.0f, 1.31f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
+	model.AddVertex({ XMFLOAT3(0.3f, 3.75f, -14.0f), XMFLOAT3(0.36f, 0.25f, 0.05f), XMFLOAT3(-1.5f, -1.0f, 1.31f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
+	model.AddVertex({ XMFLOAT3(0.8f, 3.0f, -14.0f), XMFLOAT3(0.36f, 0.25f, 0.05f), XMFLOAT3(-1.5f, -1.0f, 1.31f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
 
-	model.vertices.push_back({ XMFLOAT3(-0.3f, 3.75f, -14.0f), XMFLOAT3(0.36f, 0.25f, 0.05f), XMFLOAT3(1.5f, -1.0f, 1.31f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
-	model.vertices.push_back({ XMFLOAT3(-1.3f, 5.0f, -12.0f), XMFLOAT3(0.36f, 0.25f, 0.05f), XMFLOAT3(1.5f, -1.0f, 1.31f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
-	model.vertices.push_back({ XMFLOAT3(-0.8f, 3.0f, -14.0f), XMFLOAT3(0.36f, 0.25f, 0.05f), XMFLOAT3(1.5f, -1.0f, 1.31f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
+	model.AddVertex({ XMFLOAT3(-0.3f, 3.75f, -14.0f), XMFLOAT3(0.36f, 0.25f, 0.05f), XMFLOAT3(1.5f, -1.0f, 1.31f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
+	model.AddVertex({ XMFLOAT3(-1.3f, 5.0f, -12.0f), XMFLOAT3(0.36f, 0.25f, 0.05f), XMFLOAT3(1.5f, -1.0f, 1.31f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
+	model.AddVertex({ XMFLOAT3(-0.8f, 3.0f, -14.0f), XMFLOAT3(0.36f, 0.25f, 0.05f), XMFLOAT3(1.5f, -1.0f, 1.31f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
 
-	model.vertices.push_back({ XMFLOAT3(1.07f, 4.51f, -12.59f), XMFLOAT3(0.99f, 0.62f, 0.87f), XMFLOAT3(-1.5f, -1.0f, 1.31f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
-	model.vertices.push_back({ XMFLOAT3(0.4f, 3.60f, -13.99f), XMFLOAT3(0.99f, 0.62f, 0.87f), XMFLOAT3(-1.5f, -1.0f, 1.31f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
-	model.vertices.push_back({ XMFLOAT3(0.7f, 3.15f, -13.99f), XMFLOAT3(0.99f, 0.62f, 0.87f), XMFLOAT3(-1.5f, -1.0f, 1.31f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
+	model.AddVertex({ XMFLOAT3(1.07f, 4.51f, -12.59f), XMFLOAT3(0.99f, 0.62f, 0.87f), XMFLOAT3(-1.5f, -1.0f, 1.31f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
+	model.AddVertex({ XMFLOAT3(0.4f, 3.60f, -13.99f), XMFLOAT3(0.99f, 0.62f, 0.87f), XMFLOAT3(-1.5f, -1.0f, 1.31f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
+	model.AddVertex({ XMFLOAT3(0.7f, 3.15f, -13.99f), XMFLOAT3(0.99f, 0.62f, 0.87f), XMFLOAT3(-1.5f, -1.0f, 1.31f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
 
-	model.vertices.push_back({ XMFLOAT3(-0.4f, 3.60f, -13.99f), XMFLOAT3(0.99f, 0.62f, 0.87f), XMFLOAT3(1.5f, -1.0f, 1.31f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
-	model.vertices.push_back({ XMFLOAT3(-1.07f, 4.51f, -12.59f), XMFLOAT3(0.99f, 0.62f, 0.87f), XMFLOAT3(1.5f, -1.0f, 1.31f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
-	model.vertices.push_back({ XMFLOAT3(-0.7f, 3.15f, -13.99f), XMFLOAT3(0.99f, 0.62f, 0.87f), XMFLOAT3(1.5f, -1.0f, 1.31f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
+	model.AddVertex({ XMFLOAT3(-0.4f, 3.60f, -13.99f), XMFLOAT3(0.99f, 0.62f, 0.87f), XMFLOAT3(1.5f, -1.0f, 1.31f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
+	model.AddVertex({ XMFLOAT3(-1.07f, 4.51f, -12.59f), XMFLOAT3(0.99f, 0.62f, 0.87f), XMFLOAT3(1.5f, -1.0f, 1.31f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
+	model.AddVertex({ XMFLOAT3(-0.7f, 3.15f, -13.99f), XMFLOAT3(0.99f, 0.62f, 0.87f), XMFLOAT3(1.5f, -1.0f, 1.31f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
 
 	//Nose
-	model.vertices.push_back({ XMFLOAT3(0.25f, 2.0f, -12.24f), XMFLOAT3(0.80f, 0.69f, 0.48f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
-	model.vertices.push_back({ XMFLOAT3(-0.25f, 2.0f, -12.24f), XMFLOAT3(0.80f, 0.69f, 0.48f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
-	model.vertices.push_back({ XMFLOAT3(0.0f, 1.56699f, -12.24f), XMFLOAT3(0.80f, 0.69f, 0.48f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
+	model.AddVertex({ XMFLOAT3(0.25f, 2.0f, -12.24f), XMFLOAT3(0.80f, 0.69f, 0.48f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
+	model.AddVertex({ XMFLOAT3(-0.25f, 2.0f, -12.24f), XMFLOAT3(0.80f, 0.69f, 0.48f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
+	model.AddVertex({ XMFLOAT3(0.0f, 1.56699f, -12.24f), XMFLOAT3(0.80f, 0.69f, 0.48f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
 
 	//Arms
-	model.vertices.push_back({ XMFLOAT3(1.5f, 1.0f, -14.0f), XMFLOAT3(0.36f, 0.25f, 0.05f), XMFLOAT3(-4.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
-	model.vertices.push_back({ XMFLOAT3(1.5f, 0.0f, -14.0f), XMFLOAT3(0.36f, 0.25f, 0.05f), XMFLOAT3(-4.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
-	model.vertices.push_back({ XMFLOAT3(2.5f, 1.25f, -10.0f), XMFLOAT3(0.36f, 0.25f, 0.05f), XMFLOAT3(-4.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
+	model.AddVertex({ XMFLOAT3(1.5f, 1.0f, -14.0f), XMFLOAT3(0.36f, 0.25f, 0.05f), XMFLOAT3(-4.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
+	model.AddVertex({ XMFLOAT3(1.5f, 0.0f, -14.0f), XMFLOAT3(0.36f, 0.25f, 0.05f), XMFLOAT3(-4.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
+	model.AddVertex({ XMFLOAT3(2.5f, 1.25f, -10.0f), XMFLOAT3(0.36f, 0.25f, 0.05f), XMFLOAT3(-4.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
 
-	model.vertices.push_back({ XMFLOAT3(2.5f, 1.0f, -10.0f), XMFLOAT3(0.36f, 0.25f, 0.05f), XMFLOAT3(-4.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
-	model.vertices.push_back({ XMFLOAT3(2.5f, 1.25f, -10.0f), XMFLOAT3(0.36f, 0.25f, 0.05f), XMFLOAT3(-4.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
-	model.vertices.push_back({ XMFLOAT3(1.5f, 0.0f, -14.0f), XMFLOAT3(0.36f, 0.25f, 0.05f), XMFLOAT3(-4.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
+	model.AddVertex({ XMFLOAT3(2.5f, 1.0f, -10.0f), XMFLOAT3(0.36f, 0.25f, 0.05f), XMFLOAT3(-4.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
+	model.AddVertex({ XMFLOAT3(2.5f, 1.25f, -10.0f), XMFLOAT3(0.36f, 0.25f, 0.05f), XMFLOAT3(-4.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
+	model.AddVertex({ XMFLOAT3(1.5f, 0.0f, -14.0f), XMFLOAT3(0.36f, 0.25f, 0.05f), XMFLOAT3(-4.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
 
-	model.vertices.push_back({ XMFLOAT3(-1.5f, 0.0f, -14.0f), XMFLOAT3(0.36f, 0.25f, 0.05f), XMFLOAT3(4.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
-	model.vertices.push_back({ XMFLOAT3(-1.5f, 1.0f, -14.0f), XMFLOAT3(0.36f, 0.25f, 0.05f), XMFLOAT3(4.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
-	model.vertices.push_back({ XMFLOAT3(-2.5f, 1.25f, -10.0f), XMFLOAT3(0.36f, 0.25f, 0.05f), XMFLOAT3(4.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
+	model.AddVertex({ XMFLOAT3(-1.5f, 0.0f, -14.0f), XMFLOAT3(0.36f, 0.25f, 0.05f), XMFLOAT3(4.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
+	model.AddVertex({ XMFLOAT3(-1.5f, 1.0f, -14.0f), XMFLOAT3(0.36f, 0.25f, 0.05f), XMFLOAT3(4.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
+	model.AddVertex({ XMFLOAT3(-2.5f, 1.25f, -10.0f), XMFLOAT3(0.36f, 0.25f, 0.05f), XMFLOAT3(4.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
 
-	model.vertices.push_back({ XMFLOAT3(-2.5f, 1.25f, -10.0f), XMFLOAT3(0.36f, 0.25f, 0.05f), XMFLOAT3(4.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
-	model.vertices.push_back({ XMFLOAT3(-2.5f, 1.0f, -10.0f), XMFLOAT3(0.36f, 0.25f, 0.05f), XMFLOAT3(4.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
-	model.vertices.push_back({ XMFLOAT3(-1.5f, 0.0f, -14.0f), XMFLOAT3(0.36f, 0.25f, 0.05f), XMFLOAT3(4.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
+	model.AddVertex({ XMFLOAT3(-2.5f, 1.25f, -10.0f), XMFLOAT3(0.36f, 0.25f, 0.05f), XMFLOAT3(4.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
+	model.AddVertex({ XMFLOAT3(-2.5f, 1.0f, -10.0f), XMFLOAT3(0.36f, 0.25f, 0.05f), XMFLOAT3(4.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
+	model.AddVertex({ XMFLOAT3(-1.5f, 0.0f, -14.0f), XMFLOAT3(0.36f, 0.25f, 0.05f), XMFLOAT3(4.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) });
 
 	//"Laser Swords"
-	model.vertices.push_back({ XMFLOAT3(2.375f, 1.75f, -10.0f), XMFLOAT3(0.78f, 0.78f, 0.78f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(0.5f, 0.5f, 1.0f) });
-	model.vertices.push_back({ XMFLOAT3(2.375f, 0.5f, -10.0f), XMFLOAT3(0.78f, 0.78f, 0.78f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(0.5f, 0.5f, 1.0f) });
-	model.vertices.push_back({ XMFLOAT3(2.625f, 1.75f, -10.0f), XMFLOAT3(0.78f, 0.78f, 0.78f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(0.5f, 0.5f, 1.0f) });
-
-	model.vertices.push_back({ XMFLOAT3(2.625f, 1.75f, -10.0f), XMFLOAT3(0.78f, 0.78f, 0.78f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(0.5f, 0.5f, 1.0f) });
-	model.vertices.push_back({ XMFLOAT3(2.375f, 0.5f, -10.0f), XMFLOAT3(0.78f, 0.78f, 0.78f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(0.5f, 0.5f, 1.0f) });
-	model.vertices.push_back({ XMFLOAT3(2.625f, 0.5f, -10.0f), XMFLOAT3(0.78f, 0.78f, 0.78f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(0.5f, 0.5f, 1.0f) });
-
-	model.vertices.push_back({ XMFLOAT3(2.375f, 6.0f, -10.0f), XMFLOAT3(0.05f, 0.87f, 0.95f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 1.5f, 0.3f) });
-	model.vertices.push_back({ XMFLOAT3(2.375f, 1.75f, -10.0f), XMFLOAT3(0.05f, 0.87f, 0.95f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 1.5f, 0.3f) });
-	model.vertices.push_back({ XMFLOAT3(2.625f, 6.0f, -10.0f), XMFLOAT3(0.05f, 0.87f, 0.95f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 1.5f, 0.3f) });
-
-	model.vertices.push_back({ XMFLOAT3(2.625f, 6.0f, -10.0f), XMFLOAT3(0.05f, 0.87f, 0.95f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 1.5f, 0.3f) });
-	model.vertices.push_back({ XMFLOAT3(2.375f, 1.75f, -10.0f), XMFLOAT3(0.05f, 0.87f, 0.95f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 1.5f, 0.3f) });
-	model.vertices.push_back({ XMFLOAT3(2.625f, 1.75f, -10.0f), XMFLOAT3(0.05f, 0.87f, 0.95f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 1.5f, 0.3f) });
-
-	model.vertices.push_back({ XMFLOAT3(-2.375f, 1.75f, -10.0f), XMFLOAT3(0.78f, 0.78f, 0.78f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(0.5f, 0.5f, 1.0f) });
-	model.vertices.push_back({ XMFLOAT3(-2.375f, 0.5f, -10.0f), XMFLOAT3(0.78f, 0.78f, 0.78f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(0.5f, 0.5f, 1.0f) });
-	model.vertices.push_back({ XMFLOAT3(-2.625f, 1.75f, -10.0f), XMFLOAT3(0.78f, 0.78f, 0.78f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(0.5f, 0.5f, 1.0f) });
-
-	model.vertices.push_back({ XMFLOAT3(-2.625f, 1.75f, -10.0f), XMFLOAT3(0.78f, 0.78f, 0.78f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(0.5f, 0.5f, 1.0f) });
-	model.vertices.push_back({ XMFLOAT3(-2.375f, 0.5f, -10.0f), XMFLOAT3(0.78f, 0.78f, 0.78f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(0.5f, 0.5f, 1.0f) });
-	model.vertices.push_back({ XMFLOAT3(-2.625f, 0.5f, -10.0f), XMFLOAT3(0.78f, 0.78f, 0.78f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(0.5f, 0.5f, 1.0f) });
-
-	model.vertices.push_back({ XMFLOAT3(-2.375f, 6.0f, -10.0f), XMFLOAT3(0.42f, 0.02f, 0.68f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 1.5f, 0.3f) });
-	model.vertices.push_back({ XMFLOAT3(-2.375f, 1.75f, -10.0f), XMFLOAT3(0.42f, 0.02f, 0.68f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 1.5f, 0.3f) });
-	model.vertices.push_back({ XMFLOAT3(-2.625f, 6.0f, -10.0f), XMFLOAT3(0.42f, 0.02f, 0.68f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 1.5f, 0.3f) });
-
-	model.vertices.push_back({ XMFLOAT3(-2.625f, 6.0f, -10.0f), XMFLOAT3(0.42f, 0.02f, 0.68f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 1.5f, 0.3f) });
-	model.vertices.push_back({ XMFLOAT3(-2.375f, 1.75f, -10.0f), XMFLOAT3(0.42f, 0.02f, 0.68f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 1.5f, 0.3f) });
-	model.vertices.push_back({ XMFLOAT3(-2.625f, 1.75f, -10.0f), XMFLOAT3(0.42f, 0.02f, 0.68f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 1.5f, 0.3f) });
-
-
-	//Define Indicies for Triangles of Environment
-	// Back
-	model.indices.push_back(0);
-	model.indices.push_back(1);
-	model.indices.push_back(2);
-
-	model.indices.push_back(0);
-	model.indices.push_back(2);
-	model.indices.push_back(3);
-
-	// Floor
-	model.indices.push_back(4);
-	model.indices.push_back(6);
-	model.indices.push_back(5);
-
-	model.indices.push_back(4);
-	model.indices.push_back(7);
-	model.indices.push_back(6);
-
-	//Right Side
-	model.indices.push_back(8);
-	model.indices.push_back(10);
-	model.indices.push_back(9);
+	model.AddVertex({ XMFLOAT3(2.375f, 1.75f, -10.0f), XMFLOAT3(0.78f, 0.78f, 0.78f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(0.5f, 0.5f, 1.0f) });
+	model.AddVertex({ XMFLOAT3(2.375f, 0.5f, -10.0f), XMFLOAT3(0.78f, 0.78f, 0.78f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(0.5f, 0.5f, 1.0f) });
+	model.AddVertex({ XMFLOAT3(2.625f, 1.75f, -10.0f), XMFLOAT3(0.78f, 0.78f, 0.78f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(0.5f, 0.5f, 1.0f) });
 
-	model.indices.push_back(10);
-	model.indices.push_back(11);
-	model.indices.push_back(9);
+	model.AddVertex({ XMFLOAT3(2.625f, 1.75f, -10.0f), XMFLOAT3(0.78f, 0.78f, 0.78f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(0.5f, 0.5f, 1.0f) });
+	model.AddVertex({ XMFLOAT3(2.375f, 0.5f, -10.0f), XMFLOAT3(0.78f, 0.78f, 0.78f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(0.5f, 0.5f, 1.0f) });
+	model.AddVertex({ XMFLOAT3(2.625f, 0.5f, -10.0f), XMFLOAT3(0.78f, 0.78f, 0.78f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(0.5f, 0.5f, 1.0f) });
 
-	//Left Side
-	model.indices.push_back(14);
-	model.indices.push_back(12);
-	model.indices.push_back(13);
+	model.AddVertex({ XMFLOAT3(2.375f, 6.0f, -10.0f), XMFLOAT3(0.05f, 0.87f, 0.95f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 1.5f, 0.3f) });
+	model.AddVertex({ XMFLOAT3(2.375f, 1.75f, -10.0f), XMFLOAT3(0.05f, 0.87f, 0.95f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 1.5f, 0.3f) });
+	model.AddVertex({ XMFLOAT3(2.625f, 6.0f, -10.0f), XMFLOAT3(0.05f, 0.87f, 0.95f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 1.5f, 0.3f) });
 
-	model.indices.push_back(15);
-	model.indices.push_back(14);
-	model.indices.push_back(13);
+	model.AddVertex({ XMFLOAT3(2.625f, 6.0f, -10.0f), XMFLOAT3(0.05f, 0.87f, 0.95f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 1.5f, 0.3f) });
+	model.AddVertex({ XMFLOAT3(2.375f, 1.75f, -10.0f), XMFLOAT3(0.05f, 0.87f, 0.95f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 1.5f, 0.3f) });
+	model.AddVertex({ XMFLOAT3(2.625f, 1.75f, -10.0f), XMFLOAT3(0.05f, 0.87f, 0.95f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 1.5f, 0.3f) });
 
-	model.indices.push_back(16);
-	model.indices.push_back(17);
-	model.indices.push_back(18);
+	model.AddVertex({ XMFLOAT3(-2.375f, 1.75f, -10.0f), XMFLOAT3(0.78f, 0.78f, 0.78f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(0.5f, 0.5f, 1.0f) });
+	model.AddVertex({ XMFLOAT3(-2.375f, 0.5f, -10.0f), XMFLOAT3(0.78f, 0.78f, 0.78f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(0.5f, 0.5f, 1.0f) });
+	model.AddVertex({ XMFLOAT3(-2.625f, 1.75f, -10.0f), XMFLOAT3(0.78f, 0.78f, 0.78f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(0.5f, 0.5f, 1.0f) });
 
-	model.indices.push_back(19);
-	model.indices.push_back(20);
-	model.indices.push_back(21);
+	model.AddVertex({ XMFLOAT3(-2.625f, 1.75f, -10.0f), XMFLOAT3(0.78f, 0.78f, 0.78f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(0.5f, 0.5f, 1.0f) });
+	model.AddVertex({ XMFLOAT3(-2.375f, 0.5f, -10.0f), XMFLOAT3(0.78f, 0.78f, 0.78f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(0.5f, 0.5f, 1.0f) });
+	model.AddVertex({ XMFLOAT3(-2.625f, 0.5f, -10.0f), XMFLOAT3(0.78f, 0.78f, 0.78f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(0.5f, 0.5f, 1.0f) });
 
-	model.indices.push_back(22);
-	model.indices.push_back(23);
-	model.indices.push_back(24);
+	model.AddVertex({ XMFLOAT3(-2.375f, 6.0f, -10.0f), XMFLOAT3(0.42f, 0.02f, 0.68f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 1.5f, 0.3f) });
+	model.AddVertex({ XMFLOAT3(-2.375f, 1.75f, -10.0f), XMFLOAT3(0.42f, 0.02f, 0.68f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 1.5f, 0.3f) });
+	model.AddVertex({ XMFLOAT3(-2.625f, 6.0f, -10.0f), XMFLOAT3(0.42f, 0.02f, 0.68f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 1.5f, 0.3f) });
 
-	model.indices.push_back(25);
-	model.indices.push_back(26);
-	model.indices.push_back(27);
+	model.AddVertex({ XMFLOAT3(-2.625f, 6.0f, -10.0f), XMFLOAT3(0.42f, 0.02f, 0.68f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 1.5f, 0.3f) });
+	model.AddVertex({ XMFLOAT3(-2.375f, 1.75f, -10.0f), XMFLOAT3(0.42f, 0.02f, 0.68f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 1.5f, 0.3f) });
+	model.AddVertex({ XMFLOAT3(-2.625f, 1.75f, -10.0f), XMFLOAT3(0.42f, 0.02f, 0.68f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 1.5f, 0.3f) });
 
-	model.indices.push_back(28);
-	model.indices.push_back(29);
-	model.indices.push_back(30);
 
-	model.indices.push_back(31);
-	model.indices.push_back(32);
-	model.indices.push_back(33);
-
-	model.indices.push_back(34);
-	model.indices.push_back(35);
-	model.indices.push_back(36);
-
-	model.indices.push_back(37);
-	model.indices.push_back(38);
-	model.indices.push_back(39);
-
-	model.indices.push_back(40);
-	model.indices.push_back(41);
-	model.indices.push_back(42);
-
-	model.indices.push_back(43);
-	model.indices.push_back(44);
-	model.indices.push_back(45);
-
-	model.indices.push_back(46);
-	model.indices.push_back(47);
-	model.indices.push_back(48);
-
-	model.indices.push_back(49);
-	model.indices.push_back(50);
-	model.indices.push_back(51);
-
-	model.indices.push_back(52);
-	model.indices.push_back(53);
-	model.indices.push_back(54);
-
-	model.indices.push_back(55);
-	model.indices.push_back(56);
-	model.indices.push_back(57);
-
-	model.indices.push_back(58);
-	model.indices.push_back(59);
-	model.indices.push_back(60);
+	// Every bunny triangle has its own vertices
+	for (uint32_t i = 0; i < model.positions.size(); i++)
+	{
+		model.indices.push_back(i);
+	}
 
-	model.indices.push_back(61);
-	model.indices.push_back(62);
-	model.indices.push_back(63);
-
-	model.indices.push_back(64);
-	model.indices.push_back(65);
-	model.indices.push_back(66);
+	//Environment Description: Back, Floor, Right Side, Left Side
+	Primitives::AddPrimitives(model, {
+		{ PrimitiveShape::Plane, 1, Primitives::GetTransform(XMFLOAT3(0.0f, 4.0f, -20.0f), XMFLOAT3(8.0f, 1.0f, 6.0f), XMFLOAT3(XM_PIDIV2, 0.0f, 0.0f)), XMFLOAT3(0.61f, 0.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 0.0f) },
+		{ PrimitiveShape::Plane, 1, Primitives::GetTransform(XMFLOAT3(0.0f, -2.0f, -10.0f), XMFLOAT3(8.0f, 1.0f, 10.0f)), XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 0.5f) },
+		{ PrimitiveShape::Plane, 1, Primitives::GetTransform(XMFLOAT3(-8.0f, 4.0f, -10.0f), XMFLOAT3(6.0f, 1.0f, 10.0f), XMFLOAT3(0.0f, 0.0f, -XM_PIDIV2)), XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.5f, 0.5f, 0.5f) },
+		{ PrimitiveShape::Plane, 1, Primitives::GetTransform(XMFLOAT3(8.0f, 4.0f, -10.0f), XMFLOAT3(6.0f, 1.0f, 10.0f), XMFLOAT3(0.0f, 0.0f, -XM_PIDIV2)), XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.5f, 0.5f, 0.5f) },
+	});
 
 	//Ground Spheres
 	LoadSphere(model, material, XMFLOAT3(4.5, -2.0, -12.0), 2, XMFLOAT3(1, 1, 1), XMFLOAT3(0.0f, 0.0f, 1.0f));
@@ -503,109 +2469,282 @@ void LoadCustomAdvancedScene(Model &model, Material &material) {
 
 void LoadSphere(Model &model, Material &material, XMFLOAT3 position, float scale, XMFLOAT3 color, XMFLOAT3 materialDesc) {
 
-	size_t verticalSegments = 20;
-	if (verticalSegments < 3)
-		verticalSegments = 3;
+	// Spheres are intersected analytically on the GPU, so only the center, radius, and shading data are kept
+	Sphere sphere;
+	sphere.center = position;
+	sphere.radius = scale / 2.0f;
+	sphere.color = color;
+	sphere.material = materialDesc;
+	model.spheres.push_back(sphere);
+}
+
+//--------------------------------------------------------------------------------------
+// Stress Scenes
+//--------------------------------------------------------------------------------------
+
+/**
+* A counter based random number generator. Every element of a stress scene seeds its own sequence from the scene seed and its index,
+* so scenes come out the same however the work is split across threads.
+*/
+struct StressRandom
+{
+	uint64_t state;
+
+	StressRandom(uint64_t seed, uint64_t index) : state(seed ^ (index * 0xD1B54A32D192ED03ull)) {}
 
-	float radius = scale / 2.0;
-	size_t horizontalSegments = verticalSegments * 2;
-	int indexOffset = model.vertices.size();
+	// SplitMix64
+	uint64_t NextBits()
+	{
+		uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
 
-	// Create rings of vertices at progressively higher latitudes.
-	for (size_t i = 0; i <= verticalSegments; i++)
+	float Next()
 	{
+		return static_cast<float>(NextBits() >> 40) * (1.f / 16777216.f);
+	}
 
-		float latitude = (i * XM_PI / verticalSegments) - XM_PIDIV2;
-		float dy, dxz;
+	float Range(float lower, float upper)
+	{
+		return lower + (upper - lower) * Next();
+	}
 
-		XMScalarSinCos(&dy, &dxz, latitude);
+	XMFLOAT3 Color()
+	{
+		return XMFLOAT3(Range(0.1f, 1.f), Range(0.1f, 1.f), Range(0.1f, 1.f));
+	}
+};
 
-		// Create a single ring of vertices at this latitude.
-		for (size_t j = 0; j <= horizontalSegments; j++)
-		{
+// The stress scenes fill the same room as the custom scenes
+static const XMFLOAT3 StressLower(-8.f, -2.f, -20.f);
+static const XMFLOAT3 StressUpper(8.f, 10.f, 0.f);
 
-			float longitude = j * XM_2PI / horizontalSegments;
-			float dx, dz;
+static uint64_t ParseStressNumber(const string &field, const string &spec)
+{
+	char* end = nullptr;
+	uint64_t value = strtoull(field.c_str(), &end, 10);
+	if (field.empty() || *end != '\0')
+	{
+		throw runtime_error("Error: invalid number '" + field + "' in stress scene '" + spec + "'!");
+	}
+	return value;
+}
 
-			XMScalarSinCos(&dx, &dz, longitude);
+static void AddStressFloor(Model &model, XMFLOAT3 material)
+{
+	XMFLOAT3 center((StressLower.x + StressUpper.x) * 0.5f, StressLower.y, (StressLower.z + StressUpper.z) * 0.5f);
+	XMFLOAT3 scale((StressUpper.x - StressLower.x) * 0.5f, 1.f, (StressUpper.z - StressLower.z) * 0.5f);
+	Primitives::AddPrimitive(model, { PrimitiveShape::Plane, 1, Primitives::GetTransform(center, scale), XMFLOAT3(0.9f, 0.9f, 0.9f), material });
+}
 
-			dx *= dxz;
-			dz *= dxz;
+/**
+* Scatter spheres through the room, sized so they fill about the same fraction of it at any count.
+*/
+static void LoadStressSpheres(Model &model, uint64_t count, uint64_t seed)
+{
+	float volume = (StressUpper.x - StressLower.x) * (StressUpper.y - StressLower.y) * (StressUpper.z - StressLower.z);
+	float radius = 0.5f * cbrtf(volume / (8.f * static_cast<float>(count)));
 
-			XMFLOAT3 norm = XMFLOAT3(dx, dy, dz);
+	const XMFLOAT3 materials[] = { XMFLOAT3(1.f, 0.f, 0.f), XMFLOAT3(1.f, 1.f, 0.5f), XMFLOAT3(0.f, 0.f, 1.f) };
 
-			model.vertices.push_back({ XMFLOAT3(norm.x*radius + position.x, norm.y*radius + position.y, norm.z*radius + position.z), color, norm, materialDesc });
+	model.spheres.resize(count);
+	ParallelFor(count, 4096, [&](size_t first, size_t last)
+	{
+		for (size_t i = first; i < last; i++)
+		{
+			StressRandom random(seed, i);
+			Sphere &sphere = model.spheres[i];
+			sphere.radius = radius * random.Range(0.5f, 1.5f);
+			sphere.center = XMFLOAT3(random.Range(StressLower.x, StressUpper.x), random.Range(StressLower.y, StressUpper.y), random.Range(StressLower.z, StressUpper.z));
+			sphere.color = random.Color();
+			sphere.material = materials[random.NextBits() % _countof(materials)];
 		}
+	});
+
+	AddStressFloor(model, XMFLOAT3(1.f, 0.f, 0.f));
+}
+
+/**
+* Scatter unconnected triangles through the room, each with its own three vertices.
+*/
+static void LoadStressTriangles(Model &model, uint64_t count, uint64_t seed)
+{
+	if (count * 3 > UINT32_MAX)
+	{
+		throw runtime_error("Error: too many stress triangles for 32-bit indices!");
 	}
 
-	// Fill the index buffer with triangles joining each pair of latitude rings.
-	size_t stride = horizontalSegments + 1;
+	float volume = (StressUpper.x - StressLower.x) * (StressUpper.y - StressLower.y) * (StressUpper.z - StressLower.z);
+	float size = cbrtf(volume / static_cast<float>(count));
 
-	for (size_t i = 0; i < verticalSegments; i++)
+	model.positions.resize(count * 3);
+	model.attributes.resize(count * 3);
+	model.indices.resize(count * 3);
+	ParallelFor(count, 4096, [&](size_t first, size_t last)
 	{
-		for (size_t j = 0; j <= horizontalSegments; j++)
+		for (size_t t = first; t < last; t++)
 		{
-			size_t nextI = i + 1;
-			size_t nextJ = (j + 1) % stride;
+			StressRandom random(seed, t);
+			XMVECTOR center = XMVectorSet(random.Range(StressLower.x, StressUpper.x), random.Range(StressLower.y, StressUpper.y), random.Range(StressLower.z, StressUpper.z), 0.f);
+
+			XMVECTOR corners[3];
+			for (int c = 0; c < 3; c++)
+			{
+				corners[c] = center + XMVectorSet(random.Range(-size, size), random.Range(-size, size), random.Range(-size, size), 0.f);
+			}
 
-			model.indices.push_back(indexOffset + (i * stride + j));
-			model.indices.push_back(indexOffset + (nextI * stride + j));
-			model.indices.push_back(indexOffset + (i * stride + nextJ));
+			XMFLOAT3 normal;
+			XMStoreFloat3(&normal, XMVector3Normalize(XMVector3Cross(corners[1] - corners[0], corners[2] - corners[0])));
+			XMFLOAT3 color = random.Color();
 
-			model.indices.push_back(indexOffset + (i * stride + nextJ));
-			model.indices.push_back(indexOffset + (nextI * stride + j));
-			model.indices.push_back(indexOffset + (nextI * stride + nextJ));
+			for (int c = 0; c < 3; c++)
+			{
+				size_t v = (t * 3) + c;
+				XMStoreFloat3(&model.positions[v], corners[c]);
+				model.attributes[v] = { color, normal, XMFLOAT3(1.f, 0.5f, 0.f) };
+				model.indices[v] = static_cast<uint32_t>(v);
+			}
 		}
-	}
+	});
 
+	AddStressFloor(model, XMFLOAT3(1.f, 0.f, 0.f));
 }
 
-//--------------------------------------------------------------------------------------
-// Textures
-//--------------------------------------------------------------------------------------
+/**
+* Place a square grid of instances of one icosphere mesh on the floor, so the triangle count grows without the geometry.
+*/
+static void LoadStressGrid(Model &model, uint64_t size, uint64_t seed)
+{
+	if (size * size > (1u << 24))
+	{
+		throw runtime_error("Error: too many stress grid instances, instance IDs are 24-bit!");
+	}
+
+	// Mesh 0 is the icosphere, mesh 1 is the floor
+	Mesh mesh = {};
+	mesh.bounds = XMFLOAT4(0.f, 0.f, 0.f, 1.f);
+	Primitives::AddPrimitive(model, { PrimitiveShape::Icosphere, 3, Primitives::GetTransform(XMFLOAT3(0.f, 0.f, 0.f), XMFLOAT3(1.f, 1.f, 1.f)), XMFLOAT3(0.8f, 0.8f, 0.8f), XMFLOAT3(1.f, 1.f, 0.2f) });
+	mesh.indexCount = model.indices.size();
+	model.meshes.push_back(mesh);
+
+	mesh.firstIndex = model.indices.size();
+	AddStressFloor(model, XMFLOAT3(1.f, 0.f, 0.f));
+	mesh.indexCount = model.indices.size() - mesh.firstIndex;
+	mesh.bounds = XMFLOAT4((StressLower.x + StressUpper.x) * 0.5f, StressLower.y, (StressLower.z + StressUpper.z) * 0.5f, XMVectorGetX(XMVector3Length(XMVectorSet(StressUpper.x - StressLower.x, 0.f, StressUpper.z - StressLower.z, 0.f))) * 0.5f);
+	model.meshes.push_back(mesh);
+
+	float spacing = min(StressUpper.x - StressLower.x, StressUpper.z - StressLower.z) / static_cast<float>(size);
+	model.instances.resize(size * size + 1);
+	ParallelFor(size * size, 4096, [&](size_t first, size_t last)
+	{
+		for (size_t i = first; i < last; i++)
+		{
+			StressRandom random(seed, i);
+			float scale = spacing * random.Range(0.25f, 0.45f);
+			float x = StressLower.x + spacing * (static_cast<float>(i % size) + 0.5f);
+			float z = StressLower.z + spacing * (static_cast<float>(i / size) + 0.5f);
+
+			MeshInstance &instance = model.instances[i];
+			instance.mesh = 0;
+			instance.lod = 0;
+			XMStoreFloat4x4(&instance.transform, XMMatrixScaling(scale, scale, scale) * XMMatrixTranslation(x, StressLower.y + scale, z));
+		}
+	});
+
+	MeshInstance &floor = model.instances.back();
+	floor.mesh = 1;
+	floor.lod = 0;
+	XMStoreFloat4x4(&floor.transform, XMMatrixIdentity());
+}
 
 /**
-* Convert a three channel RGB texture to four channel RGBA
+* Stack mirror spheres in a lattice between two facing mirror walls, so most rays reflect until the recursion limit.
 */
-void FormatTexture(TextureInfo &info, stbi_uc* pixels)
+static void LoadStressMirrors(Model &model, uint64_t count, uint64_t seed)
 {
-	const UINT rowPitch = info.width * 4;
-	const UINT cellPitch = rowPitch >> 3;				// The width of a cell in the texture.
-	const UINT cellHeight = info.height >> 3;			// The height of a cell in the texture.
-	const UINT textureSize = rowPitch * info.height;
-	const UINT pixelSize = info.width * 3 * info.height;
+	uint64_t side = 1;
+	while (side * side * side < count) side++;
 
-	info.pixels.resize(textureSize);
-	info.stride = 4;
+	XMFLOAT3 lower(StressLower.x + 2.f, StressLower.y + 1.f, StressLower.z + 2.f);
+	XMFLOAT3 upper(StressUpper.x - 2.f, StressUpper.y - 1.f, StressUpper.z - 2.f);
+	XMFLOAT3 spacing((upper.x - lower.x) / side, (upper.y - lower.y) / side, (upper.z - lower.z) / side);
+	float radius = 0.45f * min(spacing.x, min(spacing.y, spacing.z));
 
-	UINT c = (pixelSize - 1);
-	for (UINT n = 0; n < textureSize; n += 4)
+	model.spheres.resize(count);
+	ParallelFor(count, 4096, [&](size_t first, size_t last)
 	{
-		info.pixels[n] = pixels[c - 2];			// R
-		info.pixels[n + 1] = pixels[c - 1];		// G
-		info.pixels[n + 2] = pixels[c];			// B
-		info.pixels[n + 3] = 0xff;				// A
-		c -= 3;
-	}
+		for (size_t i = first; i < last; i++)
+		{
+			StressRandom random(seed, i);
+			Sphere &sphere = model.spheres[i];
+			sphere.radius = radius * random.Range(0.7f, 1.f);
+			sphere.center = XMFLOAT3(
+				lower.x + spacing.x * (static_cast<float>(i % side) + 0.5f),
+				lower.y + spacing.y * (static_cast<float>((i / side) % side) + 0.5f),
+				lower.z + spacing.z * (static_cast<float>(i / (side * side)) + 0.5f));
+			sphere.color = random.Color();
+			sphere.material = XMFLOAT3(0.2f, 0.5f, 1.f);
+		}
+	});
+
+	// A reflective floor and a mirror wall on each side
+	float height = (StressUpper.y - StressLower.y) * 0.5f;
+	float depth = (StressUpper.z - StressLower.z) * 0.5f;
+	float middle = (StressLower.z + StressUpper.z) * 0.5f;
+	Primitives::AddPrimitives(model, {
+		{ PrimitiveShape::Plane, 1, Primitives::GetTransform(XMFLOAT3(StressLower.x, StressLower.y + height, middle), XMFLOAT3(height, 1.f, depth), XMFLOAT3(0.f, 0.f, -XM_PIDIV2)), XMFLOAT3(0.9f, 0.9f, 0.9f), XMFLOAT3(0.f, 0.f, 1.f) },
+		{ PrimitiveShape::Plane, 1, Primitives::GetTransform(XMFLOAT3(StressUpper.x, StressLower.y + height, middle), XMFLOAT3(height, 1.f, depth), XMFLOAT3(0.f, 0.f, XM_PIDIV2)), XMFLOAT3(0.9f, 0.9f, 0.9f), XMFLOAT3(0.f, 0.f, 1.f) },
+	});
+	AddStressFloor(model, XMFLOAT3(0.5f, 0.5f, 0.5f));
 }
 
 /**
-* Load an image
+* Generate a synthetic scene from a specification of the form stress:<kind>[:<count>[:<seed>]].
+* The kinds are spheres, triangles, grid (count is the grid's side), and mirrors. The same specification always generates the same scene.
 */
-TextureInfo LoadTexture(string filepath) 
+void LoadStressScene(const string &spec, Model &model, Material &material)
 {
-	TextureInfo result;
+	HighResolutionClock clock;
 
-	// Load image pixels with stb_image
-	stbi_uc* pixels = stbi_load(filepath.c_str(), &result.width, &result.height, &result.stride, STBI_rgb);
-	if (!pixels) 
+	vector<string> fields;
+	stringstream stream(spec);
+	string field;
+	while (getline(stream, field, ':')) fields.push_back(field);
+
+	if (fields.size() < 2 || fields.size() > 4 || fields[0] != "stress")
 	{
-		throw runtime_error("Error: failed to load image!");
+		throw runtime_error("Error: stress scenes are specified as stress:<kind>[:<count>[:<seed>]], got '" + spec + "'!");
 	}
 
-	FormatTexture(result, pixels);
-	stbi_image_free(pixels);
-	return result;
+	const string &kind = fields[1];
+	uint64_t count = (fields.size() > 2) ? ParseStressNumber(fields[2], spec) : 0;
+	uint64_t seed = (fields.size() > 3) ? ParseStressNumber(fields[3], spec) : 1;
+
+	material.name = "defaultMaterial";
+	material.texturePath = "";
+
+	if (kind == "spheres") LoadStressSpheres(model, count ? count : 1000, seed);
+	else if (kind == "triangles") LoadStressTriangles(model, count ? count : 100000, seed);
+	else if (kind == "grid") LoadStressGrid(model, count ? count : 32, seed);
+	else if (kind == "mirrors") LoadStressMirrors(model, count ? count : 64, seed);
+	else
+	{
+		throw runtime_error("Error: unknown stress scene kind '" + kind + "', expected spheres, triangles, grid or mirrors!");
+	}
+
+	// Count the triangles the acceleration structures will hold, including every instance
+	uint64_t triangles = model.indices.size() / 3;
+	if (!model.instances.empty())
+	{
+		triangles = 0;
+		for (const MeshInstance &instance : model.instances) triangles += model.meshes[instance.mesh].indexCount / 3;
+	}
+
+	clock.Tick();
+	Log("Stress scene %s: %llu triangles (%zu stored), %zu instances, %zu spheres, seed %llu in %.2f ms\n",
+		spec.c_str(), triangles, model.indices.size() / 3, max(model.instances.size(), static_cast<size_t>(1)), model.spheres.size(), seed, clock.GetDeltaMilliseconds());
 }
 
 }
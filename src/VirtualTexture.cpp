@@ -0,0 +1,171 @@
+/* Copyright (c) 2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of NVIDIA CORPORATION nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "VirtualTexture.h"
+
+namespace VirtualTexture
+{
+
+static UINT GetMipSize(UINT size, UINT mip)
+{
+	return max(size >> mip, 1u);
+}
+
+/**
+* Mip and page coordinates within the mip of a page.
+*/
+static void GetPageCoordinates(const PageTable &table, UINT page, UINT &mip, UINT &x, UINT &y)
+{
+	mip = static_cast<UINT>(upper_bound(table.firstPage.begin(), table.firstPage.begin() + table.packedMip + 1, page) - table.firstPage.begin()) - 1;
+	x = (page - table.firstPage[mip]) % table.pagesX[mip];
+	y = (page - table.firstPage[mip]) / table.pagesX[mip];
+}
+
+void Init(PageTable &table, UINT width, UINT height, UINT mipLevels, UINT tileWidth, UINT tileHeight, UINT packedMip, UINT budgetPages)
+{
+	table.width = width;
+	table.height = height;
+	table.mipLevels = mipLevels;
+	table.tileWidth = tileWidth;
+	table.tileHeight = tileHeight;
+	table.packedMip = min(packedMip, mipLevels);
+	table.frame = 0;
+
+	table.firstPage.assign(table.packedMip + 1, 0);
+	table.pagesX.assign(table.packedMip, 0);
+	for (UINT mip = 0; mip < table.packedMip; mip++)
+	{
+		UINT pagesX = (GetMipSize(width, mip) + tileWidth - 1) / tileWidth;
+		UINT pagesY = (GetMipSize(height, mip) + tileHeight - 1) / tileHeight;
+		table.pagesX[mip] = pagesX;
+		table.firstPage[mip + 1] = table.firstPage[mip] + pagesX * pagesY;
+	}
+
+	const UINT pageCount = table.firstPage[table.packedMip];
+	table.pageSlots.assign(pageCount, -1);
+	table.pageUsed.assign(pageCount, 0);
+	table.slotPages.assign(budgetPages, -1);
+}
+
+int GetPage(const PageTable &table, UINT mip, UINT x, UINT y)
+{
+	if (mip >= table.packedMip) return -1;
+	return static_cast<int>(table.firstPage[mip] + (y / table.tileHeight) * table.pagesX[mip] + (x / table.tileWidth));
+}
+
+UINT GetFeedbackWords(const PageTable &table)
+{
+	return (table.firstPage[table.packedMip] + 31) / 32;
+}
+
+UINT Lookup(const PageTable &table, UINT mip, float u, float v)
+{
+	for (; mip < table.packedMip; mip++)
+	{
+		UINT width = GetMipSize(table.width, mip);
+		UINT height = GetMipSize(table.height, mip);
+		UINT x = min(static_cast<UINT>(max(u, 0.f) * width), width - 1);
+		UINT y = min(static_cast<UINT>(max(v, 0.f) * height), height - 1);
+		if (table.pageSlots[GetPage(table, mip, x, y)] >= 0) return mip;
+	}
+	return min(mip, table.mipLevels - 1);
+}
+
+void Update(PageTable &table, const UINT32* feedback, UINT maxUploads, vector<PageMapping> &mappings)
+{
+	table.frame++;
+
+	// Mark the requested pages used, with the coarser pages a sample falls back to, and collect the missing ones
+	vector<UINT> requests;
+	const UINT words = GetFeedbackWords(table);
+	for (UINT word = 0; word < words; word++)
+	{
+		for (UINT32 bits = feedback[word]; bits != 0; bits &= bits - 1)
+		{
+			unsigned long bit;
+			_BitScanForward(&bit, bits);
+			UINT page = word * 32 + static_cast<UINT>(bit);
+			if (page >= table.pageSlots.size()) break;
+
+			UINT mip, x, y;
+			GetPageCoordinates(table, page, mip, x, y);
+			for (; mip < table.packedMip; mip++, x /= 2, y /= 2)
+			{
+				UINT parent = table.firstPage[mip] + y * table.pagesX[mip] + x;
+				if (table.pageUsed[parent] == table.frame) break;
+				table.pageUsed[parent] = table.frame;
+				if (table.pageSlots[parent] < 0) requests.push_back(parent);
+			}
+		}
+	}
+	if (requests.empty()) return;
+
+	// Coarse pages first, a sample can use them while the finer pages are still missing
+	sort(requests.begin(), requests.end(), [](UINT a, UINT b) { return a > b; });
+	if (requests.size() > maxUploads) requests.resize(maxUploads);
+
+	// Free slots first, then slots in least recently used order, finer pages first among those last used in the same frame.
+	// A slot holding a page used this frame is never taken.
+	vector<UINT> candidates;
+	for (UINT slot = 0; slot < table.slotPages.size(); slot++)
+	{
+		int page = table.slotPages[slot];
+		if (page < 0 || table.pageUsed[page] < table.frame) candidates.push_back(slot);
+	}
+	sort(candidates.begin(), candidates.end(), [&](UINT a, UINT b)
+	{
+		const int pageA = table.slotPages[a];
+		const int pageB = table.slotPages[b];
+		if (pageA < 0 || pageB < 0) return pageA < 0 && pageB >= 0;
+		if (table.pageUsed[pageA] != table.pageUsed[pageB]) return table.pageUsed[pageA] < table.pageUsed[pageB];
+		return pageA < pageB;
+	});
+
+	const size_t count = min(requests.size(), candidates.size());
+	for (size_t i = 0; i < count; i++)
+	{
+		const UINT slot = candidates[i];
+		PageMapping mapping;
+
+		const int evicted = table.slotPages[slot];
+		if (evicted >= 0)
+		{
+			GetPageCoordinates(table, static_cast<UINT>(evicted), mapping.mip, mapping.x, mapping.y);
+			mapping.slot = -1;
+			mappings.push_back(mapping);
+			table.pageSlots[evicted] = -1;
+		}
+
+		GetPageCoordinates(table, requests[i], mapping.mip, mapping.x, mapping.y);
+		mapping.slot = static_cast<int>(slot);
+		mappings.push_back(mapping);
+		table.pageSlots[requests[i]] = static_cast<int>(slot);
+		table.slotPages[slot] = static_cast<int>(requests[i]);
+	}
+}
+
+}
@@ -31,6 +31,8 @@
 #include "Window.h"
 #include "Graphics.h"
 #include "InputState.h"
+#include "TaskGraph.h"
+#include "Geometry.h"
 
 #ifdef _DEBUG
 #define _CRTDBG_MAP_ALLOC
@@ -45,13 +47,14 @@
 class DXRApplication 
 {
 	HighResolutionClock m_UpdateClock;
+	TaskGraph startup;
 	uint64_t m_FrameCounter = 0;
 	double printFPSTime = 0;
 	int vertexCount = 0;
 
 public:
 	
-	void Init(ConfigInfo &config) 
+	bool Init(ConfigInfo &config) 
 	{		
 		// Create a new window
 		HRESULT hr = Window::Create(config.width, config.height, config.instance, window, L"DirectX Raytracing - Introductory Scene");
@@ -64,55 +67,107 @@ public:
 		d3d.width = config.width;
 		d3d.height = config.height;
 
-		// Load a model
-		// Custom Scene
-		if (config.model == "custom") {
-			Utils::LoadCustomAdvancedScene(model, material);
-		}
-		//Reference Scene
-		else if (config.model == "reference") {
-			Utils::LoadCustomScene(model, material);
-		}
-		//Model Scene
-		else {
-			Utils::LoadModel(config.model, model, material);
-		}
+		// Independent startup stages run in parallel, stages recording into the command list are chained
+		size_t load = startup.Add("Load scene", [&]()
+		{
+			// Custom Scene
+			if (config.model == "custom") {
+				Utils::LoadCustomAdvancedScene(model, material);
+			}
+			//Reference Scene
+			else if (config.model == "reference") {
+				Utils::LoadCustomScene(model, material);
+			}
+			//Stress Scene
+			else if (config.model.compare(0, 7, "stress:") == 0) {
+				Utils::LoadStressScene(config.model, model, material);
+			}
+			//Model Scene
+			else {
+				Utils::LoadModels(config.models, model, material);
 
-		vertexCount = model.vertices.size();
-		
-		// Initialize the shader compiler
-		D3DShaders::Init_Shader_Compiler(shaderCompiler);
-
-		// Initialize D3D12
-		D3D12::Create_Device(d3d);
-		D3D12::Create_Command_Queue(d3d);
-		D3D12::Create_Command_Allocator(d3d);
-		D3D12::Create_Fence(d3d);		
-		D3D12::Create_SwapChain(d3d, window);
-		D3D12::Create_CommandList(d3d);
-		D3D12::Reset_CommandList(d3d);
+				// Strip degenerate and duplicate triangles before they reach the acceleration structures
+				Geometry::CleanModel(model);
+
+				// Store repeated meshes once and place the copies as instances
+				Geometry::InstanceRepeatedMeshes(model);
+			}
+
+			// Optionally sort the triangles along a Morton curve for memory locality
+			if (config.mortonOrder) {
+				Geometry::ReorderModelMorton(model);
+			}
+
+			// Optionally simplify the meshes into levels of detail, selected per instance each frame
+			if (config.generateLods) {
+				Geometry::GenerateMeshLods(model, 4);
+			}
+
+			// Split the model into chunks addressable with 16-bit indices
+			Geometry::BuildMeshChunks(model, !config.wideIndices);
+
+			vertexCount = model.positions.size();
+		});
+
+		size_t compiler = startup.Add("Init shader compiler", [&]() { D3DShaders::Init_Shader_Compiler(shaderCompiler); });
+
+		size_t device = startup.Add("Create device", [&]()
+		{
+			D3D12::Create_Device(d3d);
+			D3D12::Create_Command_Queue(d3d);
+			D3D12::Create_Command_Allocator(d3d);
+			D3D12::Create_Fence(d3d);
+		});
+
+		// The swap chain is created on the thread that owns the window
+		size_t swapChain = startup.Add("Create swap chain", [&]()
+		{
+			D3D12::Create_SwapChain(d3d, window);
+			D3D12::Create_CommandList(d3d);
+			D3D12::Reset_CommandList(d3d);
+		}, { device }, true);
 
 		// Create common resources
-		D3DResources::Create_Descriptor_Heaps(d3d, resources);
-		D3DResources::Create_BackBuffer_RTV(d3d, resources);
-		D3DResources::Create_Samplers(d3d, resources);		
-		D3DResources::Create_Vertex_Buffer(d3d, resources, model);
-		D3DResources::Create_Index_Buffer(d3d, resources, model);
-		if(material.texturePath.length() > 0)
-			D3DResources::Create_Texture(d3d, resources, material);
-		D3DResources::Create_View_CB(d3d, resources);
-		D3DResources::Create_Lighting_CB(d3d, resources, material);
-		
+		size_t resourcesCreated = startup.Add("Create resources", [&]()
+		{
+			D3DResources::Create_Descriptor_Heaps(d3d, resources);
+			D3DResources::Create_BackBuffer_RTV(d3d, resources);
+			D3DResources::Create_Samplers(d3d, resources);
+			D3DResources::Create_Vertex_Buffer(d3d, resources, model);
+			D3DResources::Create_Index_Buffer(d3d, resources, model);
+			D3DResources::Create_Sphere_Buffer(d3d, resources, model);
+			if(material.HasTexture())
+				D3DResources::Create_Texture(d3d, resources, material, config);
+			D3DResources::Create_View_CB(d3d, resources);
+			D3DResources::Create_Lighting_CB(d3d, resources, material);
+		}, { load, swapChain });
+
 		// Create DXR specific resources
-		DXR::Create_Bottom_Level_AS(d3d, dxr, resources, model);
-		DXR::Create_Top_Level_AS(d3d, dxr, resources);
-		DXR::Create_DXR_Output(d3d, resources);
-		DXR::Create_CBVSRVUAV_Heap(d3d, dxr, resources, model);		
-		DXR::Create_RayGen_Program(d3d, dxr, shaderCompiler);
-		DXR::Create_Miss_Program(d3d, dxr, shaderCompiler);
-		DXR::Create_Closest_Hit_Program(d3d, dxr, shaderCompiler);
-		DXR::Create_Pipeline_State_Object(d3d, dxr);
-		DXR::Create_Shader_Table(d3d, dxr, resources);
+		size_t accelerationStructures = startup.Add("Build acceleration structures", [&]()
+		{
+			DXR::Create_Bottom_Level_AS(d3d, dxr, resources, model);
+			DXR::Create_Top_Level_AS(d3d, dxr, resources, model);
+			DXR::Create_DXR_Output(d3d, resources);
+			DXR::Create_CBVSRVUAV_Heap(d3d, dxr, resources, model);
+		}, { resourcesCreated });
+
+		// The programs share one compiler instance, so they compile one after another
+		size_t rayGen = startup.Add("Compile ray gen program", [&]() { DXR::Create_RayGen_Program(d3d, dxr, shaderCompiler); }, { compiler, device });
+		size_t miss = startup.Add("Compile miss program", [&]() { DXR::Create_Miss_Program(d3d, dxr, shaderCompiler); }, { rayGen });
+		size_t hit = startup.Add("Compile closest hit program", [&]() { DXR::Create_Closest_Hit_Program(d3d, dxr, shaderCompiler); }, { miss });
+		size_t pipeline = startup.Add("Create pipeline state", [&]() { DXR::Create_Pipeline_State_Object(d3d, dxr); }, { hit });
+		startup.Add("Create shader table", [&]() { DXR::Create_Shader_Table(d3d, dxr, resources, model); }, { pipeline, accelerationStructures });
+
+		// Failures in the startup tasks, worker threads included, are rethrown here and reported on the main thread
+		try
+		{
+			startup.Run();
+		}
+		catch (const exception &e)
+		{
+			MessageBoxA(NULL, e.what(), "Error", MB_OK);
+			return false;
+		}
 
 		d3d.cmdList->Close();
 		ID3D12CommandList* pGraphicsList = { d3d.cmdList };
@@ -120,6 +175,7 @@ public:
 
 		D3D12::WaitForGPU(d3d);
 		D3D12::Reset_CommandList(d3d);
+		return true;
 	}
 	
 	void Update(ConfigInfo &config)
@@ -138,15 +194,19 @@ public:
 			m_FrameCounter = 0;
 		}
 
-		D3DResources::Update_View_CB(d3d, resources, config);
+		D3DResources::Update_View_CB(d3d, resources, config, model);
 	}
 
-	void Render() 
+	void Render(const ConfigInfo &config) 
 	{		
+		DXR::Update_Top_Level_AS(d3d, dxr, resources, model);
 		DXR::Build_Command_List(d3d, dxr, resources);
 		D3D12::Present(d3d);
 		D3D12::MoveToNextFrame(d3d);
 		D3D12::Reset_CommandList(d3d);
+
+		// Start or finish loading textures first hit this frame, uploads are recorded for the next one
+		D3DResources::Update_Texture_Residency(d3d, resources, material, config);
 	}
 
 	void Cleanup() 
@@ -154,6 +214,8 @@ public:
 		D3D12::WaitForGPU(d3d);
 		CloseHandle(d3d.fenceEvent);
 
+		startup.Report();
+
 		DXR::Destroy(dxr);
 		D3DResources::Destroy(resources);		
 		D3DShaders::Destroy(shaderCompiler);
@@ -218,7 +280,10 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdLi
 
 		// Initialize
 		DXRApplication app;
-		app.Init(config);
+		if (!app.Init(config))
+		{
+			return EXIT_FAILURE;
+		}
 
 		// Main loop
 		while (WM_QUIT != msg.message) 
@@ -230,7 +295,7 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdLi
 			}
 
 			app.Update(config);
-			app.Render();
+			app.Render(config);
 		}
 
 		app.Cleanup();